@@ -0,0 +1,556 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+//keeps the layout of every mip level of the images it's told about, and which stages last wrote and read each level and buffer
+//code says how it's about to use something with useImage or useBuffer and the tracker works out what that needs
+	//writes and layout changes wait for every earlier read and write
+	//reads only wait for the last write, and only if it hasn't been made visible to them already
+//the barriers pile up until flush, which records all of them as one vkCmdPipelineBarrier (vkCmdPipelineBarrier2KHR with synchronization2)
+	//levels next to each other that need the same barrier share one VkImageMemoryBarrier
+//a level or buffer can be used more than once between flushes only in the same layout, the uses are merged into one barrier
+//images can also be handed between queue families with releaseImage and acquireImage
+class BarrierTracker
+{
+public:
+	struct Stats
+	{
+		uint32_t barrierCount = 0;	//image and buffer barriers
+		uint32_t batchCount = 0;	//barrier commands
+	};
+
+	//VK_KHR_synchronization2 has to be supported for this to mean anything
+	static bool isSupported(VkPhysicalDevice physicalDevice)
+	{
+		VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {};
+		synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &synchronization2Features;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+		return synchronization2Features.synchronization2 == VK_TRUE;
+	}
+
+	static VkPhysicalDeviceSynchronization2FeaturesKHR requiredFeatures()
+	{
+		VkPhysicalDeviceSynchronization2FeaturesKHR features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+		features.synchronization2 = VK_TRUE;
+		return features;
+	}
+
+	//synchronization2 only if the device was made with the extension and its feature enabled
+		//each barrier then gets its own stages, instead of every barrier in a batch waiting on all of their stages
+	void init(VkDevice device, bool synchronization2)
+	{
+		cmdPipelineBarrier2 = nullptr;
+		if (synchronization2)
+		{
+			cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR"));
+			if (cmdPipelineBarrier2 == nullptr)
+			{
+				throw std::runtime_error("failed to load vkCmdPipelineBarrier2KHR!");
+			}
+		}
+	}
+
+	bool usesSynchronization2() const { return cmdPipelineBarrier2 != nullptr; }
+
+	//starts (or restarts) tracking an image, every level is in layout and stages is what the first barrier waits on
+	void trackImage(VkImage image, VkImageAspectFlags aspect, uint32_t mipLevels,
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED, VkPipelineStageFlags stages = 0)
+	{
+		TrackedImage& tracked = images[image];
+		tracked.aspect = aspect;
+		tracked.levels.assign(mipLevels, State());
+		tracked.pending.assign(mipLevels, NOT_PENDING);
+		for (State& state : tracked.levels)
+		{
+			state.layout = layout;
+			state.writeStages = stages;
+		}
+	}
+
+	void trackBuffer(VkBuffer buffer, VkPipelineStageFlags stages = 0)
+	{
+		TrackedBuffer& tracked = buffers[buffer];
+		tracked.state = State();
+		tracked.state.writeStages = stages;
+		tracked.pending = NOT_PENDING;
+	}
+
+	//only once nothing pending mentions them
+	void untrackImage(VkImage image) { images.erase(image); }
+	void untrackBuffer(VkBuffer buffer) { buffers.erase(buffer); }
+
+	//forgets everything, for when the device is idle
+	void clear()
+	{
+		images.clear();
+		buffers.clear();
+		imageBarriers.clear();
+		bufferBarriers.clear();
+	}
+
+	//the contents don't matter anymore, so the next transition can start from VK_IMAGE_LAYOUT_UNDEFINED
+		//whatever was still using it has to finish first, so that's kept
+	void discardImage(VkImage image)
+	{
+		for (State& state : find(image).levels)
+		{
+			state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+	}
+
+	//image's memory was last used by previous, so the next use of image also waits for everything previous was doing
+	void aliasImage(VkImage image, VkImage previous)
+	{
+		VkPipelineStageFlags stages = 0;
+		VkAccessFlags access = 0;
+		for (const State& other : find(previous).levels)
+		{
+			stages |= other.writeStages | other.readStages;
+			access |= other.writeAccess;
+		}
+
+		for (State& state : find(image).levels)
+		{
+			state.writeStages |= stages;
+			state.writeAccess |= access;
+			//previous's visibility says nothing about this image
+			state.visibleStages = 0;
+			state.visibleAccess = 0;
+		}
+	}
+
+	//every level
+	void useImage(VkImage image, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access)
+	{
+		useImage(image, 0, static_cast<uint32_t>(find(image).levels.size()), layout, stages, access);
+	}
+
+	void useImage(VkImage image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access)
+	{
+		TrackedImage& tracked = find(image);
+		for (uint32_t level = baseLevel; level < baseLevel + levelCount; level++)
+		{
+			State& state = tracked.levels[level];
+			uint32_t& pending = tracked.pending[level];
+
+			if (pending != NOT_PENDING)
+			{
+				//already has a barrier in this batch, which can also cover this use if the layout's the same
+				ImageBarrier& barrier = imageBarriers[pending];
+				if (barrier.newLayout != layout)
+				{
+					throw std::runtime_error("image level used in two layouts without a flush in between!");
+				}
+				barrier.dstStages |= stages;
+				barrier.dstAccess |= access;
+				updateState(state, state.layout != layout, stages, access);
+				continue;
+			}
+
+			Transition transition = updateState(state, state.layout != layout, stages, access);
+			VkImageLayout oldLayout = state.layout;
+			state.layout = layout;
+			if (!transition.needed) continue;
+
+			//carries on the previous level's barrier if it's the same transition
+			if (level > 0 && tracked.pending[level - 1] != NOT_PENDING)
+			{
+				ImageBarrier& previous = imageBarriers[tracked.pending[level - 1]];
+				if (previous.baseLevel + previous.levelCount == level && previous.oldLayout == oldLayout && previous.newLayout == layout
+					&& previous.srcFamily == VK_QUEUE_FAMILY_IGNORED
+					&& previous.srcStages == transition.srcStages && previous.srcAccess == transition.srcAccess
+					&& previous.dstStages == stages && previous.dstAccess == access)
+				{
+					previous.levelCount++;
+					pending = tracked.pending[level - 1];
+					continue;
+				}
+			}
+
+			ImageBarrier barrier = {};
+			barrier.image = image;
+			barrier.aspect = tracked.aspect;
+			barrier.baseLevel = level;
+			barrier.levelCount = 1;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = layout;
+			barrier.srcFamily = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstFamily = VK_QUEUE_FAMILY_IGNORED;
+			barrier.srcStages = transition.srcStages;
+			barrier.srcAccess = transition.srcAccess;
+			barrier.dstStages = stages;
+			barrier.dstAccess = access;
+			pending = static_cast<uint32_t>(imageBarriers.size());
+			imageBarriers.push_back(barrier);
+		}
+	}
+
+	//first half of a queue family ownership transfer, recorded on a queue of srcFamily once the image's work there is recorded
+		//every level ends up in layout, the same transition has to be acquired with acquireImage on a queue of dstFamily
+		//the acquiring submission has to wait on a semaphore the releasing one signals
+	void releaseImage(VkImage image, uint32_t srcFamily, uint32_t dstFamily, VkImageLayout layout)
+	{
+		TrackedImage& tracked = find(image);
+
+		ImageBarrier barrier = {};
+		barrier.image = image;
+		barrier.aspect = tracked.aspect;
+		barrier.baseLevel = 0;
+		barrier.levelCount = static_cast<uint32_t>(tracked.levels.size());
+		barrier.oldLayout = tracked.levels[0].layout;
+		barrier.newLayout = layout;
+		barrier.srcFamily = srcFamily;
+		barrier.dstFamily = dstFamily;
+		for (const State& state : tracked.levels)
+		{
+			barrier.srcStages |= state.writeStages | state.readStages;
+			barrier.srcAccess |= state.writeAccess;
+		}
+		addOwnershipBarrier(tracked, barrier);
+
+		//nothing on this queue touches it again
+		for (State& state : tracked.levels)
+		{
+			state = State();
+			state.layout = layout;
+		}
+	}
+
+	//second half of releaseImage, stages and access are the image's first use on the new queue
+		//stages should include the stage the semaphore is waited at, so the transition comes after the wait
+	void acquireImage(VkImage image, uint32_t srcFamily, uint32_t dstFamily, VkImageLayout oldLayout, VkImageLayout layout,
+		VkPipelineStageFlags stages, VkAccessFlags access)
+	{
+		TrackedImage& tracked = find(image);
+
+		ImageBarrier barrier = {};
+		barrier.image = image;
+		barrier.aspect = tracked.aspect;
+		barrier.baseLevel = 0;
+		barrier.levelCount = static_cast<uint32_t>(tracked.levels.size());
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = layout;
+		barrier.srcFamily = srcFamily;
+		barrier.dstFamily = dstFamily;
+		barrier.srcStages = stages;
+		barrier.dstStages = stages;
+		barrier.dstAccess = access;
+		addOwnershipBarrier(tracked, barrier);
+
+		//the acquire is a write as far as later stages are concerned, the same as a layout transition
+		for (State& state : tracked.levels)
+		{
+			state = State();
+			state.layout = layout;
+			state.writeStages = stages;
+			state.visibleStages = stages;
+			state.visibleAccess = access;
+		}
+	}
+
+	void useBuffer(VkBuffer buffer, VkPipelineStageFlags stages, VkAccessFlags access)
+	{
+		auto it = buffers.find(buffer);
+		if (it == buffers.end())
+		{
+			throw std::runtime_error("buffer isn't tracked!");
+		}
+		TrackedBuffer& tracked = it->second;
+
+		Transition transition = updateState(tracked.state, false, stages, access);
+		if (tracked.pending != NOT_PENDING)
+		{
+			BufferBarrier& barrier = bufferBarriers[tracked.pending];
+			barrier.dstStages |= stages;
+			barrier.dstAccess |= access;
+			return;
+		}
+		if (!transition.needed) return;
+
+		BufferBarrier barrier = {};
+		barrier.buffer = buffer;
+		barrier.srcStages = transition.srcStages;
+		barrier.srcAccess = transition.srcAccess;
+		barrier.dstStages = stages;
+		barrier.dstAccess = access;
+		tracked.pending = static_cast<uint32_t>(bufferBarriers.size());
+		bufferBarriers.push_back(barrier);
+	}
+
+	bool hasPending() const { return !imageBarriers.empty() || !bufferBarriers.empty(); }
+
+	//records everything since the last flush as one barrier command, or nothing if nothing's needed
+	void flush(VkCommandBuffer commandBuffer)
+	{
+		if (!hasPending()) return;
+
+		if (cmdPipelineBarrier2 != nullptr)
+		{
+			std::vector<VkImageMemoryBarrier2KHR> imageBarriers2(imageBarriers.size());
+			for (size_t i = 0; i < imageBarriers.size(); i++)
+			{
+				const ImageBarrier& pending = imageBarriers[i];
+				VkImageMemoryBarrier2KHR& barrier = imageBarriers2[i];
+				barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+				barrier.srcStageMask = pending.srcStages;
+				barrier.srcAccessMask = pending.srcAccess;
+				barrier.dstStageMask = pending.dstStages;
+				barrier.dstAccessMask = pending.dstAccess;
+				barrier.oldLayout = pending.oldLayout;
+				barrier.newLayout = pending.newLayout;
+				barrier.srcQueueFamilyIndex = pending.srcFamily;
+				barrier.dstQueueFamilyIndex = pending.dstFamily;
+				barrier.image = pending.image;
+				barrier.subresourceRange = { pending.aspect, pending.baseLevel, pending.levelCount, 0, 1 };
+			}
+
+			std::vector<VkBufferMemoryBarrier2KHR> bufferBarriers2(bufferBarriers.size());
+			for (size_t i = 0; i < bufferBarriers.size(); i++)
+			{
+				const BufferBarrier& pending = bufferBarriers[i];
+				VkBufferMemoryBarrier2KHR& barrier = bufferBarriers2[i];
+				barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+				barrier.srcStageMask = pending.srcStages;
+				barrier.srcAccessMask = pending.srcAccess;
+				barrier.dstStageMask = pending.dstStages;
+				barrier.dstAccessMask = pending.dstAccess;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.buffer = pending.buffer;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+			}
+
+			VkDependencyInfoKHR dependencyInfo = {};
+			dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+			dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers2.size());
+			dependencyInfo.pBufferMemoryBarriers = bufferBarriers2.data();
+			dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers2.size());
+			dependencyInfo.pImageMemoryBarriers = imageBarriers2.data();
+			cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		}
+		else
+		{
+			//one set of stages for the whole command
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+
+			std::vector<VkImageMemoryBarrier> imageBarriers1(imageBarriers.size());
+			for (size_t i = 0; i < imageBarriers.size(); i++)
+			{
+				const ImageBarrier& pending = imageBarriers[i];
+				VkImageMemoryBarrier& barrier = imageBarriers1[i];
+				barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = pending.srcAccess;
+				barrier.dstAccessMask = pending.dstAccess;
+				barrier.oldLayout = pending.oldLayout;
+				barrier.newLayout = pending.newLayout;
+				barrier.srcQueueFamilyIndex = pending.srcFamily;
+				barrier.dstQueueFamilyIndex = pending.dstFamily;
+				barrier.image = pending.image;
+				barrier.subresourceRange = { pending.aspect, pending.baseLevel, pending.levelCount, 0, 1 };
+				srcStages |= pending.srcStages;
+				dstStages |= pending.dstStages;
+			}
+
+			std::vector<VkBufferMemoryBarrier> bufferBarriers1(bufferBarriers.size());
+			for (size_t i = 0; i < bufferBarriers.size(); i++)
+			{
+				const BufferBarrier& pending = bufferBarriers[i];
+				VkBufferMemoryBarrier& barrier = bufferBarriers1[i];
+				barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcAccessMask = pending.srcAccess;
+				barrier.dstAccessMask = pending.dstAccess;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.buffer = pending.buffer;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+				srcStages |= pending.srcStages;
+				dstStages |= pending.dstStages;
+			}
+
+			//nothing to wait on, or nothing waits (a release), but the command still needs both stages
+			if (srcStages == 0)
+			{
+				srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			}
+			if (dstStages == 0)
+			{
+				dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			}
+			vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0,
+				0, nullptr,
+				static_cast<uint32_t>(bufferBarriers1.size()), bufferBarriers1.data(),
+				static_cast<uint32_t>(imageBarriers1.size()), imageBarriers1.data());
+		}
+
+		stats.barrierCount += static_cast<uint32_t>(imageBarriers.size() + bufferBarriers.size());
+		stats.batchCount++;
+
+		for (const ImageBarrier& barrier : imageBarriers)
+		{
+			TrackedImage& tracked = images[barrier.image];
+			for (uint32_t level = barrier.baseLevel; level < barrier.baseLevel + barrier.levelCount; level++)
+			{
+				tracked.pending[level] = NOT_PENDING;
+			}
+		}
+		for (const BufferBarrier& barrier : bufferBarriers)
+		{
+			buffers[barrier.buffer].pending = NOT_PENDING;
+		}
+		imageBarriers.clear();
+		bufferBarriers.clear();
+	}
+
+	VkImageLayout getLayout(VkImage image, uint32_t level = 0) { return find(image).levels[level].layout; }
+	const Stats& getStats() const { return stats; }
+	void resetStats() { stats = Stats(); }
+
+private:
+	enum : uint32_t { NOT_PENDING = UINT32_MAX };
+
+	static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	//where a level or buffer is at
+	struct State
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		//the last write (or layout transition), and the reads since then
+		VkPipelineStageFlags writeStages = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;
+		//what the last write has been made visible to
+		VkPipelineStageFlags visibleStages = 0;
+		VkAccessFlags visibleAccess = 0;
+	};
+
+	struct TrackedImage
+	{
+		VkImageAspectFlags aspect = 0;
+		std::vector<State> levels;
+		std::vector<uint32_t> pending;	//index into imageBarriers of each level's barrier in this batch
+	};
+
+	struct TrackedBuffer
+	{
+		State state;
+		uint32_t pending = NOT_PENDING;
+	};
+
+	struct ImageBarrier
+	{
+		VkImage image;
+		VkImageAspectFlags aspect;
+		uint32_t baseLevel;
+		uint32_t levelCount;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		uint32_t srcFamily;	//VK_QUEUE_FAMILY_IGNORED unless it's an ownership transfer
+		uint32_t dstFamily;
+		VkPipelineStageFlags srcStages;
+		VkAccessFlags srcAccess;
+		VkPipelineStageFlags dstStages;
+		VkAccessFlags dstAccess;
+	};
+
+	struct BufferBarrier
+	{
+		VkBuffer buffer;
+		VkPipelineStageFlags srcStages;
+		VkAccessFlags srcAccess;
+		VkPipelineStageFlags dstStages;
+		VkAccessFlags dstAccess;
+	};
+
+	struct Transition
+	{
+		bool needed;
+		VkPipelineStageFlags srcStages;
+		VkAccessFlags srcAccess;
+	};
+
+	std::unordered_map<VkImage, TrackedImage> images;
+	std::unordered_map<VkBuffer, TrackedBuffer> buffers;
+	std::vector<ImageBarrier> imageBarriers;
+	std::vector<BufferBarrier> bufferBarriers;
+	PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2 = nullptr;
+	Stats stats;
+
+	//the whole image at once, so no level can have anything else pending
+	void addOwnershipBarrier(TrackedImage& tracked, const ImageBarrier& barrier)
+	{
+		for (uint32_t& pending : tracked.pending)
+		{
+			if (pending != NOT_PENDING)
+			{
+				throw std::runtime_error("image handed to another queue family with a barrier pending!");
+			}
+			pending = static_cast<uint32_t>(imageBarriers.size());
+		}
+		imageBarriers.push_back(barrier);
+	}
+
+	TrackedImage& find(VkImage image)
+	{
+		auto it = images.find(image);
+		if (it == images.end())
+		{
+			throw std::runtime_error("image isn't tracked!");
+		}
+		return it->second;
+	}
+
+	//what a use as stages and access has to wait for, the state is moved on to after it
+	static Transition updateState(State& state, bool layoutChange, VkPipelineStageFlags stages, VkAccessFlags access)
+	{
+		Transition transition = {};
+		bool write = (access & WRITE_ACCESS) != 0;
+
+		if (layoutChange || write)
+		{
+			transition.srcStages = state.writeStages | state.readStages;
+			transition.srcAccess = state.writeAccess;
+			transition.needed = layoutChange || transition.srcStages != 0;
+
+			//a layout transition is a write as far as later stages are concerned
+			state.writeStages = stages;
+			state.writeAccess = access & WRITE_ACCESS;
+			state.readStages = write ? 0 : stages;
+			state.visibleStages = stages;
+			state.visibleAccess = access;
+		}
+		else
+		{
+			transition.needed = state.writeStages != 0
+				&& ((stages & ~state.visibleStages) != 0 || (access & ~state.visibleAccess) != 0);
+			transition.srcStages = state.writeStages;
+			transition.srcAccess = state.writeAccess;
+
+			if (transition.needed)
+			{
+				state.visibleStages |= stages;
+				state.visibleAccess |= access;
+			}
+			state.readStages |= stages;
+		}
+		return transition;
+	}
+};
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+
+//one descriptor set holding every texture in the scene, shaders pick a texture by index (see shaders/bindless.frag)
+	//binding 0 is the sampler all the textures share
+	//binding 1 is a large array of sampled images, partially bound so unused slots can be left empty
+//the array binding is update after bind, so adding a texture or swapping a slot's image view
+	//doesn't invalidate command buffers that already have the set bound
+	//slots that no pending command buffer uses can even be written while frames are in flight
+//needs VK_EXT_descriptor_indexing, isSupported checks for the features this uses
+class BindlessTextures
+{
+public:
+	//the array is sized to this or the device limit, whichever is smaller
+	static const uint32_t MAX_TEXTURES = 4096;
+	static const uint32_t INVALID_INDEX = ~0u;
+
+	//fills in the descriptor indexing features of physicalDevice, the extension has to be supported for this to mean anything
+	static VkPhysicalDeviceDescriptorIndexingFeaturesEXT queryFeatures(VkPhysicalDevice physicalDevice)
+	{
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &indexingFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+		indexingFeatures.pNext = nullptr;
+		return indexingFeatures;
+	}
+
+	static bool isSupported(const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& features)
+	{
+		return features.runtimeDescriptorArray
+			&& features.descriptorBindingPartiallyBound
+			&& features.descriptorBindingSampledImageUpdateAfterBind
+			&& features.descriptorBindingUpdateUnusedWhilePending
+			&& features.shaderSampledImageArrayNonUniformIndexing;
+	}
+
+	//only turns on what isSupported checked for, the rest stay off
+	static VkPhysicalDeviceDescriptorIndexingFeaturesEXT requiredFeatures()
+	{
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		features.runtimeDescriptorArray = VK_TRUE;
+		features.descriptorBindingPartiallyBound = VK_TRUE;
+		features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		return features;
+	}
+
+	//the layout, pool and set don't depend on any textures, so this can run as soon as the device exists
+	void init(VkPhysicalDevice physicalDevice, VkDevice device)
+	{
+		this->device = device;
+
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+		VkPhysicalDeviceProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+		capacity = std::min(MAX_TEXTURES, std::min(indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages));
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		bindings[1].descriptorCount = capacity;
+		bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		//the sampler is written once before anything is recorded, so only the array needs the extra flags
+		std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = {
+			0,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+				| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+				| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT
+		};
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create bindless descriptor set layout!");
+		}
+
+		std::vector<VkDescriptorPoolSize> poolSizes(2);
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+		poolSizes[0].descriptorCount = 1;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		poolSizes[1].descriptorCount = capacity;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = 1;
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create bindless descriptor pool!");
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &descriptorSetLayout;
+
+		if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate bindless descriptor set!");
+		}
+
+		usedSlots.clear();
+		freeSlots.clear();
+	}
+
+	void destroy()
+	{
+		if (device == VK_NULL_HANDLE) return;
+
+		//the set goes with the pool
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+		descriptorPool = VK_NULL_HANDLE;
+		descriptorSetLayout = VK_NULL_HANDLE;
+		descriptorSet = VK_NULL_HANDLE;
+		device = VK_NULL_HANDLE;
+	}
+
+	bool isInitialized() const { return device != VK_NULL_HANDLE; }
+
+	//has to be called before the set is bound for the first time
+	void setSampler(VkSampler sampler)
+	{
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.sampler = sampler;
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSet;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	//returns the index shaders use to sample the texture, the view has to be in SHADER_READ_ONLY_OPTIMAL
+	uint32_t add(VkImageView imageView)
+	{
+		uint32_t index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			if (usedSlots.size() >= capacity)
+			{
+				throw std::runtime_error("bindless texture array is full!");
+			}
+			index = static_cast<uint32_t>(usedSlots.size());
+			usedSlots.push_back(false);
+		}
+
+		usedSlots[index] = true;
+		update(index, imageView);
+		return index;
+	}
+
+	//points an existing slot at a new view, e.g. when a streamed texture's image is replaced
+		//command buffers keep working without being recorded again, but the slot mustn't be in use by a pending one
+	void update(uint32_t index, VkImageView imageView)
+	{
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = imageView;
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSet;
+		descriptorWrite.dstBinding = 1;
+		descriptorWrite.dstArrayElement = index;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	//the slot is left pointing at the old view, which is fine since it's partially bound and nothing should index it anymore
+	void remove(uint32_t index)
+	{
+		usedSlots[index] = false;
+		freeSlots.push_back(index);
+	}
+
+	VkDescriptorSetLayout getLayout() const { return descriptorSetLayout; }
+	VkDescriptorSet getSet() const { return descriptorSet; }
+	uint32_t getCapacity() const { return capacity; }
+	uint32_t getCount() const { return static_cast<uint32_t>(usedSlots.size() - freeSlots.size()); }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	uint32_t capacity = 0;
+
+	std::vector<bool> usedSlots;
+	std::vector<uint32_t> freeSlots;
+};
@@ -0,0 +1,985 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <future>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BC_USE_SSE2
+#endif
+
+//CPU encoder for the BC block compressed texture formats
+//every format splits the image into 4x4 blocks and stores each one in a fixed number of bytes:
+	//BC1 - 8 bytes, two RGB565 endpoints and a 2 bit index per pixel, no alpha (4:1 vs RGBA8 in VRAM)
+	//BC3 - 16 bytes, a BC1 color block plus a BC4 alpha block (two 8 bit alphas and 3 bit indices)
+	//BC7 - 16 bytes, we only use mode 6: RGBA 7.7.7.7 endpoints with a shared p-bit and 4 bit indices
+		//mode 6 is a single subset, so it is cheap to search and still beats BC1/BC3 on gradients
+//this is meant for the bake step, not for runtime use
+namespace BlockCompression
+{
+	enum class Format
+	{
+		BC1,
+		BC3,
+		BC7
+	};
+
+	//how hard the encoder looks for endpoints
+		//Fast - bounding box of the block's colors
+		//Normal - principal axis of the block's colors
+		//High - principal axis, then a few rounds of least squares refinement of the endpoints
+	enum class Quality
+	{
+		Fast,
+		Normal,
+		High
+	};
+
+	inline const char* formatName(Format format)
+	{
+		switch (format)
+		{
+		case Format::BC1: return "BC1";
+		case Format::BC3: return "BC3";
+		default: return "BC7";
+		}
+	}
+
+	inline const char* qualityName(Quality quality)
+	{
+		switch (quality)
+		{
+		case Quality::Fast: return "fast";
+		case Quality::Normal: return "normal";
+		default: return "high";
+		}
+	}
+
+	inline size_t blockBytes(Format format)
+	{
+		return format == Format::BC1 ? 8 : 16;
+	}
+
+	inline size_t compressedSize(Format format, uint32_t width, uint32_t height)
+	{
+		return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+	}
+
+	namespace detail
+	{
+		//pixels of one block as floats, one array per channel, so the SIMD paths can load 4 pixels at a time
+		struct Block
+		{
+			alignas(16) float r[16];
+			alignas(16) float g[16];
+			alignas(16) float b[16];
+			alignas(16) float a[16];
+		};
+
+		//blocks on the right/bottom edge of images that aren't a multiple of 4 repeat the last row/column
+		inline void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+			Block& block, uint8_t raw[64])
+		{
+			for (uint32_t y = 0; y < 4; y++)
+			{
+				uint32_t sy = std::min(blockY * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; x++)
+				{
+					uint32_t sx = std::min(blockX * 4 + x, width - 1);
+					const uint8_t* pixel = rgba + (static_cast<size_t>(sy) * width + sx) * 4;
+					uint32_t i = y * 4 + x;
+
+					memcpy(raw + i * 4, pixel, 4);
+					block.r[i] = pixel[0];
+					block.g[i] = pixel[1];
+					block.b[i] = pixel[2];
+					block.a[i] = pixel[3];
+				}
+			}
+		}
+
+		inline uint8_t clampByte(float value)
+		{
+			return static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, value + 0.5f)));
+		}
+
+		//principal axis of the covariance of the block's colors using power iteration
+		//channels is 3 for RGB or 4 for RGBA
+		inline void principalAxis(const Block& block, int channels, float mean[4], float axis[4])
+		{
+			const float* data[4] = { block.r, block.g, block.b, block.a };
+
+			for (int c = 0; c < 4; c++)
+			{
+				mean[c] = 0.0f;
+				axis[c] = 0.0f;
+			}
+
+			for (int c = 0; c < channels; c++)
+			{
+				for (int i = 0; i < 16; i++) mean[c] += data[c][i];
+				mean[c] /= 16.0f;
+			}
+
+			float covariance[4][4] = {};
+			for (int i = 0; i < 16; i++)
+			{
+				float d[4] = {};
+				for (int c = 0; c < channels; c++) d[c] = data[c][i] - mean[c];
+
+				for (int j = 0; j < channels; j++)
+				{
+					for (int k = j; k < channels; k++)
+					{
+						covariance[j][k] += d[j] * d[k];
+					}
+				}
+			}
+			for (int j = 0; j < channels; j++)
+			{
+				for (int k = 0; k < j; k++) covariance[j][k] = covariance[k][j];
+			}
+
+			//start from the channel with the largest variance, which is a decent guess for most blocks
+			int largest = 0;
+			for (int c = 1; c < channels; c++)
+			{
+				if (covariance[c][c] > covariance[largest][largest]) largest = c;
+			}
+			float v[4] = {};
+			v[largest] = 1.0f;
+
+			for (int iteration = 0; iteration < 8; iteration++)
+			{
+				float next[4] = {};
+				for (int j = 0; j < channels; j++)
+				{
+					for (int k = 0; k < channels; k++) next[j] += covariance[j][k] * v[k];
+				}
+
+				float length = 0.0f;
+				for (int c = 0; c < channels; c++) length += next[c] * next[c];
+				length = std::sqrt(length);
+
+				//flat block, any axis works
+				if (length < 1e-6f) break;
+
+				for (int c = 0; c < channels; c++) v[c] = next[c] / length;
+			}
+
+			for (int c = 0; c < channels; c++) axis[c] = v[c];
+		}
+
+		//finds the two endpoints the block's colors lie between
+		inline void findEndpoints(const Block& block, int channels, Quality quality, float e0[4], float e1[4])
+		{
+			const float* data[4] = { block.r, block.g, block.b, block.a };
+
+			if (quality == Quality::Fast)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					e0[c] = e1[c] = 255.0f;
+				}
+				for (int c = 0; c < channels; c++)
+				{
+					float lo = 255.0f;
+					float hi = 0.0f;
+					for (int i = 0; i < 16; i++)
+					{
+						lo = std::min(lo, data[c][i]);
+						hi = std::max(hi, data[c][i]);
+					}
+					//pull the endpoints in slightly, the interpolated colors then cover the box better
+					float inset = (hi - lo) / 16.0f;
+					e0[c] = hi - inset;
+					e1[c] = lo + inset;
+				}
+				return;
+			}
+
+			float mean[4];
+			float axis[4];
+			principalAxis(block, channels, mean, axis);
+
+			float lo = 0.0f;
+			float hi = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				float t = 0.0f;
+				for (int c = 0; c < channels; c++) t += (data[c][i] - mean[c]) * axis[c];
+				lo = std::min(lo, t);
+				hi = std::max(hi, t);
+			}
+
+			float inset = (hi - lo) / 32.0f;
+			hi -= inset;
+			lo += inset;
+
+			for (int c = 0; c < 4; c++)
+			{
+				e0[c] = c < channels ? std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * hi)) : 255.0f;
+				e1[c] = c < channels ? std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * lo)) : 255.0f;
+			}
+		}
+
+		//for every pixel finds the closest of paletteSize colors
+		//returns the total squared error
+		inline float selectIndices(const Block& block, int channels, const float palette[][4], int paletteSize, uint8_t indices[16])
+		{
+#ifdef BC_USE_SSE2
+			const float* data[4] = { block.r, block.g, block.b, block.a };
+			__m128 totalError = _mm_setzero_ps();
+
+			//4 pixels at a time
+			for (int i = 0; i < 16; i += 4)
+			{
+				__m128 channel[4];
+				for (int c = 0; c < channels; c++) channel[c] = _mm_load_ps(data[c] + i);
+
+				__m128 bestError = _mm_set1_ps(1e30f);
+				__m128i bestIndex = _mm_setzero_si128();
+
+				for (int p = 0; p < paletteSize; p++)
+				{
+					__m128 error = _mm_setzero_ps();
+					for (int c = 0; c < channels; c++)
+					{
+						__m128 d = _mm_sub_ps(channel[c], _mm_set1_ps(palette[p][c]));
+						error = _mm_add_ps(error, _mm_mul_ps(d, d));
+					}
+
+					//SSE2 has no blend, so select with and/andnot/or
+					__m128 closer = _mm_cmplt_ps(error, bestError);
+					__m128i closerMask = _mm_castps_si128(closer);
+					bestError = _mm_min_ps(error, bestError);
+					bestIndex = _mm_or_si128(_mm_and_si128(closerMask, _mm_set1_epi32(p)), _mm_andnot_si128(closerMask, bestIndex));
+				}
+
+				totalError = _mm_add_ps(totalError, bestError);
+
+				alignas(16) int32_t lanes[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+				for (int j = 0; j < 4; j++) indices[i + j] = static_cast<uint8_t>(lanes[j]);
+			}
+
+			alignas(16) float errors[4];
+			_mm_store_ps(errors, totalError);
+			return errors[0] + errors[1] + errors[2] + errors[3];
+#else
+			const float* data[4] = { block.r, block.g, block.b, block.a };
+			float totalError = 0.0f;
+
+			for (int i = 0; i < 16; i++)
+			{
+				float bestError = 1e30f;
+				int best = 0;
+				for (int p = 0; p < paletteSize; p++)
+				{
+					float error = 0.0f;
+					for (int c = 0; c < channels; c++)
+					{
+						float d = data[c][i] - palette[p][c];
+						error += d * d;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices[i] = static_cast<uint8_t>(best);
+				totalError += bestError;
+			}
+
+			return totalError;
+#endif
+		}
+
+		//solves for the two endpoints that best fit the pixels given their current indices
+		//weights[index] is how far along from e0 to e1 that index is
+		//returns false if the system is degenerate (every pixel uses the same weight)
+		inline bool refineEndpoints(const Block& block, int channels, const uint8_t indices[16], const float* weights,
+			float e0[4], float e1[4])
+		{
+			const float* data[4] = { block.r, block.g, block.b, block.a };
+
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[4] = {};
+			float bx[4] = {};
+
+			for (int i = 0; i < 16; i++)
+			{
+				float beta = weights[indices[i]];
+				float alpha = 1.0f - beta;
+
+				aa += alpha * alpha;
+				ab += alpha * beta;
+				bb += beta * beta;
+
+				for (int c = 0; c < channels; c++)
+				{
+					ax[c] += alpha * data[c][i];
+					bx[c] += beta * data[c][i];
+				}
+			}
+
+			float determinant = aa * bb - ab * ab;
+			if (std::fabs(determinant) < 1e-6f) return false;
+
+			float inverse = 1.0f / determinant;
+			for (int c = 0; c < channels; c++)
+			{
+				e0[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) * inverse));
+				e1[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) * inverse));
+			}
+
+			return true;
+		}
+
+#pragma region BC1
+
+		inline uint16_t packRGB565(const float color[4])
+		{
+			uint32_t r = static_cast<uint32_t>(std::min(31.0f, std::max(0.0f, color[0] * 31.0f / 255.0f + 0.5f)));
+			uint32_t g = static_cast<uint32_t>(std::min(63.0f, std::max(0.0f, color[1] * 63.0f / 255.0f + 0.5f)));
+			uint32_t b = static_cast<uint32_t>(std::min(31.0f, std::max(0.0f, color[2] * 31.0f / 255.0f + 0.5f)));
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		inline void unpackRGB565(uint16_t packed, float color[4])
+		{
+			uint32_t r = (packed >> 11) & 31;
+			uint32_t g = (packed >> 5) & 63;
+			uint32_t b = packed & 31;
+			//replicate the high bits into the low bits, the same way the hardware expands them
+			color[0] = static_cast<float>((r << 3) | (r >> 2));
+			color[1] = static_cast<float>((g << 2) | (g >> 4));
+			color[2] = static_cast<float>((b << 3) | (b >> 2));
+			color[3] = 255.0f;
+		}
+
+		//4 color mode palette: e0, e1, 2/3 e0 + 1/3 e1, 1/3 e0 + 2/3 e1
+		inline void bc1Palette(uint16_t c0, uint16_t c1, float palette[4][4])
+		{
+			unpackRGB565(c0, palette[0]);
+			unpackRGB565(c1, palette[1]);
+			for (int c = 0; c < 4; c++)
+			{
+				palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+				palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+			}
+		}
+
+		//quantizes the endpoints and picks indices, making sure the block is in 4 color mode (c0 > c1)
+		inline float bc1Fit(const Block& block, const float e0[4], const float e1[4], uint16_t& c0, uint16_t& c1, uint8_t indices[16])
+		{
+			c0 = packRGB565(e0);
+			c1 = packRGB565(e1);
+
+			if (c0 < c1) std::swap(c0, c1);
+
+			float palette[4][4];
+			bc1Palette(c0, c1, palette);
+
+			if (c0 == c1)
+			{
+				//solid block, index 0 everywhere
+				memset(indices, 0, 16);
+				float error = 0.0f;
+				for (int i = 0; i < 16; i++)
+				{
+					float dr = block.r[i] - palette[0][0];
+					float dg = block.g[i] - palette[0][1];
+					float db = block.b[i] - palette[0][2];
+					error += dr * dr + dg * dg + db * db;
+				}
+				return error;
+			}
+
+			return selectIndices(block, 3, palette, 4, indices);
+		}
+
+		inline void bc1Write(uint16_t c0, uint16_t c1, const uint8_t indices[16], uint8_t output[8])
+		{
+			uint32_t packedIndices = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				packedIndices |= static_cast<uint32_t>(indices[i]) << (i * 2);
+			}
+
+			output[0] = static_cast<uint8_t>(c0 & 0xff);
+			output[1] = static_cast<uint8_t>(c0 >> 8);
+			output[2] = static_cast<uint8_t>(c1 & 0xff);
+			output[3] = static_cast<uint8_t>(c1 >> 8);
+			memcpy(output + 4, &packedIndices, 4);
+		}
+
+		inline void encodeBC1(const Block& block, Quality quality, uint8_t output[8])
+		{
+			float e0[4];
+			float e1[4];
+			findEndpoints(block, 3, quality, e0, e1);
+
+			uint16_t c0, c1;
+			uint8_t indices[16];
+			float error = bc1Fit(block, e0, e1, c0, c1, indices);
+
+			//the principal axis misses on blocks with several unrelated colors, so keep the box if it's better
+			if (quality != Quality::Fast)
+			{
+				float b0[4];
+				float b1[4];
+				findEndpoints(block, 3, Quality::Fast, b0, b1);
+
+				uint16_t n0, n1;
+				uint8_t newIndices[16];
+				float newError = bc1Fit(block, b0, b1, n0, n1, newIndices);
+				if (newError < error)
+				{
+					error = newError;
+					c0 = n0;
+					c1 = n1;
+					memcpy(indices, newIndices, 16);
+				}
+			}
+
+			if (quality == Quality::High)
+			{
+				//fraction of the way from e0 to e1 for each index
+				const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+				for (int iteration = 0; iteration < 3 && error > 0.0f; iteration++)
+				{
+					float r0[4] = { 0, 0, 0, 255 };
+					float r1[4] = { 0, 0, 0, 255 };
+					if (!refineEndpoints(block, 3, indices, weights, r0, r1)) break;
+
+					uint16_t n0, n1;
+					uint8_t newIndices[16];
+					float newError = bc1Fit(block, r0, r1, n0, n1, newIndices);
+					if (newError >= error) break;
+
+					error = newError;
+					c0 = n0;
+					c1 = n1;
+					memcpy(indices, newIndices, 16);
+				}
+			}
+
+			bc1Write(c0, c1, indices, output);
+		}
+
+		inline void decodeBC1(const uint8_t input[8], uint8_t rgba[64])
+		{
+			uint16_t c0 = static_cast<uint16_t>(input[0] | (input[1] << 8));
+			uint16_t c1 = static_cast<uint16_t>(input[2] | (input[3] << 8));
+			uint32_t packedIndices;
+			memcpy(&packedIndices, input + 4, 4);
+
+			float palette[4][4];
+			unpackRGB565(c0, palette[0]);
+			unpackRGB565(c1, palette[1]);
+
+			if (c0 > c1)
+			{
+				bc1Palette(c0, c1, palette);
+			}
+			else
+			{
+				//3 color mode, the last entry is transparent black
+				for (int c = 0; c < 4; c++)
+				{
+					palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+					palette[3][c] = 0.0f;
+				}
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t index = (packedIndices >> (i * 2)) & 3;
+				for (int c = 0; c < 4; c++) rgba[i * 4 + c] = clampByte(palette[index][c]);
+			}
+		}
+
+#pragma endregion
+
+#pragma region BC4 alpha (used by BC3)
+
+		//8 value mode (a0 > a1): a0, a1, then 6 values between them
+		//6 value mode (a0 <= a1): a0, a1, 4 values between them, 0 and 255
+		inline void bc4Palette(uint8_t a0, uint8_t a1, float palette[8])
+		{
+			palette[0] = a0;
+			palette[1] = a1;
+
+			if (a0 > a1)
+			{
+				for (int i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7.0f;
+			}
+			else
+			{
+				for (int i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * a0 + i * a1) / 5.0f;
+				palette[6] = 0.0f;
+				palette[7] = 255.0f;
+			}
+		}
+
+		inline float bc4SelectIndices(const float alpha[16], const float palette[8], uint8_t indices[16])
+		{
+			float totalError = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				float bestError = 1e30f;
+				for (int p = 0; p < 8; p++)
+				{
+					float d = alpha[i] - palette[p];
+					if (d * d < bestError)
+					{
+						bestError = d * d;
+						indices[i] = static_cast<uint8_t>(p);
+					}
+				}
+				totalError += bestError;
+			}
+			return totalError;
+		}
+
+		inline void encodeBC4(const float alpha[16], Quality quality, uint8_t output[8])
+		{
+			float lo = 255.0f;
+			float hi = 0.0f;
+			float innerLo = 255.0f;
+			float innerHi = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				lo = std::min(lo, alpha[i]);
+				hi = std::max(hi, alpha[i]);
+				//range without the values the 6 value mode gets for free
+				if (alpha[i] > 0.0f && alpha[i] < 255.0f)
+				{
+					innerLo = std::min(innerLo, alpha[i]);
+					innerHi = std::max(innerHi, alpha[i]);
+				}
+			}
+
+			uint8_t a0 = static_cast<uint8_t>(hi);
+			uint8_t a1 = static_cast<uint8_t>(lo);
+			uint8_t indices[16] = {};
+			float palette[8];
+
+			if (a0 == a1)
+			{
+				//constant alpha
+				a1 = a0 > 0 ? a0 - 1 : 0;
+				if (a0 == a1) a0 = 1;
+			}
+
+			bc4Palette(a0, a1, palette);
+			float error = bc4SelectIndices(alpha, palette, indices);
+
+			//blocks with hard 0/255 edges usually do better in the 6 value mode
+			if (quality == Quality::High && innerLo <= innerHi && error > 0.0f)
+			{
+				uint8_t b0 = static_cast<uint8_t>(innerLo);
+				uint8_t b1 = static_cast<uint8_t>(innerHi);
+				uint8_t otherIndices[16];
+				float otherPalette[8];
+				bc4Palette(b0, b1, otherPalette);
+				float otherError = bc4SelectIndices(alpha, otherPalette, otherIndices);
+
+				if (otherError < error)
+				{
+					a0 = b0;
+					a1 = b1;
+					memcpy(indices, otherIndices, 16);
+				}
+			}
+
+			uint64_t packed = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				packed |= static_cast<uint64_t>(indices[i]) << (i * 3);
+			}
+
+			output[0] = a0;
+			output[1] = a1;
+			for (int i = 0; i < 6; i++)
+			{
+				output[2 + i] = static_cast<uint8_t>(packed >> (i * 8));
+			}
+		}
+
+		inline void decodeBC4(const uint8_t input[8], uint8_t rgba[64])
+		{
+			float palette[8];
+			bc4Palette(input[0], input[1], palette);
+
+			uint64_t packed = 0;
+			for (int i = 0; i < 6; i++)
+			{
+				packed |= static_cast<uint64_t>(input[2 + i]) << (i * 8);
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				rgba[i * 4 + 3] = clampByte(palette[(packed >> (i * 3)) & 7]);
+			}
+		}
+
+#pragma endregion
+
+#pragma region BC7 mode 6
+
+		const float BC7_WEIGHTS[16] = {
+			0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+			34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f
+		};
+		const uint32_t BC7_WEIGHTS_INT[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		//an endpoint is 7 bits per channel plus a p-bit shared by all channels, giving an 8 bit value
+		struct BC7Endpoint
+		{
+			uint8_t value[4];	//7 bit
+			uint8_t pBit;
+		};
+
+		inline void bc7Expand(const BC7Endpoint& endpoint, uint32_t expanded[4])
+		{
+			for (int c = 0; c < 4; c++) expanded[c] = (endpoint.value[c] << 1) | endpoint.pBit;
+		}
+
+		//tries both p-bits and keeps the one with the smaller quantization error
+		inline BC7Endpoint bc7Quantize(const float color[4])
+		{
+			BC7Endpoint best = {};
+			float bestError = 1e30f;
+
+			for (uint8_t pBit = 0; pBit < 2; pBit++)
+			{
+				BC7Endpoint candidate;
+				candidate.pBit = pBit;
+				float error = 0.0f;
+
+				for (int c = 0; c < 4; c++)
+				{
+					float q = std::floor((color[c] - pBit) / 2.0f + 0.5f);
+					q = std::min(127.0f, std::max(0.0f, q));
+					candidate.value[c] = static_cast<uint8_t>(q);
+
+					float d = color[c] - (q * 2.0f + pBit);
+					error += d * d;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					best = candidate;
+				}
+			}
+
+			return best;
+		}
+
+		inline void bc7Palette(const BC7Endpoint& e0, const BC7Endpoint& e1, float palette[16][4])
+		{
+			uint32_t a[4];
+			uint32_t b[4];
+			bc7Expand(e0, a);
+			bc7Expand(e1, b);
+
+			for (int i = 0; i < 16; i++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					palette[i][c] = static_cast<float>(((64 - BC7_WEIGHTS_INT[i]) * a[c] + BC7_WEIGHTS_INT[i] * b[c] + 32) >> 6);
+				}
+			}
+		}
+
+		inline float bc7Fit(const Block& block, const float e0[4], const float e1[4],
+			BC7Endpoint& q0, BC7Endpoint& q1, uint8_t indices[16])
+		{
+			q0 = bc7Quantize(e0);
+			q1 = bc7Quantize(e1);
+
+			float palette[16][4];
+			bc7Palette(q0, q1, palette);
+			return selectIndices(block, 4, palette, 16, indices);
+		}
+
+		//writes count bits of value starting at bit offset into a 128 bit block
+		inline void writeBits(uint8_t output[16], uint32_t& offset, uint32_t value, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++, offset++)
+			{
+				if ((value >> i) & 1) output[offset / 8] |= static_cast<uint8_t>(1 << (offset % 8));
+			}
+		}
+
+		inline uint32_t readBits(const uint8_t input[16], uint32_t& offset, uint32_t count)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; i++, offset++)
+			{
+				value |= ((input[offset / 8] >> (offset % 8)) & 1u) << i;
+			}
+			return value;
+		}
+
+		inline void encodeBC7(const Block& block, Quality quality, uint8_t output[16])
+		{
+			float e0[4];
+			float e1[4];
+			findEndpoints(block, 4, quality, e0, e1);
+
+			BC7Endpoint q0, q1;
+			uint8_t indices[16];
+			float error = bc7Fit(block, e0, e1, q0, q1, indices);
+
+			if (quality != Quality::Fast)
+			{
+				float b0[4];
+				float b1[4];
+				findEndpoints(block, 4, Quality::Fast, b0, b1);
+
+				BC7Endpoint n0, n1;
+				uint8_t newIndices[16];
+				float newError = bc7Fit(block, b0, b1, n0, n1, newIndices);
+				if (newError < error)
+				{
+					error = newError;
+					q0 = n0;
+					q1 = n1;
+					memcpy(indices, newIndices, 16);
+				}
+			}
+
+			if (quality == Quality::High)
+			{
+				for (int iteration = 0; iteration < 3 && error > 0.0f; iteration++)
+				{
+					float r0[4];
+					float r1[4];
+					if (!refineEndpoints(block, 4, indices, BC7_WEIGHTS, r0, r1)) break;
+
+					BC7Endpoint n0, n1;
+					uint8_t newIndices[16];
+					float newError = bc7Fit(block, r0, r1, n0, n1, newIndices);
+					if (newError >= error) break;
+
+					error = newError;
+					q0 = n0;
+					q1 = n1;
+					memcpy(indices, newIndices, 16);
+				}
+			}
+
+			//the first pixel's index only has 3 bits, so its top bit has to be 0
+			//if it isn't, swapping the endpoints flips every index
+			if (indices[0] & 8)
+			{
+				std::swap(q0, q1);
+				for (int i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+			}
+
+			memset(output, 0, 16);
+			uint32_t offset = 0;
+			writeBits(output, offset, 1 << 6, 7);	//mode 6
+			for (int c = 0; c < 4; c++)
+			{
+				writeBits(output, offset, q0.value[c], 7);
+				writeBits(output, offset, q1.value[c], 7);
+			}
+			writeBits(output, offset, q0.pBit, 1);
+			writeBits(output, offset, q1.pBit, 1);
+			writeBits(output, offset, indices[0], 3);
+			for (int i = 1; i < 16; i++) writeBits(output, offset, indices[i], 4);
+		}
+
+		//only decodes mode 6, which is all encodeBC7 writes
+		//anything else decodes to magenta so it is obvious in a PSNR check
+		inline void decodeBC7(const uint8_t input[16], uint8_t rgba[64])
+		{
+			if ((input[0] & 0x7f) != 0x40)
+			{
+				for (int i = 0; i < 16; i++)
+				{
+					rgba[i * 4 + 0] = 255;
+					rgba[i * 4 + 1] = 0;
+					rgba[i * 4 + 2] = 255;
+					rgba[i * 4 + 3] = 255;
+				}
+				return;
+			}
+
+			uint32_t offset = 7;
+			BC7Endpoint e0, e1;
+			for (int c = 0; c < 4; c++)
+			{
+				e0.value[c] = static_cast<uint8_t>(readBits(input, offset, 7));
+				e1.value[c] = static_cast<uint8_t>(readBits(input, offset, 7));
+			}
+			e0.pBit = static_cast<uint8_t>(readBits(input, offset, 1));
+			e1.pBit = static_cast<uint8_t>(readBits(input, offset, 1));
+
+			float palette[16][4];
+			bc7Palette(e0, e1, palette);
+
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t index = readBits(input, offset, i == 0 ? 3 : 4);
+				for (int c = 0; c < 4; c++) rgba[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+			}
+		}
+
+#pragma endregion
+
+		inline void encodeBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+			Format format, Quality quality, uint8_t* output)
+		{
+			Block block;
+			uint8_t raw[64];
+			loadBlock(rgba, width, height, blockX, blockY, block, raw);
+
+			switch (format)
+			{
+			case Format::BC1:
+				encodeBC1(block, quality, output);
+				break;
+			case Format::BC3:
+				encodeBC4(block.a, quality, output);
+				encodeBC1(block, quality, output + 8);
+				break;
+			case Format::BC7:
+				encodeBC7(block, quality, output);
+				break;
+			}
+		}
+
+		inline void decodeBlock(const uint8_t* input, Format format, uint8_t rgba[64])
+		{
+			switch (format)
+			{
+			case Format::BC1:
+				decodeBC1(input, rgba);
+				break;
+			case Format::BC3:
+				decodeBC1(input + 8, rgba);
+				decodeBC4(input, rgba);
+				break;
+			case Format::BC7:
+				decodeBC7(input, rgba);
+				break;
+			}
+		}
+	}
+
+	//compresses an RGBA8 image, splitting the rows of blocks across the pool if there is one
+	inline std::vector<uint8_t> compress(const uint8_t* rgba, uint32_t width, uint32_t height,
+		Format format, Quality quality, ThreadPool* pool = nullptr)
+	{
+		uint32_t blocksX = (width + 3) / 4;
+		uint32_t blocksY = (height + 3) / 4;
+		size_t bytesPerBlock = blockBytes(format);
+		std::vector<uint8_t> result(compressedSize(format, width, height));
+
+		auto encodeRows = [=, &result](uint32_t firstRow, uint32_t lastRow) {
+			for (uint32_t y = firstRow; y < lastRow; y++)
+			{
+				for (uint32_t x = 0; x < blocksX; x++)
+				{
+					detail::encodeBlock(rgba, width, height, x, y, format, quality,
+						result.data() + (static_cast<size_t>(y) * blocksX + x) * bytesPerBlock);
+				}
+			}
+		};
+
+		if (pool == nullptr || pool->size() == 0 || blocksY < 2)
+		{
+			encodeRows(0, blocksY);
+			return result;
+		}
+
+		//a few chunks per worker so uneven blocks still balance out
+		uint32_t chunkCount = std::min(blocksY, static_cast<uint32_t>(pool->size() * 4));
+		uint32_t rowsPerChunk = (blocksY + chunkCount - 1) / chunkCount;
+
+		std::vector<std::future<void>> chunks;
+		for (uint32_t first = 0; first < blocksY; first += rowsPerChunk)
+		{
+			uint32_t last = std::min(blocksY, first + rowsPerChunk);
+			chunks.push_back(pool->submit([=]() { encodeRows(first, last); }));
+		}
+		for (auto& chunk : chunks)
+		{
+			chunk.get();
+		}
+
+		return result;
+	}
+
+	inline std::vector<uint8_t> decompress(const uint8_t* data, uint32_t width, uint32_t height, Format format)
+	{
+		uint32_t blocksX = (width + 3) / 4;
+		uint32_t blocksY = (height + 3) / 4;
+		size_t bytesPerBlock = blockBytes(format);
+		std::vector<uint8_t> result(static_cast<size_t>(width) * height * 4);
+
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				uint8_t rgba[64];
+				detail::decodeBlock(data + (static_cast<size_t>(by) * blocksX + bx) * bytesPerBlock, format, rgba);
+
+				for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+				{
+					for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+					{
+						memcpy(result.data() + ((static_cast<size_t>(by) * 4 + y) * width + bx * 4 + x) * 4, rgba + (y * 4 + x) * 4, 4);
+					}
+				}
+			}
+		}
+
+		return result;
+	}
+
+	//peak signal to noise ratio in dB between two RGBA8 images, higher is better
+	//~35dB and up is hard to tell apart from the original, identical images return infinity
+	inline double computePSNR(const uint8_t* original, const uint8_t* compressed, size_t pixelCount, bool includeAlpha)
+	{
+		int channels = includeAlpha ? 4 : 3;
+		double sum = 0.0;
+
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			for (int c = 0; c < channels; c++)
+			{
+				double d = static_cast<double>(original[i * 4 + c]) - compressed[i * 4 + c];
+				sum += d * d;
+			}
+		}
+
+		double meanSquaredError = sum / (static_cast<double>(pixelCount) * channels);
+		if (meanSquaredError == 0.0) return INFINITY;
+
+		return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+	}
+
+	inline bool hasAlpha(const uint8_t* rgba, size_t pixelCount)
+	{
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			if (rgba[i * 4 + 3] != 255) return true;
+		}
+		return false;
+	}
+}
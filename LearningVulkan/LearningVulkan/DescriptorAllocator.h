@@ -0,0 +1,368 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DescriptorTemplate.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+//hands out descriptor sets from a chain of pools, a new pool is added whenever the current one runs out
+	//each new pool is bigger than the last, up to MAX_SETS_PER_POOL
+//sets are never freed one at a time, reset gives every pool back at once with vkResetDescriptorPool
+	//which is what a per frame allocator wants, reset it once that frame's fence has signaled
+class DescriptorAllocator
+{
+public:
+	//descriptors of a type per set, a pool for n sets gets n * ratio of that type
+	struct PoolSizeRatio
+	{
+		VkDescriptorType type;
+		float ratio;
+	};
+
+	static const uint32_t MAX_SETS_PER_POOL = 4096;
+
+	void init(VkDevice device, uint32_t initialSetsPerPool, const std::vector<PoolSizeRatio>& ratios)
+	{
+		this->device = device;
+		this->ratios = ratios;
+		setsPerPool = initialSetsPerPool;
+	}
+
+	void destroy()
+	{
+		if (device == VK_NULL_HANDLE) return;
+
+		for (VkDescriptorPool pool : usedPools)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		for (VkDescriptorPool pool : freePools)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		usedPools.clear();
+		freePools.clear();
+		currentPool = VK_NULL_HANDLE;
+		device = VK_NULL_HANDLE;
+	}
+
+	bool isInitialized() const { return device != VK_NULL_HANDLE; }
+
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout)
+	{
+		if (currentPool == VK_NULL_HANDLE)
+		{
+			currentPool = grabPool();
+		}
+
+		VkDescriptorSet set;
+		VkResult result = tryAllocate(currentPool, layout, set);
+
+		//a full pool says so with either of these, the fragmented one can happen even though nothing is freed individually
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			currentPool = grabPool();
+			result = tryAllocate(currentPool, layout, set);
+		}
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+
+		return set;
+	}
+
+	//every set allocated so far becomes invalid, so nothing still pending on the GPU can be using them
+	void reset()
+	{
+		for (VkDescriptorPool pool : usedPools)
+		{
+			vkResetDescriptorPool(device, pool, 0);
+			freePools.push_back(pool);
+		}
+		usedPools.clear();
+		currentPool = VK_NULL_HANDLE;
+	}
+
+	size_t getPoolCount() const { return usedPools.size() + freePools.size(); }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	std::vector<PoolSizeRatio> ratios;
+	uint32_t setsPerPool = 0;
+
+	VkDescriptorPool currentPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorPool> usedPools;	//have had sets allocated since the last reset
+	std::vector<VkDescriptorPool> freePools;	//reset and ready to go again
+
+	VkResult tryAllocate(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkDescriptorSet& set)
+	{
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		return vkAllocateDescriptorSets(device, &allocInfo, &set);
+	}
+
+	//reuses a reset pool if there is one
+	VkDescriptorPool grabPool()
+	{
+		VkDescriptorPool pool;
+		if (!freePools.empty())
+		{
+			pool = freePools.back();
+			freePools.pop_back();
+		}
+		else
+		{
+			pool = createPool(setsPerPool);
+			setsPerPool = std::min(MAX_SETS_PER_POOL, setsPerPool + setsPerPool / 2);
+		}
+
+		usedPools.push_back(pool);
+		return pool;
+	}
+
+	VkDescriptorPool createPool(uint32_t setCount)
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const PoolSizeRatio& ratio : ratios)
+		{
+			VkDescriptorPoolSize poolSize = {};
+			poolSize.type = ratio.type;
+			poolSize.descriptorCount = std::max(1u, static_cast<uint32_t>(ratio.ratio * setCount));
+			poolSizes.push_back(poolSize);
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = 0;	//no FREE_DESCRIPTOR_SET_BIT, sets only go back with a reset
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = setCount;
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+		return pool;
+	}
+};
+
+//sets that never change after they're written, looked up by a hash of their layout and contents
+	//asking for the same bindings twice gives back the same set instead of allocating and writing another
+//the sets come from an allocator that is never reset while the cache is using it
+//sets are written with an update template made from the bindings the first time a layout is seen
+	//the Binding array passed to get is the packed struct the template reads from
+class DescriptorCache
+{
+public:
+	//what one binding of a set points at, only the fields for its type are looked at
+	struct Binding
+	{
+		uint32_t binding = 0;
+		VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		VkDescriptorBufferInfo buffer = {};
+		VkDescriptorImageInfo image = {};
+
+		static Binding uniformBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+		{
+			Binding b;
+			b.binding = binding;
+			b.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			b.buffer = { buffer, offset, range };
+			return b;
+		}
+
+		static Binding combinedImageSampler(uint32_t binding, VkImageView view, VkSampler sampler,
+			VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{
+			Binding b;
+			b.binding = binding;
+			b.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			b.image = { sampler, view, layout };
+			return b;
+		}
+
+		bool isImage() const { return DescriptorSetDescription::isImageType(type); }
+	};
+
+	void init(VkDevice device, DescriptorAllocator* allocator)
+	{
+		this->device = device;
+		this->allocator = allocator;
+	}
+
+	VkDescriptorSet get(VkDescriptorSetLayout layout, const std::vector<Binding>& bindings)
+	{
+		Key key = makeKey(layout, bindings);
+
+		auto found = sets.find(key);
+		if (found != sets.end())
+		{
+			hits++;
+			return found->second;
+		}
+
+		misses++;
+
+		//a released set of the same layout is rewritten rather than allocating another one
+		VkDescriptorSet set;
+		auto released = releasedSets.find(layout);
+		if (released != releasedSets.end() && !released->second.empty())
+		{
+			set = released->second.back();
+			released->second.pop_back();
+		}
+		else
+		{
+			set = allocator->allocate(layout);
+		}
+
+		write(layout, set, bindings);
+		sets.emplace(key, set);
+		return set;
+	}
+
+	//for when something a set points at is destroyed, the set is dropped from the cache and kept for reuse
+		//it mustn't be in use by a pending command buffer, since get will write over it
+	void release(VkDescriptorSet set)
+	{
+		for (auto it = sets.begin(); it != sets.end(); ++it)
+		{
+			if (it->second == set)
+			{
+				releasedSets[it->first.layout].push_back(set);
+				sets.erase(it);
+				return;
+			}
+		}
+	}
+
+	//the allocator has to be reset along with this, the sets are still allocated from it otherwise
+	void clear()
+	{
+		sets.clear();
+		releasedSets.clear();
+	}
+
+	void destroy()
+	{
+		if (device == VK_NULL_HANDLE) return;
+
+		for (auto& updateTemplate : templates)
+		{
+			vkDestroyDescriptorUpdateTemplate(device, updateTemplate.second, nullptr);
+		}
+		templates.clear();
+		clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	size_t getSize() const { return sets.size(); }
+	uint64_t getHits() const { return hits; }
+	uint64_t getMisses() const { return misses; }
+
+private:
+	//the bindings flattened out, so two keys with the same contents compare equal byte for byte
+	struct Key
+	{
+		VkDescriptorSetLayout layout;
+		std::vector<uint64_t> words;
+
+		bool operator==(const Key& other) const
+		{
+			return layout == other.layout && words == other.words;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			//FNV-1a over the handle and the words
+			uint64_t hash = 14695981039346656037ull;
+			auto mix = [&hash](uint64_t value) {
+				hash ^= value;
+				hash *= 1099511628211ull;
+			};
+
+			mix(reinterpret_cast<uint64_t>(key.layout));
+			for (uint64_t word : key.words)
+			{
+				mix(word);
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DescriptorAllocator* allocator = nullptr;
+	std::unordered_map<Key, VkDescriptorSet, KeyHash> sets;
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> releasedSets;
+	//keyed by the layout and the binding numbers and types, which is all a template depends on
+	std::unordered_map<Key, VkDescriptorUpdateTemplate, KeyHash> templates;
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+
+	static Key makeKey(VkDescriptorSetLayout layout, const std::vector<Binding>& bindings)
+	{
+		Key key;
+		key.layout = layout;
+		key.words.reserve(bindings.size() * 4);
+
+		for (const Binding& b : bindings)
+		{
+			key.words.push_back((static_cast<uint64_t>(b.binding) << 32) | static_cast<uint64_t>(b.type));
+			if (b.isImage())
+			{
+				key.words.push_back(reinterpret_cast<uint64_t>(b.image.imageView));
+				key.words.push_back(reinterpret_cast<uint64_t>(b.image.sampler));
+				key.words.push_back(static_cast<uint64_t>(b.image.imageLayout));
+			}
+			else
+			{
+				key.words.push_back(reinterpret_cast<uint64_t>(b.buffer.buffer));
+				key.words.push_back(b.buffer.offset);
+				key.words.push_back(b.buffer.range);
+			}
+		}
+		return key;
+	}
+
+	void write(VkDescriptorSetLayout layout, VkDescriptorSet set, const std::vector<Binding>& bindings)
+	{
+		Key signature;
+		signature.layout = layout;
+		for (const Binding& b : bindings)
+		{
+			signature.words.push_back((static_cast<uint64_t>(b.binding) << 32) | static_cast<uint64_t>(b.type));
+		}
+
+		auto found = templates.find(signature);
+		if (found == templates.end())
+		{
+			DescriptorSetDescription description;
+			for (size_t i = 0; i < bindings.size(); i++)
+			{
+				size_t offset = i * sizeof(Binding) + (bindings[i].isImage() ? offsetof(Binding, image) : offsetof(Binding, buffer));
+				description.add(bindings[i].binding, bindings[i].type, 0, offset);
+			}
+
+			found = templates.emplace(signature, description.createUpdateTemplate(device, layout)).first;
+		}
+
+		vkUpdateDescriptorSetWithTemplate(device, set, found->second, bindings.data());
+	}
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+
+//a descriptor set layout described once, along with where each binding's descriptors sit in a packed struct
+//the same description makes the VkDescriptorSetLayout and a VkDescriptorUpdateTemplate for it
+	//with the template a whole set is written from one pointer to the struct, the driver already knows the offsets
+	//instead of filling in and validating a VkWriteDescriptorSet per binding every time
+//the struct holds VkDescriptorBufferInfo for buffers and VkDescriptorImageInfo for images and samplers, e.g.
+	//struct ModelDescriptors { VkDescriptorBufferInfo uniformBuffer; VkDescriptorImageInfo texture; };
+	//description.add(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, offsetof(ModelDescriptors, uniformBuffer));
+class DescriptorSetDescription
+{
+public:
+	struct Entry
+	{
+		uint32_t binding;
+		VkDescriptorType type;
+		VkShaderStageFlags stageFlags;
+		uint32_t count;
+		size_t offset;	//of the first descriptor in the packed struct
+		size_t stride;	//between array elements
+	};
+
+	static bool isImageType(VkDescriptorType type)
+	{
+		return type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+			|| type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || type == VK_DESCRIPTOR_TYPE_SAMPLER
+			|| type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	}
+
+	//stride 0 means the array elements are packed back to back
+	DescriptorSetDescription& add(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stageFlags,
+		size_t offset, uint32_t count = 1, size_t stride = 0)
+	{
+		Entry entry;
+		entry.binding = binding;
+		entry.type = type;
+		entry.stageFlags = stageFlags;
+		entry.count = count;
+		entry.offset = offset;
+		entry.stride = stride != 0 ? stride : (isImageType(type) ? sizeof(VkDescriptorImageInfo) : sizeof(VkDescriptorBufferInfo));
+		entries.push_back(entry);
+		return *this;
+	}
+
+	VkDescriptorSetLayout createLayout(VkDevice device) const
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings(entries.size());
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			bindings[i] = {};
+			bindings[i].binding = entries[i].binding;
+			bindings[i].descriptorType = entries[i].type;
+			bindings[i].descriptorCount = entries[i].count;
+			bindings[i].stageFlags = entries[i].stageFlags;
+			bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+		return layout;
+	}
+
+	//layout has to be the one createLayout made from this description, or one compatible with it
+	VkDescriptorUpdateTemplate createUpdateTemplate(VkDevice device, VkDescriptorSetLayout layout) const
+	{
+		std::vector<VkDescriptorUpdateTemplateEntry> templateEntries(entries.size());
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			templateEntries[i] = {};
+			templateEntries[i].dstBinding = entries[i].binding;
+			templateEntries[i].dstArrayElement = 0;
+			templateEntries[i].descriptorCount = entries[i].count;
+			templateEntries[i].descriptorType = entries[i].type;
+			templateEntries[i].offset = entries[i].offset;
+			templateEntries[i].stride = entries[i].stride;
+		}
+
+		VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+		templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+		templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+		templateInfo.pDescriptorUpdateEntries = templateEntries.data();
+		templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+		templateInfo.descriptorSetLayout = layout;
+
+		VkDescriptorUpdateTemplate updateTemplate;
+		if (vkCreateDescriptorUpdateTemplate(device, &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor update template!");
+		}
+		return updateTemplate;
+	}
+
+	//the same update without a template, one VkWriteDescriptorSet per binding
+	//arrays with a stride other than their info struct's size aren't supported here, the template path handles those
+	void writeClassic(VkDevice device, VkDescriptorSet set, const void* data) const
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+		std::vector<VkWriteDescriptorSet> descriptorWrites(entries.size());
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			descriptorWrites[i] = {};
+			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[i].dstSet = set;
+			descriptorWrites[i].dstBinding = entries[i].binding;
+			descriptorWrites[i].dstArrayElement = 0;
+			descriptorWrites[i].descriptorType = entries[i].type;
+			descriptorWrites[i].descriptorCount = entries[i].count;
+			if (isImageType(entries[i].type))
+			{
+				descriptorWrites[i].pImageInfo = reinterpret_cast<const VkDescriptorImageInfo*>(bytes + entries[i].offset);
+			}
+			else
+			{
+				descriptorWrites[i].pBufferInfo = reinterpret_cast<const VkDescriptorBufferInfo*>(bytes + entries[i].offset);
+			}
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	const std::vector<Entry>& getEntries() const { return entries; }
+
+private:
+	std::vector<Entry> entries;
+};
+
+//writes a whole set from a packed struct laid out the way the description said
+template<typename T>
+void updateDescriptorSet(VkDevice device, VkDescriptorSet set, VkDescriptorUpdateTemplate updateTemplate, const T& data)
+{
+	vkUpdateDescriptorSetWithTemplate(device, set, updateTemplate, &data);
+}
@@ -0,0 +1,489 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+//generates a mip chain with one compute dispatch, see shaders/downsample.comp
+//compared to the vkCmdBlitImage chain in TriApp::recordBlitMipmaps:
+	//2 barrier batches in total instead of 1 per level
+	//averages in linear space for sRGB encoded data
+	//can reduce with min or max instead of averaging, which is what a depth pyramid needs
+//a target is one source + destination pair with its descriptor set, create it once and record it as often as needed
+class Downsampler
+{
+public:
+	enum class Reduction
+	{
+		Average = 0,
+		Min = 1,
+		Max = 2
+	};
+
+	//which build of the shader to use, depends on the destination format
+	enum class Variant
+	{
+		Color,	//rgba8
+		Depth	//r32f, for depth pyramids
+	};
+
+	static const uint32_t MAX_MIPS = 12;
+	//level 6 has to fit in a single 64x64 block for the last workgroup
+	static const uint32_t MAX_SIZE = 4096;
+	static const uint32_t MAX_TARGETS = 16;
+
+	struct TargetInfo
+	{
+		VkImage source;
+		VkFormat sourceFormat;
+		VkImageAspectFlags sourceAspect;
+		uint32_t sourceLevel;
+		uint32_t sourceWidth;
+		uint32_t sourceHeight;
+		//reduces 2^sourceShift x 2^sourceShift source texels into each one the shader reads, for sources larger than MAX_SIZE
+			//0 for textures, a depth pyramid can take a coarser level 0 instead
+		uint32_t sourceShift;
+		//destinationBaseLevel gets the source's size / 2 (/ 2^sourceShift), so for a texture this is the same image with base level 1
+		VkImage destination;
+		VkFormat destinationFormat;
+		uint32_t destinationBaseLevel;
+		uint32_t mipCount;
+		Variant variant;
+	};
+
+	struct Target
+	{
+		VkImageView sourceView = VK_NULL_HANDLE;
+		std::vector<VkImageView> mipViews;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkBuffer counterBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory counterBufferMemory = VK_NULL_HANDLE;
+		uint32_t groupCountX = 0;
+		uint32_t groupCountY = 0;
+		uint32_t mipCount = 0;
+		uint32_t sourceShift = 0;
+		Variant variant = Variant::Color;
+	};
+
+	static bool canDownsample(uint32_t width, uint32_t height, uint32_t mipCount)
+	{
+		return width <= MAX_SIZE && height <= MAX_SIZE && mipCount <= MAX_MIPS;
+	}
+
+	//either block of SPIR-V can be empty if that variant isn't needed
+	void init(VkPhysicalDevice physicalDevice, VkDevice device,
+		const std::vector<char>& colorShaderCode, const std::vector<char>& depthShaderCode)
+	{
+		this->physicalDevice = physicalDevice;
+		this->device = device;
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings(3);
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount = MAX_MIPS;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[2].binding = 2;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[2].descriptorCount = 1;
+		bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler descriptor set layout!");
+		}
+
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler pipeline layout!");
+		}
+
+		std::vector<VkDescriptorPoolSize> poolSizes(3);
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[0].descriptorCount = MAX_TARGETS;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		poolSizes[1].descriptorCount = MAX_TARGETS * MAX_MIPS;
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[2].descriptorCount = MAX_TARGETS;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = MAX_TARGETS;
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler descriptor pool!");
+		}
+
+		//texelFetch ignores filtering, but a combined image sampler still needs a sampler
+		VkSamplerCreateInfo samplerInfo = {};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+		if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler sampler!");
+		}
+
+		if (!colorShaderCode.empty()) colorShaderModule = createShaderModule(colorShaderCode);
+		if (!depthShaderCode.empty()) depthShaderModule = createShaderModule(depthShaderCode);
+	}
+
+	void destroy()
+	{
+		if (device == VK_NULL_HANDLE) return;
+
+		for (auto& pipeline : pipelines)
+		{
+			vkDestroyPipeline(device, pipeline.second, nullptr);
+		}
+		pipelines.clear();
+
+		if (colorShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, colorShaderModule, nullptr);
+		if (depthShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, depthShaderModule, nullptr);
+		vkDestroySampler(device, sampler, nullptr);
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+		colorShaderModule = VK_NULL_HANDLE;
+		depthShaderModule = VK_NULL_HANDLE;
+		device = VK_NULL_HANDLE;
+	}
+
+	bool isInitialized() const { return device != VK_NULL_HANDLE; }
+
+	bool hasVariant(Variant variant) const
+	{
+		return (variant == Variant::Color ? colorShaderModule : depthShaderModule) != VK_NULL_HANDLE;
+	}
+
+	//the destination needs VK_IMAGE_USAGE_STORAGE_BIT and the source VK_IMAGE_USAGE_SAMPLED_BIT
+	Target createTarget(const TargetInfo& info)
+	{
+		uint32_t width = (info.sourceWidth + (1u << info.sourceShift) - 1) >> info.sourceShift;
+		uint32_t height = (info.sourceHeight + (1u << info.sourceShift) - 1) >> info.sourceShift;
+		if (!canDownsample(width, height, info.mipCount) || info.mipCount == 0)
+		{
+			throw std::runtime_error("image is too large for the single pass downsampler!");
+		}
+
+		Target target;
+		target.mipCount = info.mipCount;
+		target.sourceShift = info.sourceShift;
+		target.variant = info.variant;
+		target.groupCountX = (width + 63) / 64;
+		target.groupCountY = (height + 63) / 64;
+
+		target.sourceView = createView(info.source, info.sourceFormat, info.sourceAspect, info.sourceLevel);
+		for (uint32_t i = 0; i < info.mipCount; i++)
+		{
+			target.mipViews.push_back(createView(info.destination, info.destinationFormat,
+				VK_IMAGE_ASPECT_COLOR_BIT, info.destinationBaseLevel + i));
+		}
+
+		createCounterBuffer(target);
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &descriptorSetLayout;
+
+		if (vkAllocateDescriptorSets(device, &allocInfo, &target.descriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate downsampler descriptor set!");
+		}
+
+		VkDescriptorImageInfo sourceInfo = {};
+		sourceInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		sourceInfo.imageView = target.sourceView;
+		sourceInfo.sampler = sampler;
+
+		//every slot of the array has to hold a valid view, the shader never writes the ones past mipCount
+		std::vector<VkDescriptorImageInfo> mipInfos(MAX_MIPS);
+		for (uint32_t i = 0; i < MAX_MIPS; i++)
+		{
+			mipInfos[i] = {};
+			mipInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			mipInfos[i].imageView = target.mipViews[std::min(i, info.mipCount - 1)];
+		}
+
+		VkDescriptorBufferInfo counterInfo = {};
+		counterInfo.buffer = target.counterBuffer;
+		counterInfo.offset = 0;
+		counterInfo.range = sizeof(uint32_t);
+
+		std::vector<VkWriteDescriptorSet> writes(3);
+		for (auto& write : writes)
+		{
+			write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = target.descriptorSet;
+			write.dstArrayElement = 0;
+			write.descriptorCount = 1;
+		}
+		writes[0].dstBinding = 0;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].pImageInfo = &sourceInfo;
+		writes[1].dstBinding = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].descriptorCount = MAX_MIPS;
+		writes[1].pImageInfo = mipInfos.data();
+		writes[2].dstBinding = 2;
+		writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[2].pBufferInfo = &counterInfo;
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+		return target;
+	}
+
+	//only once every command buffer that recorded the target has finished
+	void destroyTarget(Target& target)
+	{
+		vkFreeDescriptorSets(device, descriptorPool, 1, &target.descriptorSet);
+		vkDestroyBuffer(device, target.counterBuffer, nullptr);
+		vkFreeMemory(device, target.counterBufferMemory, nullptr);
+		vkDestroyImageView(device, target.sourceView, nullptr);
+		for (VkImageView view : target.mipViews)
+		{
+			vkDestroyImageView(device, view, nullptr);
+		}
+		target = Target();
+	}
+
+	//records the dispatch only, layouts are left to the caller:
+		//the source level has to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		//the destination levels have to be in VK_IMAGE_LAYOUT_GENERAL, and are written by the compute shader stage
+	void record(VkCommandBuffer commandBuffer, const Target& target, Reduction reduction, bool srgb)
+	{
+		//the counter is reset every time so an interrupted dispatch can't leave it off by some amount
+		VkBufferMemoryBarrier counterBarrier = {};
+		counterBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		counterBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		counterBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		counterBarrier.buffer = target.counterBuffer;
+		counterBarrier.offset = 0;
+		counterBarrier.size = sizeof(uint32_t);
+
+		//a target recorded every frame (the depth pyramid) can still have last frame's dispatch counting on it
+		counterBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		counterBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 1, &counterBarrier, 0, nullptr);
+
+		vkCmdFillBuffer(commandBuffer, target.counterBuffer, 0, sizeof(uint32_t), 0);
+
+		counterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr, 1, &counterBarrier, 0, nullptr);
+
+		PushConstants constants = {};
+		constants.mipCount = static_cast<int32_t>(target.mipCount);
+		constants.workGroupCount = target.groupCountX * target.groupCountY;
+		constants.sourceShift = static_cast<int32_t>(target.sourceShift);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, getPipeline(target.variant, reduction, srgb));
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &target.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(commandBuffer, target.groupCountX, target.groupCountY, 1);
+	}
+
+private:
+	struct PushConstants
+	{
+		int32_t mipCount;
+		uint32_t workGroupCount;
+		int32_t sourceShift;
+	};
+
+	struct SpecializationData
+	{
+		int32_t reduction;
+		VkBool32 srgb;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkShaderModule colorShaderModule = VK_NULL_HANDLE;
+	VkShaderModule depthShaderModule = VK_NULL_HANDLE;
+	//one pipeline per variant/reduction/srgb combination, made the first time it is recorded
+	std::map<uint32_t, VkPipeline> pipelines;
+
+	VkShaderModule createShaderModule(const std::vector<char>& code)
+	{
+		VkShaderModuleCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler shader module!");
+		}
+
+		return shaderModule;
+	}
+
+	VkPipeline getPipeline(Variant variant, Reduction reduction, bool srgb)
+	{
+		uint32_t key = static_cast<uint32_t>(variant) * 8 + static_cast<uint32_t>(reduction) * 2 + (srgb ? 1 : 0);
+		auto existing = pipelines.find(key);
+		if (existing != pipelines.end()) return existing->second;
+
+		if (!hasVariant(variant))
+		{
+			throw std::runtime_error("downsampler shader variant wasn't loaded!");
+		}
+
+		//the reduction and colour space are specialization constants, so the driver can drop the unused branches
+		SpecializationData specializationData = {};
+		specializationData.reduction = static_cast<int32_t>(reduction);
+		specializationData.srgb = srgb ? VK_TRUE : VK_FALSE;
+
+		VkSpecializationMapEntry entries[2] = {};
+		entries[0].constantID = 0;
+		entries[0].offset = offsetof(SpecializationData, reduction);
+		entries[0].size = sizeof(int32_t);
+		entries[1].constantID = 1;
+		entries[1].offset = offsetof(SpecializationData, srgb);
+		entries[1].size = sizeof(VkBool32);
+
+		VkSpecializationInfo specializationInfo = {};
+		specializationInfo.mapEntryCount = 2;
+		specializationInfo.pMapEntries = entries;
+		specializationInfo.dataSize = sizeof(specializationData);
+		specializationInfo.pData = &specializationData;
+
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = variant == Variant::Color ? colorShaderModule : depthShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+		pipelineInfo.layout = pipelineLayout;
+
+		VkPipeline pipeline;
+		if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler pipeline!");
+		}
+
+		pipelines[key] = pipeline;
+		return pipeline;
+	}
+
+	VkImageView createView(VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t level)
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = aspect;
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkImageView view;
+		if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler image view!");
+		}
+
+		return view;
+	}
+
+	void createCounterBuffer(Target& target)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = sizeof(uint32_t);
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &target.counterBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create downsampler counter buffer!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, target.counterBuffer, &memRequirements);
+
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		uint32_t memoryType = UINT32_MAX;
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+		{
+			if ((memRequirements.memoryTypeBits & (1 << i))
+				&& (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				memoryType = i;
+				break;
+			}
+		}
+
+		if (memoryType == UINT32_MAX)
+		{
+			throw std::runtime_error("failed to find a memory type for the downsampler counter!");
+		}
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = memoryType;
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &target.counterBufferMemory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate downsampler counter memory!");
+		}
+
+		vkBindBufferMemory(device, target.counterBuffer, target.counterBufferMemory, 0);
+	}
+};
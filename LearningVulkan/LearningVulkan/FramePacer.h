@@ -0,0 +1,412 @@
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+//older SDKs don't have it, CreateWaitableTimerExW fails with it before Windows 10 1803
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <ctime>
+#include <algorithm>
+#include <stdexcept>
+
+#include "SubmitScheduler.h"
+
+//decides how the swap chain presents, holds the frame loop to a target frame rate and measures each frame's latency
+	//choosePresentMode and chooseImageCount are for createSwapChain, the rest is driven from the frame loop
+//latency runs from the frame's submit until it's presented, with VK_KHR_present_wait
+	//without it, until the GPU has finished the frame, which is the earliest it can be presented
+	//either way it's found by polling from update, so it can read up to a frame late
+class FramePacer
+{
+public:
+	enum class PresentPolicy
+	{
+		LowLatency,	//mailbox, then immediate, then fifo
+		VSync,	//fifo, never tears but frames can queue up behind the display
+		AdaptiveVSync,	//fifo relaxed, then fifo, only tears when a frame misses its refresh
+		Uncapped	//immediate, then mailbox, then fifo
+	};
+
+	struct Settings
+	{
+		PresentPolicy presentPolicy = PresentPolicy::LowLatency;
+		//0 for one more than the surface's minimum, always clamped to what the surface allows
+		uint32_t swapChainImages = 0;
+		//frames started per second, 0 for no limit
+		double targetFrameRate = 0.0;
+		//frames submitted but not finished on the GPU, clamped to [1, frames in flight]
+			//fewer means the CPU works on fresher input, more keeps the GPU busier
+		uint32_t maxQueuedFrames = 2;
+	};
+
+	//since the last resetStats
+		//frames are counted when they're submitted, frame times are between submits and leave out the time spent paused
+	struct Stats
+	{
+		uint32_t frameCount = 0;
+		double seconds = 0.0;
+		double minFrameMilliseconds = 0.0;
+		double maxFrameMilliseconds = 0.0;
+		uint32_t latencyCount = 0;
+		double averageLatencyMilliseconds = 0.0;
+		double maxLatencyMilliseconds = 0.0;
+		//CPU time the whole process used, over seconds, 1 is one core kept busy
+		double cpuUtilization = 0.0;
+	};
+
+	//the present modes each policy tries, in order, FIFO is the only one that's always there
+	static VkPresentModeKHR choosePresentMode(PresentPolicy policy, const std::vector<VkPresentModeKHR>& availableModes)
+	{
+		std::vector<VkPresentModeKHR> preferred;
+		switch (policy)
+		{
+		case PresentPolicy::LowLatency:
+			preferred = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+			break;
+		case PresentPolicy::VSync:
+			break;
+		case PresentPolicy::AdaptiveVSync:
+			preferred = { VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+			break;
+		case PresentPolicy::Uncapped:
+			preferred = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+			break;
+		}
+
+		for (VkPresentModeKHR mode : preferred)
+		{
+			if (std::find(availableModes.begin(), availableModes.end(), mode) != availableModes.end())
+			{
+				return mode;
+			}
+		}
+		return VK_PRESENT_MODE_FIFO_KHR;
+	}
+
+	static uint32_t chooseImageCount(uint32_t requested, const VkSurfaceCapabilitiesKHR& capabilities)
+	{
+		uint32_t imageCount = requested == 0 ? capabilities.minImageCount + 1 : requested;
+		imageCount = std::max(imageCount, capabilities.minImageCount);
+		//maxImageCount == 0, it means there is no limit besides memory requirements
+		if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
+		{
+			imageCount = capabilities.maxImageCount;
+		}
+		return imageCount;
+	}
+
+	static const char* presentModeName(VkPresentModeKHR mode)
+	{
+		switch (mode)
+		{
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+		default: return "unknown";
+		}
+	}
+
+	//both have to be chained into the device's features, presentWait.pNext is left for the caller to point at presentId
+	struct PresentWaitFeatures
+	{
+		VkPhysicalDevicePresentIdFeaturesKHR presentId;
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWait;
+	};
+
+	//VK_KHR_present_id and VK_KHR_present_wait have to be supported for this to mean anything
+	static bool isPresentWaitSupported(VkPhysicalDevice physicalDevice)
+	{
+		PresentWaitFeatures supported = {};
+		supported.presentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		supported.presentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		supported.presentWait.pNext = &supported.presentId;
+
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &supported.presentWait;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+		return supported.presentId.presentId == VK_TRUE && supported.presentWait.presentWait == VK_TRUE;
+	}
+
+	static PresentWaitFeatures requiredFeatures()
+	{
+		PresentWaitFeatures features = {};
+		features.presentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		features.presentId.presentId = VK_TRUE;
+		features.presentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		features.presentWait.presentWait = VK_TRUE;
+		return features;
+	}
+
+	//presentWait only if the device was made with both extensions and their features enabled
+	void init(VkDevice device, const Settings& settings, uint32_t framesInFlight, bool presentWait)
+	{
+		this->device = device;
+		this->settings = settings;
+		this->settings.maxQueuedFrames = std::min(std::max(settings.maxQueuedFrames, 1u), framesInFlight);
+
+		waitForPresent = nullptr;
+		if (presentWait)
+		{
+			waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+			if (waitForPresent == nullptr)
+			{
+				throw std::runtime_error("failed to load vkWaitForPresentKHR!");
+			}
+		}
+
+#ifdef _WIN32
+		//Sleep only wakes up on the system timer's tick, up to 15.6 ms late, a high resolution timer doesn't
+			//it's Windows 10 1803 and later, without it the tick is made 1 ms for as long as the pacer runs
+		sleepTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (sleepTimer == nullptr)
+		{
+			timerPeriodRaised = timeBeginPeriod(1) == TIMERR_NOERROR;
+		}
+#endif
+
+		nextFrameStart = Clock::now();
+		paused = true;
+		resetStats();
+	}
+
+	void destroy()
+	{
+#ifdef _WIN32
+		if (sleepTimer != nullptr)
+		{
+			CloseHandle(sleepTimer);
+			sleepTimer = nullptr;
+		}
+		if (timerPeriodRaised)
+		{
+			timeEndPeriod(1);
+			timerPeriodRaised = false;
+		}
+#endif
+		pending.clear();
+	}
+
+	const Settings& getSettings() const { return settings; }
+	bool usesPresentWait() const { return waitForPresent != nullptr; }
+
+	//call before anything in the frame reads input, returns once it's time for the frame to start
+	void waitForFrameStart()
+	{
+		if (paused)
+		{
+			nextFrameStart = Clock::now();
+		}
+		else if (settings.targetFrameRate > 0.0)
+		{
+			auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / settings.targetFrameRate));
+			nextFrameStart += period;
+
+			//more than a frame behind, start over from now instead of rushing frames out to catch up
+			Clock::time_point now = Clock::now();
+			if (now > nextFrameStart + period)
+			{
+				nextFrameStart = now;
+			}
+			sleepUntil(nextFrameStart);
+		}
+	}
+
+	//the loop went a while without drawing, like when it waits for events
+		//the next frame starts straight away and the gap isn't counted as a frame time
+	void pause()
+	{
+		paused = true;
+	}
+
+	//call right after the frame's submit, the id it returns goes in the present's VkPresentIdKHR
+	uint64_t frameSubmitted(SubmitScheduler::Ticket ticket)
+	{
+		Pending submitted;
+		submitted.presentId = ++lastPresentId;
+		submitted.ticket = ticket;
+		submitted.submitTime = Clock::now();
+		pending.push_back(submitted);
+
+		if (!paused)
+		{
+			double frameMilliseconds = std::chrono::duration<double, std::milli>(submitted.submitTime - lastSubmitTime).count();
+			stats.minFrameMilliseconds = timedFrameCount == 0 ? frameMilliseconds : std::min(stats.minFrameMilliseconds, frameMilliseconds);
+			stats.maxFrameMilliseconds = std::max(stats.maxFrameMilliseconds, frameMilliseconds);
+			timedFrameCount++;
+		}
+		stats.frameCount++;
+		lastSubmitTime = submitted.submitTime;
+		paused = false;
+
+		return submitted.presentId;
+	}
+
+	//the swap chain is about to be replaced, presents still pending on the old one aren't measured
+	void dropPending()
+	{
+		if (usesPresentWait()) pending.clear();
+	}
+
+	//measures the frames that have been presented, or finished on the GPU, since the last call
+	void update(SubmitScheduler& scheduler, VkSwapchainKHR swapChain)
+	{
+		while (!pending.empty())
+		{
+			const Pending& oldest = pending.front();
+			if (usesPresentWait())
+			{
+				VkResult result = waitForPresent(device, swapChain, oldest.presentId, 0);
+				if (result == VK_TIMEOUT) break;
+				//an out of date swap chain never presents it
+				if (result != VK_SUCCESS)
+				{
+					pending.pop_front();
+					continue;
+				}
+			}
+			else if (!scheduler.isDone(oldest.ticket))
+			{
+				break;
+			}
+
+			double latency = std::chrono::duration<double, std::milli>(Clock::now() - oldest.submitTime).count();
+			latencySum += latency;
+			stats.latencyCount++;
+			stats.maxLatencyMilliseconds = std::max(stats.maxLatencyMilliseconds, latency);
+			pending.pop_front();
+		}
+	}
+
+	Stats getStats() const
+	{
+		Stats current = stats;
+		current.seconds = std::chrono::duration<double>(Clock::now() - statsStart).count();
+		current.averageLatencyMilliseconds = stats.latencyCount > 0 ? latencySum / stats.latencyCount : 0.0;
+		current.cpuUtilization = current.seconds > 0.0 ? (processCpuSeconds() - statsStartCpuSeconds) / current.seconds : 0.0;
+		return current;
+	}
+
+	void resetStats()
+	{
+		stats = {};
+		timedFrameCount = 0;
+		latencySum = 0.0;
+		statsStart = Clock::now();
+		statsStartCpuSeconds = processCpuSeconds();
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	//what's left of a sleep is spun, sleeps can wake up this late
+	std::chrono::microseconds spinTime() const
+	{
+#ifdef _WIN32
+		if (sleepTimer != nullptr) return std::chrono::microseconds(500);
+		//a whole tick, if it couldn't be made 1 ms
+		return std::chrono::microseconds(timerPeriodRaised ? 2000 : 16000);
+#else
+		return std::chrono::microseconds(500);
+#endif
+	}
+
+	struct Pending
+	{
+		uint64_t presentId;
+		SubmitScheduler::Ticket ticket;
+		Clock::time_point submitTime;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	Settings settings;
+	PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+#ifdef _WIN32
+	HANDLE sleepTimer = nullptr;
+	bool timerPeriodRaised = false;	//timeBeginPeriod(1), for when there's no sleepTimer
+#endif
+
+	Clock::time_point nextFrameStart;
+	Clock::time_point lastSubmitTime;
+	bool paused = false;
+	//present ids only have to go up, so they aren't restarted for a new swap chain
+	uint64_t lastPresentId = 0;
+	std::deque<Pending> pending;	//oldest first
+
+	Stats stats;
+	uint32_t timedFrameCount = 0;	//frames in stats that came after another, not after a pause
+	double latencySum = 0.0;
+	Clock::time_point statsStart;
+	double statsStartCpuSeconds = 0.0;
+
+	//user and kernel time of every thread in the process
+	static double processCpuSeconds()
+	{
+#ifdef _WIN32
+		//std::clock is wall time with MSVC
+		FILETIME creationTime, exitTime, kernelTime, userTime;
+		if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) return 0.0;
+
+		ULARGE_INTEGER kernel, user;
+		kernel.LowPart = kernelTime.dwLowDateTime;
+		kernel.HighPart = kernelTime.dwHighDateTime;
+		user.LowPart = userTime.dwLowDateTime;
+		user.HighPart = userTime.dwHighDateTime;
+		return (kernel.QuadPart + user.QuadPart) * 100e-9;
+#else
+		return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+	}
+
+	void sleepUntil(Clock::time_point deadline)
+	{
+#ifdef _WIN32
+		bool preciseTimer = sleepTimer != nullptr;
+#endif
+		Clock::time_point wakeUp = deadline - spinTime();
+		Clock::time_point now = Clock::now();
+		if (now < wakeUp)
+		{
+#ifdef _WIN32
+			if (preciseTimer)
+			{
+				//negative is relative, in 100 ns units
+				LARGE_INTEGER dueTime;
+				dueTime.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(wakeUp - now).count() / 100);
+				if (SetWaitableTimerEx(sleepTimer, &dueTime, 0, nullptr, nullptr, nullptr, 0))
+				{
+					WaitForSingleObject(sleepTimer, INFINITE);
+				}
+			}
+			else
+			{
+				std::this_thread::sleep_until(wakeUp);
+			}
+#else
+			std::this_thread::sleep_until(wakeUp);
+#endif
+		}
+
+		while (Clock::now() < deadline)
+		{
+			std::this_thread::yield();
+		}
+	}
+};
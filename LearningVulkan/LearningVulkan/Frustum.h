@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cmath>
+
+//the 6 planes of a view frustum, pointing inwards, as (a, b, c, d) with a*x + b*y + c*z + d >= 0 on the inside
+//taken straight from a combined projection * view (* model) matrix, so the planes are in whatever space that matrix takes points from
+	//with a model matrix in there they're in model space, which lets bounds be tested without transforming them first
+class Frustum
+{
+public:
+	enum Plane
+	{
+		Left = 0,
+		Right,
+		Bottom,
+		Top,
+		Near,
+		Far,
+		PlaneCount
+	};
+
+	float planes[PlaneCount][4];
+
+	//m is column major like glm, pass &matrix[0][0]
+	//assumes a [0, 1] depth range (GLM_FORCE_DEPTH_ZERO_TO_ONE), so the near plane is just the third row
+	static Frustum fromMatrix(const float* m)
+	{
+		//each plane is a sum or difference of two rows, done one column at a time
+			//x, y, z and w are rows 0 to 3 of column i
+		Frustum frustum;
+		for (int i = 0; i < 4; i++)
+		{
+			float x = m[i * 4 + 0];
+			float y = m[i * 4 + 1];
+			float z = m[i * 4 + 2];
+			float w = m[i * 4 + 3];
+
+			frustum.planes[Left][i] = w + x;
+			frustum.planes[Right][i] = w - x;
+			frustum.planes[Bottom][i] = w + y;
+			frustum.planes[Top][i] = w - y;
+			frustum.planes[Near][i] = z;
+			frustum.planes[Far][i] = w - z;
+		}
+
+		//normalized so plane distances are real distances and can be compared with a radius
+		for (int p = 0; p < PlaneCount; p++)
+		{
+			float length = std::sqrt(frustum.planes[p][0] * frustum.planes[p][0]
+				+ frustum.planes[p][1] * frustum.planes[p][1]
+				+ frustum.planes[p][2] * frustum.planes[p][2]);
+			if (length > 0.0f)
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					frustum.planes[p][i] /= length;
+				}
+			}
+		}
+
+		return frustum;
+	}
+
+	//conservative, a sphere near a corner can pass without touching the frustum
+	bool intersectsSphere(float x, float y, float z, float radius) const
+	{
+		for (int p = 0; p < PlaneCount; p++)
+		{
+			if (planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
@@ -0,0 +1,406 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DescriptorTemplate.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+
+//frustum culls a list of objects in a compute shader and writes the draws for the visible ones, see shaders/cull.comp
+	//the CPU records the same dispatch and one indirect draw no matter how many objects there are or how many are visible
+//with VK_KHR_draw_indirect_count the visible draws are packed at the front and counted,
+	//and vkCmdDrawIndexedIndirectCountKHR reads the count on the GPU
+//without it every object gets a draw and the culled ones have instanceCount 0, drawn with vkCmdDrawIndexedIndirect
+//a target is the draw and count buffers for one object buffer, the shader writes them so they can't be shared between frames in flight
+//with occlusion (shaders/cull.comp built with -DOCCLUSION) culling runs in two phases around a depth pyramid
+	//early: draws what was visible last frame, going by a per object visibility buffer
+	//the caller builds a max depth pyramid from what the early draws left in the depth buffer
+	//late: tests everything in the frustum against the pyramid, updates the visibility buffer
+		//and draws what is visible now but wasn't drawn early
+class GpuCulling
+{
+public:
+	//one per object, laid out the way the shader reads it (std430)
+	struct Object
+	{
+		float boundingSphere[4];	//xyz center, w radius, in the space the frustum is in
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t firstInstance;	//the instance buffer entry the draw uses
+	};
+
+	struct Target
+	{
+		VkBuffer drawBuffer = VK_NULL_HANDLE;	//maxDraws VkDrawIndexedIndirectCommands
+		VkDeviceMemory drawBufferMemory = VK_NULL_HANDLE;
+		VkBuffer countBuffer = VK_NULL_HANDLE;	//one uint, the number of visible objects
+		VkDeviceMemory countBufferMemory = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		uint32_t maxDraws = 0;
+		uint32_t objectCount = 0;	//as of the last record
+		float depthPyramidScale[2] = {};
+	};
+
+	//visibilityBuffer and depthPyramid are only used with occlusion
+	struct TargetInfo
+	{
+		VkBuffer objectBuffer;	//at least maxDraws Objects, needs VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+		VkBuffer visibilityBuffer;	//one uint per object, 0 for not visible last frame, shared by every target
+		VkImageView depthPyramid;	//r32f, max reduced, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL when the late phase runs
+		//the screen's size in level 0 texels, the pyramid can be larger than the screen so every level halves exactly
+		float depthPyramidScale[2];
+		//more than one makes the draw and count buffers concurrent between them, for culling on another queue than the draws
+		uint32_t queueFamilyCount;
+		const uint32_t* queueFamilies;
+		uint32_t maxDraws;
+	};
+
+	//the values the shader checks pc.phase against
+	enum class Phase
+	{
+		All = 0,	//frustum culling only
+		Early = 1,
+		Late = 2
+	};
+
+	static const uint32_t MAX_TARGETS = 16;
+	static const uint32_t GROUP_SIZE = 64;
+
+	//more than one draw per indirect call and a firstInstance other than 0 both need a feature
+	static bool isSupported(const VkPhysicalDeviceFeatures& features)
+	{
+		return features.multiDrawIndirect && features.drawIndirectFirstInstance;
+	}
+
+	//drawIndirectCount says whether VK_KHR_draw_indirect_count was enabled on device
+	//occlusion has to match the build of the shader in shaderCode
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, const std::vector<char>& shaderCode, bool drawIndirectCount, bool occlusion)
+	{
+		this->physicalDevice = physicalDevice;
+		this->device = device;
+		this->occlusion = occlusion;
+
+		if (drawIndirectCount)
+		{
+			cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+				vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
+
+		setDescription
+			.add(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(TargetDescriptors, objects))
+			.add(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(TargetDescriptors, draws))
+			.add(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(TargetDescriptors, count));
+		if (occlusion)
+		{
+			setDescription
+				.add(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(TargetDescriptors, visibility))
+				.add(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, offsetof(TargetDescriptors, depthPyramid));
+		}
+		descriptorSetLayout = setDescription.createLayout(device);
+
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create culling pipeline layout!");
+		}
+
+		std::vector<VkDescriptorPoolSize> poolSizes(2);
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[0].descriptorCount = MAX_TARGETS * 4;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[1].descriptorCount = MAX_TARGETS;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = MAX_TARGETS;
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create culling descriptor pool!");
+		}
+
+		if (occlusion)
+		{
+			//the shader only uses texelFetch, but a combined image sampler still needs a sampler
+			VkSamplerCreateInfo samplerInfo = {};
+			samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+			samplerInfo.magFilter = VK_FILTER_NEAREST;
+			samplerInfo.minFilter = VK_FILTER_NEAREST;
+			samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+			if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create culling sampler!");
+			}
+		}
+
+		VkShaderModuleCreateInfo moduleInfo = {};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = shaderCode.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create culling shader module!");
+		}
+
+		//compaction is a specialization constant, so the driver drops whichever path isn't used
+		VkBool32 compact = usesDrawCount() ? VK_TRUE : VK_FALSE;
+
+		VkSpecializationMapEntry entry = {};
+		entry.constantID = 0;
+		entry.offset = 0;
+		entry.size = sizeof(VkBool32);
+
+		VkSpecializationInfo specializationInfo = {};
+		specializationInfo.mapEntryCount = 1;
+		specializationInfo.pMapEntries = &entry;
+		specializationInfo.dataSize = sizeof(compact);
+		specializationInfo.pData = &compact;
+
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+		pipelineInfo.layout = pipelineLayout;
+
+		VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create culling pipeline!");
+		}
+	}
+
+	void destroy()
+	{
+		if (device == VK_NULL_HANDLE) return;
+
+		vkDestroyPipeline(device, pipeline, nullptr);
+		if (sampler != VK_NULL_HANDLE) vkDestroySampler(device, sampler, nullptr);
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+		pipeline = VK_NULL_HANDLE;
+		sampler = VK_NULL_HANDLE;
+		cmdDrawIndexedIndirectCount = nullptr;
+		setDescription = DescriptorSetDescription();
+		device = VK_NULL_HANDLE;
+	}
+
+	bool isInitialized() const { return device != VK_NULL_HANDLE; }
+	bool usesDrawCount() const { return cmdDrawIndexedIndirectCount != nullptr; }
+	bool usesOcclusion() const { return occlusion; }
+
+	Target createTarget(const TargetInfo& info)
+	{
+		uint32_t maxDraws = info.maxDraws;
+
+		Target target;
+		target.maxDraws = maxDraws;
+		target.depthPyramidScale[0] = info.depthPyramidScale[0];
+		target.depthPyramidScale[1] = info.depthPyramidScale[1];
+
+		createBuffer(sizeof(VkDrawIndexedIndirectCommand) * maxDraws,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			info, target.drawBuffer, target.drawBufferMemory);
+		createBuffer(sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			info, target.countBuffer, target.countBufferMemory);
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &descriptorSetLayout;
+
+		if (vkAllocateDescriptorSets(device, &allocInfo, &target.descriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate culling descriptor set!");
+		}
+
+		TargetDescriptors descriptors = {};
+		descriptors.objects = { info.objectBuffer, 0, sizeof(Object) * maxDraws };
+		descriptors.draws = { target.drawBuffer, 0, sizeof(VkDrawIndexedIndirectCommand) * maxDraws };
+		descriptors.count = { target.countBuffer, 0, sizeof(uint32_t) };
+		descriptors.visibility = { info.visibilityBuffer, 0, sizeof(uint32_t) * maxDraws };
+		descriptors.depthPyramid = { sampler, info.depthPyramid, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		setDescription.writeClassic(device, target.descriptorSet, &descriptors);
+
+		return target;
+	}
+
+	//only once every command buffer that recorded the target has finished
+	void destroyTarget(Target& target)
+	{
+		if (target.descriptorSet == VK_NULL_HANDLE) return;
+
+		vkFreeDescriptorSets(device, descriptorPool, 1, &target.descriptorSet);
+		vkDestroyBuffer(device, target.drawBuffer, nullptr);
+		vkFreeMemory(device, target.drawBufferMemory, nullptr);
+		vkDestroyBuffer(device, target.countBuffer, nullptr);
+		vkFreeMemory(device, target.countBufferMemory, nullptr);
+		target = Target();
+	}
+
+	//records the culling dispatch, has to be outside a render pass
+		//mvp is column major like glm, the frustum planes are taken from it in the shader and the late phase projects bounds with it
+	//the draw and count buffers are left for the caller to make visible to the indirect draw stage, see RenderGraph
+	void record(VkCommandBuffer commandBuffer, Target& target, const float* mvp, uint32_t objectCount, Phase phase)
+	{
+		objectCount = std::min(objectCount, target.maxDraws);
+		target.objectCount = objectCount;
+
+		vkCmdFillBuffer(commandBuffer, target.countBuffer, 0, sizeof(uint32_t), 0);
+
+		//covers the count reset, and the visibility buffer between the early and late phases and from one frame to the next
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+
+		PushConstants constants = {};
+		memcpy(constants.mvp, mvp, sizeof(constants.mvp));
+		constants.objectCount = objectCount;
+		constants.phase = static_cast<uint32_t>(phase);
+		constants.depthPyramidScale[0] = target.depthPyramidScale[0];
+		constants.depthPyramidScale[1] = target.depthPyramidScale[1];
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &target.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(commandBuffer, (objectCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+	}
+
+	//records the draws written by the last record of target, inside the render pass with the graphics pipeline bound
+	void draw(VkCommandBuffer commandBuffer, const Target& target)
+	{
+		if (usesDrawCount())
+		{
+			cmdDrawIndexedIndirectCount(commandBuffer, target.drawBuffer, 0, target.countBuffer, 0,
+				target.maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, target.drawBuffer, 0, target.objectCount, sizeof(VkDrawIndexedIndirectCommand));
+		}
+	}
+
+private:
+	struct PushConstants
+	{
+		float mvp[16];
+		uint32_t objectCount;
+		uint32_t phase;
+		float depthPyramidScale[2];
+	};
+
+	//visibility and depthPyramid are only in the layout with occlusion
+	struct TargetDescriptors
+	{
+		VkDescriptorBufferInfo objects;
+		VkDescriptorBufferInfo draws;
+		VkDescriptorBufferInfo count;
+		VkDescriptorBufferInfo visibility;
+		VkDescriptorImageInfo depthPyramid;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	DescriptorSetDescription setDescription;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	bool occlusion = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const TargetInfo& info, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (info.queueFamilyCount > 1)
+		{
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = info.queueFamilyCount;
+			bufferInfo.pQueueFamilyIndices = info.queueFamilies;
+		}
+
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create culling buffer!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		uint32_t memoryType = UINT32_MAX;
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+		{
+			if ((memRequirements.memoryTypeBits & (1 << i))
+				&& (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				memoryType = i;
+				break;
+			}
+		}
+
+		if (memoryType == UINT32_MAX)
+		{
+			throw std::runtime_error("failed to find a memory type for a culling buffer!");
+		}
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = memoryType;
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate culling buffer memory!");
+		}
+
+		vkBindBufferMemory(device, buffer, bufferMemory, 0);
+	}
+};
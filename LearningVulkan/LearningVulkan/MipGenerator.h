@@ -0,0 +1,428 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <future>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIP_USE_SSE
+#if defined(_MSC_VER)
+#include <intrin.h>
+//MSVC lets AVX2 intrinsics be used without /arch:AVX2, so the kernel is picked at runtime
+#define MIP_TARGET_AVX2
+#else
+#define MIP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#define MIP_HAS_AVX2_KERNEL
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MIP_USE_NEON
+#endif
+
+//CPU mip chain generation
+//unlike vkCmdBlitImage this:
+	//averages in linear space, so sRGB encoded textures don't get darker towards the small mips
+	//supports a Kaiser windowed sinc filter, which keeps more detail than a box
+	//handles odd sizes properly, a 5 pixel row becomes 2 pixels that each cover 2.5 source pixels
+	//works for any format since compression happens afterwards
+//each level is made from the one above it with a separable filter:
+	//a horizontal pass, per pixel weights, all 4 channels in one SSE/NEON register
+	//a vertical pass, one weight per row, so whole rows are summed 8 (AVX2) or 4 (SSE/NEON) floats at a time
+namespace MipGenerator
+{
+	enum class Filter
+	{
+		Box,
+		Kaiser
+	};
+
+	struct Settings
+	{
+		Filter filter = Filter::Box;
+		//treat RGB as sRGB encoded, alpha is always linear
+		bool srgb = true;
+	};
+
+	inline const char* filterName(Filter filter)
+	{
+		return filter == Filter::Box ? "box" : "kaiser";
+	}
+
+	inline uint32_t levelCount(uint32_t width, uint32_t height)
+	{
+		return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	}
+
+	namespace detail
+	{
+		//the source pixels and weights that make up one destination pixel along one axis
+		struct Taps
+		{
+			uint32_t first;
+			std::vector<float> weights;
+		};
+
+		//zeroth order modified bessel function, used by the Kaiser window
+		inline double besselI0(double x)
+		{
+			double sum = 1.0;
+			double term = 1.0;
+			for (int k = 1; k < 32; k++)
+			{
+				term *= (x / (2.0 * k)) * (x / (2.0 * k));
+				sum += term;
+				if (term < sum * 1e-12) break;
+			}
+			return sum;
+		}
+
+		inline double sinc(double x)
+		{
+			if (std::fabs(x) < 1e-8) return 1.0;
+			return std::sin(3.14159265358979323846 * x) / (3.14159265358979323846 * x);
+		}
+
+		//builds the taps for every destination pixel along an axis of sourceSize pixels
+		//taps past the edges are clamped onto the edge pixel
+		inline std::vector<Taps> buildTaps(uint32_t sourceSize, uint32_t destinationSize, Filter filter)
+		{
+			std::vector<Taps> result(destinationSize);
+			double scale = static_cast<double>(sourceSize) / destinationSize;
+
+			for (uint32_t x = 0; x < destinationSize; x++)
+			{
+				Taps& taps = result[x];
+				std::vector<double> weights;
+
+				if (filter == Filter::Box)
+				{
+					//each destination pixel covers [x * scale, (x + 1) * scale) of the source
+					//weights are how much of each source pixel falls inside that
+					double start = x * scale;
+					double end = (x + 1) * scale;
+					taps.first = static_cast<uint32_t>(std::floor(start));
+					uint32_t last = std::min(sourceSize - 1, static_cast<uint32_t>(std::ceil(end)) - 1);
+
+					for (uint32_t i = taps.first; i <= last; i++)
+					{
+						double overlap = std::min(end, i + 1.0) - std::max(start, static_cast<double>(i));
+						weights.push_back(std::max(0.0, overlap));
+					}
+				}
+				else
+				{
+					//sinc low pass at the destination's nyquist limit, windowed to 3 destination pixels each side
+					const double radius = 3.0;
+					const double beta = 4.0;
+					double center = (x + 0.5) * scale - 0.5;
+					double support = radius * scale;
+
+					int first = static_cast<int>(std::ceil(center - support));
+					int last = static_cast<int>(std::floor(center + support));
+
+					std::vector<double> clampedWeights(sourceSize, 0.0);
+					for (int i = first; i <= last; i++)
+					{
+						double t = (i - center) / scale;
+						double window = t / radius;
+						if (std::fabs(window) >= 1.0) continue;
+
+						double weight = sinc(t) * besselI0(beta * std::sqrt(1.0 - window * window)) / besselI0(beta);
+						int clamped = std::min(static_cast<int>(sourceSize) - 1, std::max(0, i));
+						clampedWeights[clamped] += weight;
+					}
+
+					uint32_t lo = sourceSize;
+					uint32_t hi = 0;
+					for (uint32_t i = 0; i < sourceSize; i++)
+					{
+						if (clampedWeights[i] != 0.0)
+						{
+							lo = std::min(lo, i);
+							hi = std::max(hi, i);
+						}
+					}
+
+					taps.first = lo;
+					for (uint32_t i = lo; i <= hi; i++) weights.push_back(clampedWeights[i]);
+				}
+
+				double sum = 0.0;
+				for (double weight : weights) sum += weight;
+				for (double weight : weights) taps.weights.push_back(static_cast<float>(weight / sum));
+			}
+
+			return result;
+		}
+
+		inline const float* srgbToLinearTable()
+		{
+			static const std::vector<float> table = []() {
+				std::vector<float> values(256);
+				for (int i = 0; i < 256; i++)
+				{
+					double c = i / 255.0;
+					values[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+				}
+				return values;
+			}();
+			return table.data();
+		}
+
+		//indexed by linear value * 65535, precise enough that every sRGB code round trips
+		inline const uint8_t* linearToSrgbTable()
+		{
+			static const std::vector<uint8_t> table = []() {
+				std::vector<uint8_t> values(65536);
+				for (int i = 0; i < 65536; i++)
+				{
+					double c = i / 65535.0;
+					double s = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+					values[i] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, s * 255.0 + 0.5)));
+				}
+				return values;
+			}();
+			return table.data();
+		}
+
+		inline bool cpuHasAvx2()
+		{
+#if defined(MIP_HAS_AVX2_KERNEL) && defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return false;
+
+			__cpuid(info, 1);
+			bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+
+			__cpuidex(info, 7, 0);
+			return osSavesYmm && (info[1] & (1 << 5));
+#elif defined(MIP_HAS_AVX2_KERNEL)
+			return __builtin_cpu_supports("avx2");
+#else
+			return false;
+#endif
+		}
+
+		inline bool useAvx2()
+		{
+			static const bool supported = cpuHasAvx2();
+			return supported;
+		}
+
+		//destination row = sum of weight * source row
+#ifdef MIP_HAS_AVX2_KERNEL
+		MIP_TARGET_AVX2 inline void accumulateRowAvx2(float* destination, const float* source, float weight, size_t count)
+		{
+			__m256 w = _mm256_set1_ps(weight);
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 d = _mm256_loadu_ps(destination + i);
+				__m256 s = _mm256_loadu_ps(source + i);
+				_mm256_storeu_ps(destination + i, _mm256_add_ps(d, _mm256_mul_ps(s, w)));
+			}
+			for (; i < count; i++) destination[i] += source[i] * weight;
+		}
+#endif
+
+		inline void accumulateRow(float* destination, const float* source, float weight, size_t count)
+		{
+#ifdef MIP_HAS_AVX2_KERNEL
+			if (useAvx2())
+			{
+				accumulateRowAvx2(destination, source, weight, count);
+				return;
+			}
+#endif
+			size_t i = 0;
+#if defined(MIP_USE_SSE)
+			__m128 w = _mm_set1_ps(weight);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 d = _mm_loadu_ps(destination + i);
+				__m128 s = _mm_loadu_ps(source + i);
+				_mm_storeu_ps(destination + i, _mm_add_ps(d, _mm_mul_ps(s, w)));
+			}
+#elif defined(MIP_USE_NEON)
+			float32x4_t w = vdupq_n_f32(weight);
+			for (; i + 4 <= count; i += 4)
+			{
+				vst1q_f32(destination + i, vmlaq_f32(vld1q_f32(destination + i), vld1q_f32(source + i), w));
+			}
+#endif
+			for (; i < count; i++) destination[i] += source[i] * weight;
+		}
+
+		//one RGBA pixel = sum of weight * source pixel, one register holds all 4 channels
+		inline void filterPixel(float* destination, const float* source, const float* weights, size_t tapCount)
+		{
+#if defined(MIP_USE_SSE)
+			__m128 sum = _mm_setzero_ps();
+			for (size_t t = 0; t < tapCount; t++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + t * 4), _mm_set1_ps(weights[t])));
+			}
+			_mm_storeu_ps(destination, sum);
+#elif defined(MIP_USE_NEON)
+			float32x4_t sum = vdupq_n_f32(0.0f);
+			for (size_t t = 0; t < tapCount; t++)
+			{
+				sum = vmlaq_n_f32(sum, vld1q_f32(source + t * 4), weights[t]);
+			}
+			vst1q_f32(destination, sum);
+#else
+			float sum[4] = {};
+			for (size_t t = 0; t < tapCount; t++)
+			{
+				for (int c = 0; c < 4; c++) sum[c] += source[t * 4 + c] * weights[t];
+			}
+			memcpy(destination, sum, sizeof(sum));
+#endif
+		}
+
+		//runs rowFunction(first, last) over [0, rowCount) split across the pool
+		template<typename F>
+		void parallelRows(ThreadPool* pool, uint32_t rowCount, F rowFunction)
+		{
+			if (pool == nullptr || pool->size() == 0 || rowCount < 16)
+			{
+				rowFunction(0, rowCount);
+				return;
+			}
+
+			uint32_t chunkCount = std::min(rowCount / 8, static_cast<uint32_t>(pool->size() * 4));
+			pool->parallelFor(rowCount, chunkCount, [&rowFunction](uint32_t, uint32_t first, uint32_t last) { rowFunction(first, last); });
+		}
+
+		//halves a linear float RGBA image (rounding down, never below 1)
+		inline std::vector<float> downsample(const std::vector<float>& source, uint32_t width, uint32_t height,
+			Filter filter, ThreadPool* pool)
+		{
+			uint32_t dstWidth = std::max(1u, width / 2);
+			uint32_t dstHeight = std::max(1u, height / 2);
+
+			std::vector<Taps> horizontalTaps = buildTaps(width, dstWidth, filter);
+			std::vector<Taps> verticalTaps = buildTaps(height, dstHeight, filter);
+
+			//horizontal pass: width x height -> dstWidth x height
+			std::vector<float> horizontal(static_cast<size_t>(dstWidth) * height * 4);
+			parallelRows(pool, height, [&](uint32_t first, uint32_t last) {
+				for (uint32_t y = first; y < last; y++)
+				{
+					const float* sourceRow = source.data() + static_cast<size_t>(y) * width * 4;
+					float* destinationRow = horizontal.data() + static_cast<size_t>(y) * dstWidth * 4;
+
+					for (uint32_t x = 0; x < dstWidth; x++)
+					{
+						const Taps& taps = horizontalTaps[x];
+						filterPixel(destinationRow + x * 4, sourceRow + taps.first * 4, taps.weights.data(), taps.weights.size());
+					}
+				}
+			});
+
+			//vertical pass: dstWidth x height -> dstWidth x dstHeight
+			std::vector<float> result(static_cast<size_t>(dstWidth) * dstHeight * 4, 0.0f);
+			size_t rowFloats = static_cast<size_t>(dstWidth) * 4;
+			parallelRows(pool, dstHeight, [&](uint32_t first, uint32_t last) {
+				for (uint32_t y = first; y < last; y++)
+				{
+					const Taps& taps = verticalTaps[y];
+					float* destinationRow = result.data() + y * rowFloats;
+
+					for (size_t t = 0; t < taps.weights.size(); t++)
+					{
+						accumulateRow(destinationRow, horizontal.data() + (taps.first + t) * rowFloats, taps.weights[t], rowFloats);
+					}
+				}
+			});
+
+			return result;
+		}
+
+		inline std::vector<float> toLinear(const uint8_t* rgba, size_t pixelCount, bool srgb)
+		{
+			const float* table = srgbToLinearTable();
+			std::vector<float> result(pixelCount * 4);
+
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					result[i * 4 + c] = srgb ? table[rgba[i * 4 + c]] : rgba[i * 4 + c] / 255.0f;
+				}
+				result[i * 4 + 3] = rgba[i * 4 + 3] / 255.0f;
+			}
+
+			return result;
+		}
+
+		inline std::vector<uint8_t> toBytes(const std::vector<float>& linear, bool srgb)
+		{
+			const uint8_t* table = linearToSrgbTable();
+			std::vector<uint8_t> result(linear.size());
+
+			for (size_t i = 0; i < linear.size(); i++)
+			{
+				//the kaiser filter rings, so values can land slightly outside [0, 1]
+				float value = std::min(1.0f, std::max(0.0f, linear[i]));
+				bool isAlpha = (i % 4) == 3;
+
+				if (srgb && !isAlpha)
+				{
+					result[i] = table[static_cast<uint32_t>(value * 65535.0f + 0.5f)];
+				}
+				else
+				{
+					result[i] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+				}
+			}
+
+			return result;
+		}
+	}
+
+	//name of the kernel used for the vertical pass on this CPU
+	inline const char* kernelName()
+	{
+#ifdef MIP_HAS_AVX2_KERNEL
+		if (detail::useAvx2()) return "AVX2";
+		return "SSE";
+#elif defined(MIP_USE_NEON)
+		return "NEON";
+#else
+		return "scalar";
+#endif
+	}
+
+	//builds the whole mip chain for an RGBA8 image, levels[0] is a copy of the input
+	//every level is filtered from the previous one in float, so the only rounding is when each level is written out
+	inline std::vector<std::vector<uint8_t>> generate(const uint8_t* rgba, uint32_t width, uint32_t height,
+		const Settings& settings, ThreadPool* pool = nullptr)
+	{
+		uint32_t count = levelCount(width, height);
+		std::vector<std::vector<uint8_t>> levels(count);
+		levels[0].assign(rgba, rgba + static_cast<size_t>(width) * height * 4);
+
+		std::vector<float> current = detail::toLinear(rgba, static_cast<size_t>(width) * height, settings.srgb);
+		uint32_t levelWidth = width;
+		uint32_t levelHeight = height;
+
+		for (uint32_t i = 1; i < count; i++)
+		{
+			current = detail::downsample(current, levelWidth, levelHeight, settings.filter, pool);
+			levelWidth = std::max(1u, levelWidth / 2);
+			levelHeight = std::max(1u, levelHeight / 2);
+
+			levels[i] = detail::toBytes(current, settings.srgb);
+		}
+
+		return levels;
+	}
+}
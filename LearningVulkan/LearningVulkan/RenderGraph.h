@@ -0,0 +1,914 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "BarrierTracker.h"
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <string>
+#include <functional>
+#include <stdexcept>
+
+//a frame described as passes that declare which resources they use and how, see TriApp::createFrameGraph
+//declared and compiled once (again whenever the swap chain changes), then executed every frame
+//compile:
+	//culls passes whose results never reach an output
+	//makes each graphics pass's render pass from its attachments, the load and store ops come from what uses them before and after
+	//creates the transient images and places them in shared memory, images that are never alive at the same time get the same bytes
+//execute:
+	//before each pass, one barrier command with every layout transition and dependency the pass needs, worked out by a BarrierTracker
+		//a read of something that's already visible to that stage in the right layout doesn't need anything
+	//then begins the render pass for graphics passes and calls the pass's record function
+//the resources' states are tracked by the graph, so passes only record their own work and leave the barriers to it
+//the frame can be split into parts recorded into command buffers of their own, see beginPartAt
+class RenderGraph
+{
+public:
+	typedef uint32_t ResourceId;
+	typedef uint32_t PassId;
+	static const uint32_t INVALID_ID = UINT32_MAX;
+
+	enum class PassType
+	{
+		Graphics,	//gets a render pass made from its attachment usages
+		Compute	//also used for transfers, anything recorded outside a render pass
+	};
+
+	//how a pass uses a resource, each one implies the stages, access and layout it needs
+	enum class Usage
+	{
+		ColorAttachment,
+		DepthAttachment,
+		SampledCompute,	//sampled or fetched by a compute shader
+		SampledFragment,
+		StorageImageCompute,	//read and written by a compute shader, kept in GENERAL
+		StorageBufferReadCompute,
+		StorageBufferWriteCompute,	//written, or read and written, by a compute shader
+		IndirectBuffer,	//draw or dispatch arguments
+		TransferSrc,
+		TransferDst
+	};
+
+	struct ImageDesc
+	{
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		VkImageUsageFlags usage;	//whatever the declared usages need is added on top
+	};
+
+	struct Stats
+	{
+		uint32_t passCount = 0;
+		uint32_t culledPassCount = 0;
+		uint32_t transientImageCount = 0;
+		VkDeviceSize transientSize = 0;	//what the transient images would take in memory of their own
+		VkDeviceSize allocatedSize = 0;	//what they take sharing it
+		//from the last execute
+		uint32_t barrierCount = 0;	//image and buffer barriers
+		uint32_t barrierBatchCount = 0;	//barrier commands
+	};
+
+	//synchronization2 if the device was made with it, see BarrierTracker::init
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, bool synchronization2)
+	{
+		this->physicalDevice = physicalDevice;
+		this->device = device;
+		tracker.init(device, synchronization2);
+	}
+
+	//destroys everything compile made and forgets every pass and resource
+	void reset()
+	{
+		destroyCompiled();
+		resources.clear();
+		passes.clear();
+		stats = Stats();
+	}
+
+	//an image that lives outside the graph, its handles are set every frame with setImage
+	//contents are kept from before the frame unless initialLayout is VK_IMAGE_LAYOUT_UNDEFINED
+		//initialStages is what the first barrier waits on, e.g. the stage the acquire semaphore is waited at for a swap chain image
+	//at the end of the frame it's put in finalLayout, unless that's VK_IMAGE_LAYOUT_UNDEFINED
+	ResourceId importImage(const std::string& name, const ImageDesc& desc,
+		VkImageLayout initialLayout, VkPipelineStageFlags initialStages, VkImageLayout finalLayout)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.isImage = true;
+		resource.imported = true;
+		resource.desc = desc;
+		resource.initialLayout = initialLayout;
+		resource.initialStages = initialStages;
+		resource.finalLayout = finalLayout;
+		resources.push_back(resource);
+		return static_cast<ResourceId>(resources.size() - 1);
+	}
+
+	//an image that only exists during the frame, made by compile and undefined at the start of every frame
+	ResourceId createImage(const std::string& name, const ImageDesc& desc)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.isImage = true;
+		resource.desc = desc;
+		resources.push_back(resource);
+		return static_cast<ResourceId>(resources.size() - 1);
+	}
+
+	//a buffer that lives outside the graph, its handle is set every frame with setBuffer
+	//only dependencies within the frame are tracked, anything from earlier frames is up to whoever owns it
+	ResourceId importBuffer(const std::string& name)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.imported = true;
+		resources.push_back(resource);
+		return static_cast<ResourceId>(resources.size() - 1);
+	}
+
+	void setImage(ResourceId id, VkImage image, VkImageView view)
+	{
+		resources[id].image = image;
+		resources[id].view = view;
+	}
+
+	void setBuffer(ResourceId id, VkBuffer buffer)
+	{
+		resources[id].buffer = buffer;
+	}
+
+	//passes run in the order they're added
+	PassId addPass(const std::string& name, PassType type, std::function<void(VkCommandBuffer)> record)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.type = type;
+		pass.record = std::move(record);
+		passes.push_back(std::move(pass));
+		return static_cast<PassId>(passes.size() - 1);
+	}
+
+	//each resource can only be used once per pass
+	void use(PassId pass, ResourceId resource, Usage usage)
+	{
+		for (const PassUse& existing : passes[pass].uses)
+		{
+			if (existing.resource == resource)
+			{
+				throw std::runtime_error("render graph pass " + passes[pass].name + " uses " + resources[resource].name + " twice!");
+			}
+		}
+
+		PassUse passUse = {};
+		passUse.resource = resource;
+		passUse.usage = usage;
+		passes[pass].uses.push_back(passUse);
+	}
+
+	//an attachment that's cleared at the start of the pass instead of loaded
+	void setClearValue(PassId pass, ResourceId resource, VkClearValue value)
+	{
+		for (PassUse& passUse : passes[pass].uses)
+		{
+			if (passUse.resource == resource)
+			{
+				passUse.cleared = true;
+				passUse.clearValue = value;
+				return;
+			}
+		}
+		throw std::runtime_error("render graph pass " + passes[pass].name + " doesn't use " + resources[resource].name + "!");
+	}
+
+	//pass and the ones after it are recorded into the next command buffer given to execute
+		//for submitting the frame in parts, so another queue can wait on the first part without waiting for the rest
+		//the parts have to be submitted in order on one queue, the barriers between them are still recorded as if they were one
+	void beginPartAt(PassId pass)
+	{
+		passes[pass].startsPart = true;
+	}
+
+	//how many command buffers execute takes, one more than the passes given to beginPartAt
+	uint32_t getPartCount() const
+	{
+		uint32_t count = 1;
+		for (const Pass& pass : passes)
+		{
+			count += pass.startsPart ? 1 : 0;
+		}
+		return count;
+	}
+
+	//something the frame has to produce, passes that don't contribute to an output are culled
+	void markOutput(ResourceId resource)
+	{
+		resources[resource].output = true;
+	}
+
+	void compile()
+	{
+		destroyCompiled();
+		stats = Stats();
+
+		cullPasses();
+		findLifetimes();
+		createTransientImages();
+
+		for (Pass& pass : passes)
+		{
+			if (!pass.culled && pass.type == PassType::Graphics)
+			{
+				createRenderPass(pass);
+			}
+		}
+
+		stats.passCount = static_cast<uint32_t>(passes.size());
+		for (const Pass& pass : passes)
+		{
+			stats.culledPassCount += pass.culled ? 1 : 0;
+		}
+
+		//everything starts out as if the frame before had nothing pending
+		for (const Resource& resource : resources)
+		{
+			if (!resource.imported && resource.image != VK_NULL_HANDLE)
+			{
+				tracker.trackImage(resource.image, barrierAspect(resource), resource.desc.mipLevels);
+			}
+		}
+	}
+
+	//every part into the one command buffer
+	void execute(VkCommandBuffer commandBuffer)
+	{
+		execute(std::vector<VkCommandBuffer>(getPartCount(), commandBuffer));
+	}
+
+	//one command buffer per part, in the order they're submitted
+	void execute(const std::vector<VkCommandBuffer>& commandBuffers)
+	{
+		if (commandBuffers.size() != getPartCount())
+		{
+			throw std::runtime_error("render graph needs a command buffer for each part!");
+		}
+
+		tracker.resetStats();
+
+		for (Resource& resource : resources)
+		{
+			resource.usedThisFrame = false;
+			if (resource.imported && resource.isImage)
+			{
+				if (resource.image != VK_NULL_HANDLE)
+				{
+					tracker.trackImage(resource.image, barrierAspect(resource), resource.desc.mipLevels, resource.initialLayout, resource.initialStages);
+				}
+			}
+			else if (resource.imported)
+			{
+				if (resource.buffer != VK_NULL_HANDLE)
+				{
+					tracker.trackBuffer(resource.buffer);
+				}
+			}
+			else if (resource.image != VK_NULL_HANDLE)
+			{
+				//the contents are gone, but whatever the last frame was doing with it still has to finish first
+				tracker.discardImage(resource.image);
+			}
+		}
+
+		//a culled pass still starts its part, so the command buffers always line up with the same parts
+		size_t part = 0;
+		for (Pass& pass : passes)
+		{
+			part += pass.startsPart ? 1 : 0;
+			if (pass.culled) continue;
+
+			VkCommandBuffer commandBuffer = commandBuffers[part];
+			for (const PassUse& passUse : pass.uses)
+			{
+				useResource(passUse.resource, usageInfo(passUse.usage));
+			}
+			tracker.flush(commandBuffer);
+
+			if (pass.type == PassType::Graphics)
+			{
+				beginRenderPass(commandBuffer, pass);
+				pass.record(commandBuffer);
+				vkCmdEndRenderPass(commandBuffer);
+			}
+			else
+			{
+				pass.record(commandBuffer);
+			}
+		}
+
+		//imported images are left how the outside world expects them
+		for (ResourceId id = 0; id < resources.size(); id++)
+		{
+			Resource& resource = resources[id];
+			if (!resource.imported || !resource.isImage || !resource.usedThisFrame) continue;
+			if (resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == tracker.getLayout(resource.image)) continue;
+
+			tracker.useImage(resource.image, resource.finalLayout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+		}
+		tracker.flush(commandBuffers.back());
+
+		stats.barrierCount = tracker.getStats().barrierCount;
+		stats.barrierBatchCount = tracker.getStats().batchCount;
+	}
+
+	VkImage getImage(ResourceId id) const { return resources[id].image; }
+	VkImageView getView(ResourceId id) const { return resources[id].view; }
+	//made by compile, a pipeline made with it works with any render pass that has the same attachment formats
+	VkRenderPass getRenderPass(PassId pass) const { return passes[pass].renderPass; }
+	bool isCulled(PassId pass) const { return passes[pass].culled; }
+	const Stats& getStats() const { return stats; }
+
+	static bool isDepthFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT
+			|| hasStencil(format);
+	}
+
+	static bool hasStencil(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+private:
+	struct UsageInfo
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;	//VK_IMAGE_LAYOUT_UNDEFINED for buffers
+		bool write;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		bool isImage = false;
+		bool imported = false;
+		bool output = false;
+		ImageDesc desc = {};
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags initialStages = 0;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+
+		//from compile, passes are indices into passes and only count ones that weren't culled
+		uint32_t firstPass = INVALID_ID;
+		uint32_t lastPass = INVALID_ID;
+		VkImageUsageFlags usage = 0;
+		//transient images that share memory with this one, their work has to finish before this one's starts
+			//the ones before it in the frame, and the ones after it, whose last use was in the previous frame
+		std::vector<ResourceId> aliases;
+
+		bool usedThisFrame = false;
+	};
+
+	struct PassUse
+	{
+		ResourceId resource;
+		Usage usage;
+		bool cleared;
+		VkClearValue clearValue;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		PassType type;
+		std::function<void(VkCommandBuffer)> record;
+		std::vector<PassUse> uses;
+		bool culled = false;
+		bool startsPart = false;
+
+		//graphics passes only, color attachments first then depth
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<ResourceId> attachments;
+		std::vector<VkClearValue> clearValues;
+		VkExtent2D extent = {};
+		//the views change with the swap chain image, so there's one framebuffer per set of views
+		std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+	};
+
+	struct MemoryBlock
+	{
+		uint32_t memoryType;
+		VkDeviceSize size = 0;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		std::vector<ResourceId> images;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<MemoryBlock> memoryBlocks;
+	BarrierTracker tracker;
+	Stats stats;
+
+	static UsageInfo usageInfo(Usage usage)
+	{
+		switch (usage)
+		{
+		case Usage::ColorAttachment:
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true };
+		case Usage::DepthAttachment:
+			return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true };
+		case Usage::SampledCompute:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+		case Usage::SampledFragment:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+		case Usage::StorageImageCompute:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+		case Usage::StorageBufferReadCompute:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+		case Usage::StorageBufferWriteCompute:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true };
+		case Usage::IndirectBuffer:
+			return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+		case Usage::TransferSrc:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+		case Usage::TransferDst:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+		}
+		throw std::runtime_error("unknown render graph usage!");
+	}
+
+	static VkImageUsageFlags imageUsage(Usage usage)
+	{
+		switch (usage)
+		{
+		case Usage::ColorAttachment: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		case Usage::DepthAttachment: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		case Usage::SampledCompute:
+		case Usage::SampledFragment: return VK_IMAGE_USAGE_SAMPLED_BIT;
+		case Usage::StorageImageCompute: return VK_IMAGE_USAGE_STORAGE_BIT;
+		case Usage::TransferSrc: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		case Usage::TransferDst: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		default: return 0;
+		}
+	}
+
+	static bool isAttachment(Usage usage)
+	{
+		return usage == Usage::ColorAttachment || usage == Usage::DepthAttachment;
+	}
+
+	VkImageAspectFlags barrierAspect(const Resource& resource) const
+	{
+		if (!isDepthFormat(resource.desc.format)) return VK_IMAGE_ASPECT_COLOR_BIT;
+		return hasStencil(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+	}
+
+	//walks backwards from the outputs, a pass is kept if it writes something a kept pass (or the outside world) reads
+		//attachments that aren't cleared are loaded, so they count as reads too
+		//a cleared attachment replaces what was there, so whatever wrote it before isn't needed for it anymore
+	void cullPasses()
+	{
+		std::vector<bool> needed(resources.size());
+		for (ResourceId id = 0; id < resources.size(); id++)
+		{
+			needed[id] = resources[id].output;
+		}
+
+		for (size_t p = passes.size(); p-- > 0;)
+		{
+			Pass& pass = passes[p];
+
+			pass.culled = true;
+			for (const PassUse& passUse : pass.uses)
+			{
+				if (usageInfo(passUse.usage).write && needed[passUse.resource])
+				{
+					pass.culled = false;
+				}
+			}
+			if (pass.culled) continue;
+
+			for (const PassUse& passUse : pass.uses)
+			{
+				if (passUse.cleared)
+				{
+					needed[passUse.resource] = false;
+				}
+			}
+			for (const PassUse& passUse : pass.uses)
+			{
+				bool loaded = isAttachment(passUse.usage) && !passUse.cleared;
+				if (!usageInfo(passUse.usage).write || loaded || passUse.usage == Usage::StorageImageCompute)
+				{
+					needed[passUse.resource] = true;
+				}
+			}
+		}
+	}
+
+	void findLifetimes()
+	{
+		uint32_t index = 0;
+		for (const Pass& pass : passes)
+		{
+			if (pass.culled) continue;
+
+			for (const PassUse& passUse : pass.uses)
+			{
+				Resource& resource = resources[passUse.resource];
+				if (resource.firstPass == INVALID_ID)
+				{
+					resource.firstPass = index;
+				}
+				resource.lastPass = index;
+				resource.usage |= imageUsage(passUse.usage);
+			}
+			index++;
+		}
+	}
+
+	//biggest first, each image goes at the lowest offset where it doesn't overlap an image that's alive at the same time
+	void createTransientImages()
+	{
+		std::vector<ResourceId> transients;
+		for (ResourceId id = 0; id < resources.size(); id++)
+		{
+			if (!resources[id].imported && resources[id].firstPass != INVALID_ID)
+			{
+				transients.push_back(id);
+			}
+		}
+
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		std::vector<VkMemoryRequirements> requirements(resources.size());
+		std::vector<VkDeviceSize> offsets(resources.size());
+		std::vector<uint32_t> blockIndices(resources.size());
+
+		for (ResourceId id : transients)
+		{
+			Resource& resource = resources[id];
+
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent = { resource.desc.width, resource.desc.height, 1 };
+			imageInfo.mipLevels = resource.desc.mipLevels;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = resource.desc.format;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = resource.desc.usage | resource.usage;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateImage(device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create render graph image " + resource.name + "!");
+			}
+			vkGetImageMemoryRequirements(device, resource.image, &requirements[id]);
+			stats.transientSize += requirements[id].size;
+		}
+
+		std::sort(transients.begin(), transients.end(), [&requirements](ResourceId a, ResourceId b) {
+			return requirements[a].size > requirements[b].size;
+		});
+
+		for (ResourceId id : transients)
+		{
+			const VkMemoryRequirements& requirement = requirements[id];
+
+			uint32_t memoryType = UINT32_MAX;
+			for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+			{
+				if ((requirement.memoryTypeBits & (1 << i))
+					&& (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+				{
+					memoryType = i;
+					break;
+				}
+			}
+			if (memoryType == UINT32_MAX)
+			{
+				throw std::runtime_error("failed to find a memory type for render graph image " + resources[id].name + "!");
+			}
+
+			uint32_t blockIndex = 0;
+			while (blockIndex < memoryBlocks.size() && memoryBlocks[blockIndex].memoryType != memoryType)
+			{
+				blockIndex++;
+			}
+			if (blockIndex == memoryBlocks.size())
+			{
+				MemoryBlock block;
+				block.memoryType = memoryType;
+				memoryBlocks.push_back(block);
+			}
+			MemoryBlock& block = memoryBlocks[blockIndex];
+
+			//candidates are the start of the block and the end of everything it might have to avoid
+			std::vector<VkDeviceSize> candidates = { 0 };
+			for (ResourceId other : block.images)
+			{
+				if (lifetimesOverlap(id, other))
+				{
+					candidates.push_back(alignUp(offsets[other] + requirements[other].size, requirement.alignment));
+				}
+			}
+			std::sort(candidates.begin(), candidates.end());
+
+			VkDeviceSize offset = candidates.back();
+			for (VkDeviceSize candidate : candidates)
+			{
+				bool fits = true;
+				for (ResourceId other : block.images)
+				{
+					if (lifetimesOverlap(id, other)
+						&& candidate < offsets[other] + requirements[other].size && offsets[other] < candidate + requirement.size)
+					{
+						fits = false;
+						break;
+					}
+				}
+				if (fits)
+				{
+					offset = candidate;
+					break;
+				}
+			}
+
+			//anything placed over the same bytes is done with them by the time this one is first used
+				//both ways round, with frames in flight the later one's last use in the previous frame can still be running
+			for (ResourceId other : block.images)
+			{
+				if (!lifetimesOverlap(id, other)
+					&& offset < offsets[other] + requirements[other].size && offsets[other] < offset + requirement.size)
+				{
+					resources[id].aliases.push_back(other);
+					resources[other].aliases.push_back(id);
+				}
+			}
+
+			offsets[id] = offset;
+			blockIndices[id] = blockIndex;
+			block.size = std::max(block.size, offset + requirement.size);
+			block.images.push_back(id);
+		}
+
+		for (MemoryBlock& block : memoryBlocks)
+		{
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = block.size;
+			allocInfo.memoryTypeIndex = block.memoryType;
+
+			if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to allocate render graph memory!");
+			}
+			stats.allocatedSize += block.size;
+		}
+
+		for (ResourceId id : transients)
+		{
+			Resource& resource = resources[id];
+			vkBindImageMemory(device, resource.image, memoryBlocks[blockIndices[id]].memory, offsets[id]);
+
+			//depth formats are viewed as depth only, which is what both attachments and sampling want
+			VkImageViewCreateInfo viewInfo = {};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = resource.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = resource.desc.format;
+			viewInfo.subresourceRange.aspectMask = isDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = resource.desc.mipLevels;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create render graph image view " + resource.name + "!");
+			}
+		}
+
+		stats.transientImageCount = static_cast<uint32_t>(transients.size());
+	}
+
+	bool lifetimesOverlap(ResourceId a, ResourceId b) const
+	{
+		return resources[a].firstPass <= resources[b].lastPass && resources[b].firstPass <= resources[a].lastPass;
+	}
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	//the attachments' layouts are set by the graph's barriers, so the render pass starts and ends in the layout the subpass uses
+	void createRenderPass(Pass& pass)
+	{
+		uint32_t passIndex = static_cast<uint32_t>(&pass - passes.data());
+
+		std::vector<const PassUse*> attachmentUses;
+		for (Usage usage : { Usage::ColorAttachment, Usage::DepthAttachment })
+		{
+			for (const PassUse& passUse : pass.uses)
+			{
+				if (passUse.usage == usage) attachmentUses.push_back(&passUse);
+			}
+		}
+		if (attachmentUses.empty())
+		{
+			throw std::runtime_error("render graph pass " + pass.name + " is a graphics pass without attachments!");
+		}
+
+		std::vector<VkAttachmentDescription> attachments;
+		std::vector<VkAttachmentReference> colorReferences;
+		VkAttachmentReference depthReference = {};
+		bool hasDepth = false;
+
+		for (const PassUse* passUse : attachmentUses)
+		{
+			const Resource& resource = resources[passUse->resource];
+			VkImageLayout layout = usageInfo(passUse->usage).layout;
+
+			//loaded if an earlier pass wrote it this frame, or it's imported with contents worth keeping
+			bool writtenBefore = resource.imported && resource.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+			//stored if a later pass uses it, or it goes outside the graph
+			bool usedAfter = resource.imported || resource.output;
+			for (uint32_t p = 0; p < passes.size(); p++)
+			{
+				if (p == passIndex || passes[p].culled) continue;
+				for (const PassUse& other : passes[p].uses)
+				{
+					if (other.resource != passUse->resource) continue;
+					writtenBefore = writtenBefore || (p < passIndex && usageInfo(other.usage).write);
+					usedAfter = usedAfter || p > passIndex;
+				}
+			}
+
+			VkAttachmentDescription attachment = {};
+			attachment.format = resource.desc.format;
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = passUse->cleared ? VK_ATTACHMENT_LOAD_OP_CLEAR
+				: (writtenBefore ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+			attachment.storeOp = usedAfter ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp = hasStencil(resource.desc.format) ? attachment.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = hasStencil(resource.desc.format) ? attachment.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = layout;
+			attachment.finalLayout = layout;
+
+			VkAttachmentReference reference = {};
+			reference.attachment = static_cast<uint32_t>(attachments.size());
+			reference.layout = layout;
+			if (passUse->usage == Usage::DepthAttachment)
+			{
+				depthReference = reference;
+				hasDepth = true;
+			}
+			else
+			{
+				colorReferences.push_back(reference);
+			}
+
+			attachments.push_back(attachment);
+			pass.attachments.push_back(passUse->resource);
+			pass.clearValues.push_back(passUse->clearValue);
+		}
+
+		pass.extent = { resources[pass.attachments[0]].desc.width, resources[pass.attachments[0]].desc.height };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create render pass for render graph pass " + pass.name + "!");
+		}
+	}
+
+	void beginRenderPass(VkCommandBuffer commandBuffer, Pass& pass)
+	{
+		std::vector<VkImageView> views;
+		for (ResourceId id : pass.attachments)
+		{
+			views.push_back(resources[id].view);
+		}
+
+		VkFramebuffer& framebuffer = pass.framebuffers[views];
+		if (framebuffer == VK_NULL_HANDLE)
+		{
+			VkFramebufferCreateInfo framebufferInfo = {};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = pass.renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+			framebufferInfo.pAttachments = views.data();
+			framebufferInfo.width = pass.extent.width;
+			framebufferInfo.height = pass.extent.height;
+			framebufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create framebuffer for render graph pass " + pass.name + "!");
+			}
+		}
+
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = pass.renderPass;
+		renderPassInfo.framebuffer = framebuffer;
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = pass.extent;
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+		renderPassInfo.pClearValues = pass.clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	//tells the tracker about a pass's use of a resource
+		//a transient's first use this frame also has to wait for whatever had its memory before
+		//the tracker keeps every image's state from one execute to the next, so an alias that isn't used yet this frame still has the previous frame's
+	void useResource(ResourceId id, const UsageInfo& info)
+	{
+		Resource& resource = resources[id];
+		if (resource.isImage)
+		{
+			if (!resource.usedThisFrame)
+			{
+				for (ResourceId alias : resource.aliases)
+				{
+					tracker.aliasImage(resource.image, resources[alias].image);
+				}
+			}
+			tracker.useImage(resource.image, info.layout, info.stages, info.access);
+		}
+		else
+		{
+			tracker.useBuffer(resource.buffer, info.stages, info.access);
+		}
+		resource.usedThisFrame = true;
+	}
+
+	//only once nothing recorded with the graph is still running
+	void destroyCompiled()
+	{
+		for (Pass& pass : passes)
+		{
+			for (auto& framebuffer : pass.framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer.second, nullptr);
+			}
+			pass.framebuffers.clear();
+			vkDestroyRenderPass(device, pass.renderPass, nullptr);
+			pass.renderPass = VK_NULL_HANDLE;
+			pass.attachments.clear();
+			pass.clearValues.clear();
+		}
+
+		for (Resource& resource : resources)
+		{
+			if (!resource.imported)
+			{
+				vkDestroyImageView(device, resource.view, nullptr);
+				vkDestroyImage(device, resource.image, nullptr);
+				resource.view = VK_NULL_HANDLE;
+				resource.image = VK_NULL_HANDLE;
+			}
+			resource.firstPass = INVALID_ID;
+			resource.lastPass = INVALID_ID;
+			resource.usage = 0;
+			resource.aliases.clear();
+		}
+
+		for (MemoryBlock& block : memoryBlocks)
+		{
+			vkFreeMemory(device, block.memory, nullptr);
+		}
+		memoryBlocks.clear();
+		tracker.clear();
+	}
+};
@@ -0,0 +1,518 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include "Frustum.h"
+
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include <future>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVH_USE_SSE2
+#endif
+
+//the scene's objects as world space bounding boxes, with a 4 wide BVH over them for frustum culling
+//every node holds the bounds of its 4 children as structure of arrays (all 4 min x, then all 4 min y, ...)
+	//so one node is tested against a plane with a handful of SSE instructions and only the nodes that pass are visited
+	//a child that's entirely inside the frustum has all of its objects added without going any further down
+//the objects are kept in tree order too, so a leaf's objects (at most LEAF_SIZE) are tested 4 at a time the same way
+	//and a whole subtree's objects are one contiguous range
+//moving objects doesn't change the tree, update then refit only grows or shrinks the bounds above the objects that moved
+	//that gets less efficient the further things move from where they were at build, so rebuild now and then if they move a lot
+class SceneBvh
+{
+public:
+	static const uint32_t LEAF_SIZE = 4;
+	static const uint32_t INVALID_INDEX = UINT32_MAX;
+
+	void clear()
+	{
+		objects.clear();
+		nodes.clear();
+		nodeParents.clear();
+		nodeDepths.clear();
+		primitiveObjects.clear();
+		objectPrimitives.clear();
+		primitiveNodes.clear();
+		for (auto& bounds : primitiveBounds)
+		{
+			bounds.clear();
+		}
+		dirtyNodes.clear();
+		nodeDirty.clear();
+	}
+
+	size_t size() const { return objects.size(); }
+	size_t nodeCount() const { return nodes.size(); }
+
+	//returns the object's id, which is what cull reports it as
+	//new objects aren't in the tree until the next build
+	uint32_t add(const float* boundsMin, const float* boundsMax)
+	{
+		Bounds bounds;
+		std::copy(boundsMin, boundsMin + 3, bounds.min);
+		std::copy(boundsMax, boundsMax + 3, bounds.max);
+		objects.push_back(bounds);
+		return static_cast<uint32_t>(objects.size() - 1);
+	}
+
+	//moves an object that's already in the tree, the tree's bounds catch up in refit
+	void update(uint32_t object, const float* boundsMin, const float* boundsMax)
+	{
+		std::copy(boundsMin, boundsMin + 3, objects[object].min);
+		std::copy(boundsMax, boundsMax + 3, objects[object].max);
+
+		uint32_t primitive = objectPrimitives[object];
+		for (int a = 0; a < 3; a++)
+		{
+			primitiveBounds[a][primitive] = boundsMin[a];
+			primitiveBounds[3 + a][primitive] = boundsMax[a];
+		}
+
+		markDirty(primitiveNodes[primitive]);
+	}
+
+	//top down, each node's objects are split in half at the median of their centers along the longest axis, then each half is split again
+	void build()
+	{
+		uint32_t count = static_cast<uint32_t>(objects.size());
+
+		nodes.clear();
+		nodeParents.clear();
+		nodeDepths.clear();
+		dirtyNodes.clear();
+		primitiveObjects.resize(count);
+		std::iota(primitiveObjects.begin(), primitiveObjects.end(), 0);
+		primitiveNodes.assign(count, INVALID_INDEX);
+
+		centers.resize(count * 3);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				centers[i * 3 + a] = (objects[i].min[a] + objects[i].max[a]) * 0.5f;
+			}
+		}
+
+		if (count > 0)
+		{
+			buildNode(0, count, INVALID_INDEX, 0);
+		}
+		centers.clear();
+		centers.shrink_to_fit();
+
+		//padded to a whole group of 4 past the end so a leaf near the end can still be loaded 4 at a time
+			//the padding is inside out so it's never visible
+		objectPrimitives.resize(count);
+		size_t paddedCount = (count + 3) / 4 * 4 + 4;
+		for (int a = 0; a < 3; a++)
+		{
+			primitiveBounds[a].assign(paddedCount, FLT_MAX);
+			primitiveBounds[3 + a].assign(paddedCount, -FLT_MAX);
+		}
+		for (uint32_t primitive = 0; primitive < count; primitive++)
+		{
+			const Bounds& bounds = objects[primitiveObjects[primitive]];
+			objectPrimitives[primitiveObjects[primitive]] = primitive;
+			for (int a = 0; a < 3; a++)
+			{
+				primitiveBounds[a][primitive] = bounds.min[a];
+				primitiveBounds[3 + a][primitive] = bounds.max[a];
+			}
+		}
+
+		//children always come after their parent, so going backwards fills in every child before its parent needs it
+		for (size_t node = nodes.size(); node-- > 0;)
+		{
+			refitNode(static_cast<uint32_t>(node));
+		}
+
+		nodeDirty.assign(nodes.size(), 0);
+		uint32_t maxDepth = nodeDepths.empty() ? 0 : *std::max_element(nodeDepths.begin(), nodeDepths.end());
+		dirtyNodes.resize(maxDepth + 1);
+	}
+
+	//brings the tree's bounds up to date with everything passed to update since the last refit or build
+	//one level at a time from the bottom, a node's parent is only refit if the node's bounds actually changed
+	void refit()
+	{
+		for (size_t depth = dirtyNodes.size(); depth-- > 0;)
+		{
+			for (uint32_t node : dirtyNodes[depth])
+			{
+				nodeDirty[node] = 0;
+				if (refitNode(node) && nodeParents[node] != INVALID_INDEX)
+				{
+					markDirty(nodeParents[node]);
+				}
+			}
+			dirtyNodes[depth].clear();
+		}
+	}
+
+	//appends the ids of every object whose bounds are at least partly inside the frustum to visible, in no particular order
+	//with a pool the top of the tree is walked here and the subtrees below it are split across the workers
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible, ThreadPool* pool = nullptr) const
+	{
+		if (nodes.empty()) return;
+
+		if (pool == nullptr || pool->size() == 0)
+		{
+			cullSubtree(frustum, 0, INVALID_INDEX, visible, nullptr);
+			return;
+		}
+
+		//deep enough that there are a few subtrees per worker
+		uint32_t splitDepth = 0;
+		for (size_t subtrees = 1; subtrees < pool->size() * 4; subtrees *= 4)
+		{
+			splitDepth++;
+		}
+
+		std::vector<uint32_t> subtrees;
+		cullSubtree(frustum, 0, splitDepth, visible, &subtrees);
+		if (subtrees.empty()) return;
+
+		uint32_t chunkCount = static_cast<uint32_t>(std::min(subtrees.size(), pool->size() * 4));
+		size_t perChunk = (subtrees.size() + chunkCount - 1) / chunkCount;
+		std::vector<std::vector<uint32_t>> chunkVisible(chunkCount);
+
+		std::vector<std::future<void>> chunks;
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			size_t first = std::min(subtrees.size(), chunk * perChunk);
+			size_t last = std::min(subtrees.size(), first + perChunk);
+			chunks.push_back(pool->submit([this, &frustum, &subtrees, &chunkVisible, chunk, first, last]() {
+				for (size_t i = first; i < last; i++)
+				{
+					cullSubtree(frustum, subtrees[i], INVALID_INDEX, chunkVisible[chunk], nullptr);
+				}
+			}));
+		}
+		for (auto& chunk : chunks)
+		{
+			chunk.get();
+		}
+
+		for (const auto& chunkObjects : chunkVisible)
+		{
+			visible.insert(visible.end(), chunkObjects.begin(), chunkObjects.end());
+		}
+	}
+
+	//bounds of a box after a transform, m is column major like glm
+	//the result is the box around the transformed box, not around whatever was inside the original
+	static void transformBounds(const float* m, const float* boundsMin, const float* boundsMax, float* outMin, float* outMax)
+	{
+		for (int r = 0; r < 3; r++)
+		{
+			outMin[r] = outMax[r] = m[12 + r];
+			for (int c = 0; c < 3; c++)
+			{
+				float a = m[c * 4 + r] * boundsMin[c];
+				float b = m[c * 4 + r] * boundsMax[c];
+				outMin[r] += std::min(a, b);
+				outMax[r] += std::max(a, b);
+			}
+		}
+	}
+
+private:
+	struct Bounds
+	{
+		float min[3];
+		float max[3];
+	};
+
+	//children[i] is a node index, or INVALID_INDEX if child i is a leaf
+	//either way the child's objects are primitives [firsts[i], firsts[i] + counts[i]), an unused child has a count of 0
+	struct Node
+	{
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		uint32_t children[4];
+		uint32_t firsts[4];
+		uint32_t counts[4];
+	};
+
+	std::vector<Bounds> objects;	//indexed by object id, in the order they were added
+
+	std::vector<Node> nodes;	//nodes[0] is the root
+	std::vector<uint32_t> nodeParents;
+	std::vector<uint32_t> nodeDepths;
+
+	//the objects in tree order, what the nodes' ranges index into
+	std::vector<uint32_t> primitiveObjects;
+	std::vector<uint32_t> objectPrimitives;
+	std::vector<uint32_t> primitiveNodes;	//the node whose leaf child holds each primitive
+	std::vector<float> primitiveBounds[6];	//min x, y, z then max x, y, z
+
+	std::vector<float> centers;	//only used during build
+
+	//nodes waiting for refit, by depth
+	std::vector<std::vector<uint32_t>> dirtyNodes;
+	std::vector<uint8_t> nodeDirty;
+
+	void markDirty(uint32_t node)
+	{
+		if (nodeDirty[node]) return;
+		nodeDirty[node] = 1;
+		dirtyNodes[nodeDepths[node]].push_back(node);
+	}
+
+	//sorts primitives [first, first + count) so the first half has the smaller centers along the longest axis, returns where the second half starts
+	uint32_t split(uint32_t first, uint32_t count)
+	{
+		float centerMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float centerMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				centerMin[a] = std::min(centerMin[a], centers[primitiveObjects[i] * 3 + a]);
+				centerMax[a] = std::max(centerMax[a], centers[primitiveObjects[i] * 3 + a]);
+			}
+		}
+
+		int axis = 0;
+		for (int a = 1; a < 3; a++)
+		{
+			if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis]) axis = a;
+		}
+
+		uint32_t middle = first + count / 2;
+		std::nth_element(primitiveObjects.begin() + first, primitiveObjects.begin() + middle, primitiveObjects.begin() + first + count,
+			[this, axis](uint32_t a, uint32_t b) { return centers[a * 3 + axis] < centers[b * 3 + axis]; });
+		return middle;
+	}
+
+	uint32_t buildNode(uint32_t first, uint32_t count, uint32_t parent, uint32_t depth)
+	{
+		uint32_t index = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+		nodeParents.push_back(parent);
+		nodeDepths.push_back(depth);
+
+		//up to 4 ranges, halves that are already small enough for a leaf aren't split again
+		uint32_t rangeFirsts[4], rangeCounts[4];
+		uint32_t rangeCount = 0;
+		if (count <= LEAF_SIZE)
+		{
+			rangeFirsts[rangeCount] = first;
+			rangeCounts[rangeCount++] = count;
+		}
+		else
+		{
+			uint32_t middle = split(first, count);
+			uint32_t halfFirsts[2] = { first, middle };
+			uint32_t halfCounts[2] = { middle - first, first + count - middle };
+			for (int h = 0; h < 2; h++)
+			{
+				if (halfCounts[h] <= LEAF_SIZE)
+				{
+					rangeFirsts[rangeCount] = halfFirsts[h];
+					rangeCounts[rangeCount++] = halfCounts[h];
+					continue;
+				}
+
+				uint32_t quarter = split(halfFirsts[h], halfCounts[h]);
+				rangeFirsts[rangeCount] = halfFirsts[h];
+				rangeCounts[rangeCount++] = quarter - halfFirsts[h];
+				rangeFirsts[rangeCount] = quarter;
+				rangeCounts[rangeCount++] = halfFirsts[h] + halfCounts[h] - quarter;
+			}
+		}
+
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			uint32_t child = INVALID_INDEX;
+			if (i < rangeCount && rangeCounts[i] > LEAF_SIZE)
+			{
+				//nodes can move while the child is built, so nothing is held across this
+				child = buildNode(rangeFirsts[i], rangeCounts[i], index, depth + 1);
+			}
+			else if (i < rangeCount)
+			{
+				std::fill(primitiveNodes.begin() + rangeFirsts[i], primitiveNodes.begin() + rangeFirsts[i] + rangeCounts[i], index);
+			}
+
+			Node& node = nodes[index];
+			node.children[i] = child;
+			node.firsts[i] = i < rangeCount ? rangeFirsts[i] : 0;
+			node.counts[i] = i < rangeCount ? rangeCounts[i] : 0;
+		}
+
+		return index;
+	}
+
+	//works out a node's child bounds from its leaves' primitives and its child nodes, returns true if they changed
+	bool refitNode(uint32_t index)
+	{
+		Node& node = nodes[index];
+		bool changed = false;
+
+		for (int i = 0; i < 4; i++)
+		{
+			float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+			if (node.children[i] != INVALID_INDEX)
+			{
+				const Node& child = nodes[node.children[i]];
+				for (int c = 0; c < 4; c++)
+				{
+					if (child.counts[c] == 0) continue;
+					boundsMin[0] = std::min(boundsMin[0], child.minX[c]);
+					boundsMin[1] = std::min(boundsMin[1], child.minY[c]);
+					boundsMin[2] = std::min(boundsMin[2], child.minZ[c]);
+					boundsMax[0] = std::max(boundsMax[0], child.maxX[c]);
+					boundsMax[1] = std::max(boundsMax[1], child.maxY[c]);
+					boundsMax[2] = std::max(boundsMax[2], child.maxZ[c]);
+				}
+			}
+			else
+			{
+				for (uint32_t primitive = node.firsts[i]; primitive < node.firsts[i] + node.counts[i]; primitive++)
+				{
+					for (int a = 0; a < 3; a++)
+					{
+						boundsMin[a] = std::min(boundsMin[a], primitiveBounds[a][primitive]);
+						boundsMax[a] = std::max(boundsMax[a], primitiveBounds[3 + a][primitive]);
+					}
+				}
+			}
+
+			changed = changed
+				|| node.minX[i] != boundsMin[0] || node.minY[i] != boundsMin[1] || node.minZ[i] != boundsMin[2]
+				|| node.maxX[i] != boundsMax[0] || node.maxY[i] != boundsMax[1] || node.maxZ[i] != boundsMax[2];
+
+			node.minX[i] = boundsMin[0];
+			node.minY[i] = boundsMin[1];
+			node.minZ[i] = boundsMin[2];
+			node.maxX[i] = boundsMax[0];
+			node.maxY[i] = boundsMax[1];
+			node.maxZ[i] = boundsMax[2];
+		}
+
+		return changed;
+	}
+
+	//tests 4 boxes, given as structure of arrays, against every plane
+	//bit i of outside is set if box i is entirely outside one of the planes, bit i of inside if it's entirely inside all of them
+	//per plane, the corner furthest along the normal decides outside and the one furthest against it decides inside
+		//which corner that is only depends on the signs of the normal, so it's the same min/max choice for all 4 boxes
+	static void testBoxes(const Frustum& frustum, const float* minX, const float* minY, const float* minZ,
+		const float* maxX, const float* maxY, const float* maxZ, int& outside, int& inside)
+	{
+#ifdef BVH_USE_SSE2
+		__m128 x[2] = { _mm_loadu_ps(minX), _mm_loadu_ps(maxX) };
+		__m128 y[2] = { _mm_loadu_ps(minY), _mm_loadu_ps(maxY) };
+		__m128 z[2] = { _mm_loadu_ps(minZ), _mm_loadu_ps(maxZ) };
+		__m128 zero = _mm_setzero_ps();
+		__m128 outsideMask = zero;
+		__m128 insideMask = _mm_cmpeq_ps(zero, zero);
+
+		for (int p = 0; p < Frustum::PlaneCount; p++)
+		{
+			const float* plane = frustum.planes[p];
+			int sx = plane[0] >= 0.0f ? 1 : 0;
+			int sy = plane[1] >= 0.0f ? 1 : 0;
+			int sz = plane[2] >= 0.0f ? 1 : 0;
+			__m128 a = _mm_set1_ps(plane[0]);
+			__m128 b = _mm_set1_ps(plane[1]);
+			__m128 c = _mm_set1_ps(plane[2]);
+			__m128 d = _mm_set1_ps(plane[3]);
+
+			__m128 furthest = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x[sx]), _mm_mul_ps(b, y[sy])), _mm_add_ps(_mm_mul_ps(c, z[sz]), d));
+			__m128 nearest = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x[1 - sx]), _mm_mul_ps(b, y[1 - sy])), _mm_add_ps(_mm_mul_ps(c, z[1 - sz]), d));
+			outsideMask = _mm_or_ps(outsideMask, _mm_cmplt_ps(furthest, zero));
+			insideMask = _mm_and_ps(insideMask, _mm_cmpge_ps(nearest, zero));
+		}
+
+		outside = _mm_movemask_ps(outsideMask);
+		inside = _mm_movemask_ps(insideMask);
+#else
+		outside = 0;
+		inside = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			bool boxOutside = false;
+			bool boxInside = true;
+			for (int p = 0; p < Frustum::PlaneCount; p++)
+			{
+				const float* plane = frustum.planes[p];
+				float furthest = plane[0] * (plane[0] >= 0.0f ? maxX[i] : minX[i]) + plane[1] * (plane[1] >= 0.0f ? maxY[i] : minY[i])
+					+ plane[2] * (plane[2] >= 0.0f ? maxZ[i] : minZ[i]) + plane[3];
+				float nearest = plane[0] * (plane[0] >= 0.0f ? minX[i] : maxX[i]) + plane[1] * (plane[1] >= 0.0f ? minY[i] : maxY[i])
+					+ plane[2] * (plane[2] >= 0.0f ? minZ[i] : maxZ[i]) + plane[3];
+				boxOutside = boxOutside || furthest < 0.0f;
+				boxInside = boxInside && nearest >= 0.0f;
+			}
+			outside |= boxOutside ? 1 << i : 0;
+			inside |= boxInside ? 1 << i : 0;
+		}
+#endif
+	}
+
+	void addRange(uint32_t first, uint32_t count, std::vector<uint32_t>& visible) const
+	{
+		visible.insert(visible.end(), primitiveObjects.begin() + first, primitiveObjects.begin() + first + count);
+	}
+
+	//depth first from root, nodes at splitDepth go into subtrees instead of being visited when subtrees isn't null
+	void cullSubtree(const Frustum& frustum, uint32_t root, uint32_t splitDepth, std::vector<uint32_t>& visible, std::vector<uint32_t>* subtrees) const
+	{
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = root;
+
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+
+			int outside, inside;
+			testBoxes(frustum, node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, outside, inside);
+
+			for (int i = 0; i < 4; i++)
+			{
+				if (node.counts[i] == 0 || (outside & (1 << i))) continue;
+
+				if (inside & (1 << i))
+				{
+					addRange(node.firsts[i], node.counts[i], visible);
+				}
+				else if (node.children[i] != INVALID_INDEX)
+				{
+					if (subtrees != nullptr && nodeDepths[node.children[i]] >= splitDepth)
+					{
+						subtrees->push_back(node.children[i]);
+					}
+					else
+					{
+						stack[stackSize++] = node.children[i];
+					}
+				}
+				else
+				{
+					//a leaf that's partly inside, its objects get tested themselves
+					uint32_t first = node.firsts[i];
+					int objectOutside, objectInside;
+					testBoxes(frustum, &primitiveBounds[0][first], &primitiveBounds[1][first], &primitiveBounds[2][first],
+						&primitiveBounds[3][first], &primitiveBounds[4][first], &primitiveBounds[5][first], objectOutside, objectInside);
+
+					for (uint32_t o = 0; o < node.counts[i]; o++)
+					{
+						if (!(objectOutside & (1 << o)))
+						{
+							visible.push_back(primitiveObjects[first + o]);
+						}
+					}
+				}
+			}
+		}
+	}
+};
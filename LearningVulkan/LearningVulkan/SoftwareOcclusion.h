@@ -0,0 +1,600 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <future>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+//same as MipGenerator, MSVC lets AVX2 intrinsics be used without /arch:AVX2 so the kernel is picked at runtime
+#define OCCLUSION_TARGET_AVX2
+#else
+#define OCCLUSION_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#define OCCLUSION_HAS_AVX2_KERNEL
+#endif
+
+//a small depth buffer rasterized on the CPU, for occlusion culling without waiting on the GPU
+//each frame:
+	//beginFrame, then addOccluder for the meshes that should hide things (big, near, and simple)
+	//render transforms and bins the triangles into tiles, then each tile is rasterized on its own
+		//both steps are split across the thread pool, the tiles don't share any pixels so nothing needs locking
+	//isBoxVisible then tests bounding boxes against the result, it only reads so it can be called from any thread
+//rasterization is 8 pixels at a time with AVX2 (scalar without it), the edge functions and depth are planes so each step is one add
+//depth is [0, 1] like the GPU's, smaller is nearer, and only triangles facing the camera are drawn (counter clockwise after the y flip)
+//coverage is sampled at pixel centers, so at the buffer's resolution an occluder's edge can hide a sliver of what's behind it
+class SoftwareOcclusion
+{
+public:
+	static const uint32_t TILE_WIDTH = 32;
+	static const uint32_t TILE_HEIGHT = 16;
+
+	//an indexed triangle mesh with tightly packed xyz positions
+	struct Mesh
+	{
+		std::vector<float> positions;
+		std::vector<uint32_t> indices;
+	};
+
+	//the width is rounded up to a multiple of 8 so rows can always be read 8 pixels at a time
+	void resize(uint32_t newWidth, uint32_t newHeight)
+	{
+		width = (std::max(newWidth, 8u) + 7) & ~7u;
+		height = std::max(newHeight, 1u);
+		tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+		tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+		depth.assign(width * height, 1.0f);
+	}
+
+	uint32_t getWidth() const { return width; }
+	uint32_t getHeight() const { return height; }
+	const std::vector<float>& getDepth() const { return depth; }
+
+	//forgets last frame's occluders, the depth is cleared by render
+	void beginFrame()
+	{
+		occluders.clear();
+		triangleCount = 0;
+	}
+
+	//positions are xyz floats, stride bytes apart, so a vertex struct can be passed in directly
+	//mvp is column major like glm and takes the positions to clip space, it's copied
+	//positions and indices are only read in render, so they have to stay alive until then
+	void addOccluder(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount, const float* mvp)
+	{
+		Occluder occluder;
+		occluder.positions = reinterpret_cast<const uint8_t*>(positions);
+		occluder.stride = stride;
+		occluder.indices = indices;
+		occluder.firstTriangle = triangleCount;
+		std::copy(mvp, mvp + 16, occluder.mvp);
+		occluders.push_back(occluder);
+
+		triangleCount += indexCount / 3;
+	}
+
+	void addOccluder(const Mesh& mesh, const float* mvp)
+	{
+		addOccluder(mesh.positions.data(), sizeof(float) * 3, mesh.indices.data(), mesh.indices.size(), mvp);
+	}
+
+	//triangles added since beginFrame, including the ones that end up culled
+	size_t getTriangleCount() const { return triangleCount; }
+
+	//rasterizes every occluder added since beginFrame
+	void render(ThreadPool* pool = nullptr)
+	{
+		uint32_t tileCount = tilesX * tilesY;
+
+		//binning, each chunk of triangles has its own set of bins so chunks don't have to share anything
+		uint32_t triangles = static_cast<uint32_t>(triangleCount);
+		uint32_t binChunks = 1;
+		if (pool != nullptr && pool->size() > 0)
+		{
+			binChunks = std::max(1u, std::min(triangles / 1024, static_cast<uint32_t>(pool->size() * 4)));
+		}
+
+		setups.resize(triangles);
+		bins.resize(binChunks);
+		for (auto& chunkBins : bins)
+		{
+			chunkBins.resize(tileCount);
+			for (auto& bin : chunkBins)
+			{
+				bin.clear();
+			}
+		}
+
+		parallelFor(pool, triangles, binChunks, [this](uint32_t chunk, uint32_t first, uint32_t last) {
+			binTriangles(bins[chunk], first, last);
+		});
+
+		//rasterization, one tile at a time, each tile goes through every chunk's bin for it
+		uint32_t tileChunks = 1;
+		if (pool != nullptr && pool->size() > 0)
+		{
+			tileChunks = std::min(tileCount, static_cast<uint32_t>(pool->size() * 4));
+		}
+
+		parallelFor(pool, tileCount, tileChunks, [this, binChunks](uint32_t, uint32_t first, uint32_t last) {
+			for (uint32_t tile = first; tile < last; tile++)
+			{
+				rasterizeTile(tile, binChunks);
+			}
+		});
+	}
+
+	//true if any part of the box could be seen past the occluders
+	//boxMin and boxMax are the corners of an axis aligned box in the space mvp takes points from
+	//boxes that cross the near plane always count as visible, boxes that are off screen never do
+	bool isBoxVisible(const float* boxMin, const float* boxMax, const float* mvp) const
+	{
+		float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f;
+		float nearest = 1.0f;
+
+		for (int c = 0; c < 8; c++)
+		{
+			float corner[3] = {
+				(c & 1) != 0 ? boxMax[0] : boxMin[0],
+				(c & 2) != 0 ? boxMax[1] : boxMin[1],
+				(c & 4) != 0 ? boxMax[2] : boxMin[2]
+			};
+
+			float clip[4];
+			transform(mvp, corner, clip);
+
+			//crossing the near plane, the projection isn't meaningful
+			if (clip[2] < 0.0f || clip[3] <= 0.0f) return true;
+
+			float x, y, z;
+			toScreen(clip, x, y, z);
+			minX = c == 0 ? x : std::min(minX, x);
+			minY = c == 0 ? y : std::min(minY, y);
+			maxX = c == 0 ? x : std::max(maxX, x);
+			maxY = c == 0 ? y : std::max(maxY, y);
+			nearest = c == 0 ? z : std::min(nearest, z);
+		}
+
+		if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height) return false;
+
+		//every pixel the box touches, widened to whole groups of 8 which only makes the test more conservative
+		uint32_t x0 = static_cast<uint32_t>(std::max(minX, 0.0f)) & ~7u;
+		uint32_t x1 = (static_cast<uint32_t>(std::min(maxX, width - 1.0f)) + 8) & ~7u;
+		uint32_t y0 = static_cast<uint32_t>(std::max(minY, 0.0f));
+		uint32_t y1 = static_cast<uint32_t>(std::min(maxY, height - 1.0f)) + 1;
+
+#ifdef OCCLUSION_HAS_AVX2_KERNEL
+		if (useAvx2())
+		{
+			return anyNotNearerAvx2(x0, y0, x1, y1, nearest);
+		}
+#endif
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			const float* row = depth.data() + y * width;
+			for (uint32_t x = x0; x < x1; x++)
+			{
+				if (row[x] >= nearest) return true;
+			}
+		}
+		return false;
+	}
+
+	//a lower detail copy of a mesh to use as an occluder, by vertex clustering
+		//vertices are snapped to a gridSize^3 grid over the mesh's bounds, each cell becomes one vertex at the average of its vertices
+		//triangles that end up with less than 3 different cells are dropped, as are duplicates
+	//the result stays inside the original's bounds, but can stick out of its silhouette by up to a cell
+		//so keep the grid fine enough that occluders don't grow noticeably
+	static Mesh simplify(const float* positions, size_t vertexCount, size_t stride, const uint32_t* indices, size_t indexCount, uint32_t gridSize)
+	{
+		Mesh mesh;
+		if (vertexCount == 0 || gridSize == 0) return mesh;
+
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(positions);
+		auto position = [&](size_t i) { return reinterpret_cast<const float*>(bytes + i * stride); };
+
+		float boundsMin[3], boundsMax[3];
+		for (int a = 0; a < 3; a++)
+		{
+			boundsMin[a] = boundsMax[a] = position(0)[a];
+		}
+		for (size_t i = 1; i < vertexCount; i++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				boundsMin[a] = std::min(boundsMin[a], position(i)[a]);
+				boundsMax[a] = std::max(boundsMax[a], position(i)[a]);
+			}
+		}
+
+		//which cell each vertex falls into, cells get numbered in the order they're first seen
+		std::unordered_map<uint64_t, uint32_t> cellIndices;
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint32_t> cellVertexCounts;
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			uint64_t key = 0;
+			for (int a = 0; a < 3; a++)
+			{
+				float extent = boundsMax[a] - boundsMin[a];
+				uint32_t cell = extent > 0.0f
+					? std::min(gridSize - 1, static_cast<uint32_t>((position(i)[a] - boundsMin[a]) / extent * gridSize))
+					: 0;
+				key = key * gridSize + cell;
+			}
+
+			auto inserted = cellIndices.emplace(key, static_cast<uint32_t>(cellVertexCounts.size()));
+			if (inserted.second)
+			{
+				cellVertexCounts.push_back(0);
+				mesh.positions.insert(mesh.positions.end(), { 0.0f, 0.0f, 0.0f });
+			}
+
+			uint32_t cellIndex = inserted.first->second;
+			remap[i] = cellIndex;
+			cellVertexCounts[cellIndex]++;
+			for (int a = 0; a < 3; a++)
+			{
+				mesh.positions[cellIndex * 3 + a] += position(i)[a];
+			}
+		}
+
+		for (size_t cell = 0; cell < cellVertexCounts.size(); cell++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				mesh.positions[cell * 3 + a] /= cellVertexCounts[cell];
+			}
+		}
+
+		//duplicates are found with the smallest index rotated to the front, which keeps the winding
+		std::unordered_set<TriangleKey, TriangleKeyHash> seen;
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			uint32_t t[3] = { remap[indices[i]], remap[indices[i + 1]], remap[indices[i + 2]] };
+			if (t[0] == t[1] || t[1] == t[2] || t[2] == t[0]) continue;
+
+			while (t[0] > t[1] || t[0] > t[2])
+			{
+				std::rotate(t, t + 1, t + 3);
+			}
+
+			TriangleKey key = { { t[0], t[1], t[2] } };
+			if (!seen.insert(key).second) continue;
+
+			mesh.indices.insert(mesh.indices.end(), t, t + 3);
+		}
+
+		return mesh;
+	}
+
+	//name of the rasterization kernel used on this CPU
+	static const char* kernelName()
+	{
+#ifdef OCCLUSION_HAS_AVX2_KERNEL
+		if (useAvx2()) return "AVX2";
+#endif
+		return "scalar";
+	}
+
+private:
+	//the full cell indices of a triangle, for finding duplicates in simplify
+	struct TriangleKey
+	{
+		uint32_t v[3];
+
+		bool operator==(const TriangleKey& other) const
+		{
+			return v[0] == other.v[0] && v[1] == other.v[1] && v[2] == other.v[2];
+		}
+	};
+
+	struct TriangleKeyHash
+	{
+		size_t operator()(const TriangleKey& key) const
+		{
+			uint64_t hash = (static_cast<uint64_t>(key.v[0]) << 32) | key.v[1];
+			hash ^= key.v[2] * 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+			return std::hash<uint64_t>()(hash);
+		}
+	};
+
+	struct Occluder
+	{
+		const uint8_t* positions;
+		size_t stride;
+		const uint32_t* indices;
+		size_t firstTriangle;
+		float mvp[16];
+	};
+
+	//a triangle ready to rasterize, as planes over the screen evaluated at pixel centers
+		//the edges are >= 0 on the inside, depth is the interpolated depth
+	struct TriangleSetup
+	{
+		float edges[3][3];	//a, b, c of a * x + b * y + c
+		float depth[3];
+		uint32_t minX, minY, maxX, maxY;	//pixel bounds, max is exclusive and minX and maxX are multiples of 8
+	};
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t tilesX = 0;
+	uint32_t tilesY = 0;
+	std::vector<float> depth;
+
+	std::vector<Occluder> occluders;
+	size_t triangleCount = 0;
+	//indexed by triangle, only the ones that were binned are filled in
+	std::vector<TriangleSetup> setups;
+	//bins[chunk][tile] is the triangles from that binning chunk that touch that tile
+	std::vector<std::vector<std::vector<uint32_t>>> bins;
+
+	static void transform(const float* m, const float* p, float* clip)
+	{
+		for (int r = 0; r < 4; r++)
+		{
+			clip[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+		}
+	}
+
+	//clip space to pixels, y goes down the screen like the viewport
+	void toScreen(const float* clip, float& x, float& y, float& z) const
+	{
+		float invW = 1.0f / clip[3];
+		x = (clip[0] * invW * 0.5f + 0.5f) * width;
+		y = (clip[1] * invW * 0.5f + 0.5f) * height;
+		z = clip[2] * invW;
+	}
+
+	//runs function(chunk, first, last) over [0, count) in chunkCount pieces, on the pool if there is one
+	template<typename F>
+	static void parallelFor(ThreadPool* pool, uint32_t count, uint32_t chunkCount, F function)
+	{
+		if (pool == nullptr)
+		{
+			function(0, 0, count);
+			return;
+		}
+
+		pool->parallelFor(count, chunkCount, function);
+	}
+
+	//transforms triangles [first, last), sets up the ones that are facing the camera and on screen, and adds them to the bins of the tiles they touch
+	//vertices are transformed once per triangle they're in, which keeps chunks independent of each other
+	void binTriangles(std::vector<std::vector<uint32_t>>& chunkBins, uint32_t first, uint32_t last)
+	{
+		if (first >= last) return;
+
+		//the occluder the first triangle belongs to, the rest are found by walking forwards
+		size_t occluderIndex = std::upper_bound(occluders.begin(), occluders.end(), static_cast<size_t>(first),
+			[](size_t triangle, const Occluder& occluder) { return triangle < occluder.firstTriangle; }) - occluders.begin() - 1;
+
+		for (uint32_t triangle = first; triangle < last; triangle++)
+		{
+			while (occluderIndex + 1 < occluders.size() && occluders[occluderIndex + 1].firstTriangle <= triangle)
+			{
+				occluderIndex++;
+			}
+			const Occluder& occluder = occluders[occluderIndex];
+			const uint32_t* corners = occluder.indices + (triangle - occluder.firstTriangle) * 3;
+
+			float x[3], y[3], z[3];
+			bool clipped = false;
+			for (int v = 0; v < 3; v++)
+			{
+				float clip[4];
+				transform(occluder.mvp, reinterpret_cast<const float*>(occluder.positions + corners[v] * occluder.stride), clip);
+
+				//no clipping, a triangle that crosses the near plane just isn't used as an occluder
+				if (clip[2] < 0.0f || clip[3] <= 0.0f)
+				{
+					clipped = true;
+					break;
+				}
+				toScreen(clip, x[v], y[v], z[v]);
+			}
+			if (clipped) continue;
+
+			//twice the signed area, negative is counter clockwise on screen which is the front face
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (area >= 0.0f) continue;
+
+			//swapped to clockwise so the edge functions are positive on the inside
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+
+			float minX = std::min(x[0], std::min(x[1], x[2]));
+			float maxX = std::max(x[0], std::max(x[1], x[2]));
+			float minY = std::min(y[0], std::min(y[1], y[2]));
+			float maxY = std::max(y[0], std::max(y[1], y[2]));
+			if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height) continue;
+
+			TriangleSetup& setup = setups[triangle];
+			for (int e = 0; e < 3; e++)
+			{
+				int a = e;
+				int b = (e + 1) % 3;
+				setup.edges[e][0] = y[a] - y[b];
+				setup.edges[e][1] = x[b] - x[a];
+				setup.edges[e][2] = -(setup.edges[e][0] * x[a] + setup.edges[e][1] * y[a]);
+			}
+
+			float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+			float dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+			setup.depth[0] = dzdx;
+			setup.depth[1] = dzdy;
+			setup.depth[2] = z[0] - dzdx * x[0] - dzdy * y[0];
+
+			setup.minX = static_cast<uint32_t>(std::max(minX, 0.0f)) & ~7u;
+			setup.maxX = (static_cast<uint32_t>(std::min(maxX, width - 1.0f)) + 8) & ~7u;
+			setup.minY = static_cast<uint32_t>(std::max(minY, 0.0f));
+			setup.maxY = static_cast<uint32_t>(std::min(maxY, height - 1.0f)) + 1;
+
+			uint32_t tileX0 = setup.minX / TILE_WIDTH;
+			uint32_t tileX1 = (setup.maxX - 1) / TILE_WIDTH;
+			uint32_t tileY0 = setup.minY / TILE_HEIGHT;
+			uint32_t tileY1 = (setup.maxY - 1) / TILE_HEIGHT;
+			for (uint32_t tileY = tileY0; tileY <= tileY1; tileY++)
+			{
+				for (uint32_t tileX = tileX0; tileX <= tileX1; tileX++)
+				{
+					chunkBins[tileY * tilesX + tileX].push_back(triangle);
+				}
+			}
+		}
+	}
+
+	void rasterizeTile(uint32_t tile, uint32_t binChunks)
+	{
+		uint32_t tileX0 = (tile % tilesX) * TILE_WIDTH;
+		uint32_t tileY0 = (tile / tilesX) * TILE_HEIGHT;
+		uint32_t tileX1 = std::min(width, tileX0 + TILE_WIDTH);
+		uint32_t tileY1 = std::min(height, tileY0 + TILE_HEIGHT);
+
+		for (uint32_t y = tileY0; y < tileY1; y++)
+		{
+			std::fill(depth.begin() + y * width + tileX0, depth.begin() + y * width + tileX1, 1.0f);
+		}
+
+		for (uint32_t chunk = 0; chunk < binChunks; chunk++)
+		{
+			for (uint32_t triangle : bins[chunk][tile])
+			{
+				const TriangleSetup& setup = setups[triangle];
+				uint32_t x0 = std::max(tileX0, setup.minX);
+				uint32_t y0 = std::max(tileY0, setup.minY);
+				uint32_t x1 = std::min(tileX1, setup.maxX);
+				uint32_t y1 = std::min(tileY1, setup.maxY);
+#ifdef OCCLUSION_HAS_AVX2_KERNEL
+				if (useAvx2())
+				{
+					rasterizeAvx2(setup, x0, y0, x1, y1);
+					continue;
+				}
+#endif
+				rasterizeScalar(setup, x0, y0, x1, y1);
+			}
+		}
+	}
+
+	void rasterizeScalar(const TriangleSetup& setup, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+	{
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			float* row = depth.data() + y * width;
+			float py = y + 0.5f;
+			for (uint32_t x = x0; x < x1; x++)
+			{
+				float px = x + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++)
+				{
+					inside = inside && setup.edges[e][0] * px + setup.edges[e][1] * py + setup.edges[e][2] >= 0.0f;
+				}
+				if (inside)
+				{
+					row[x] = std::min(row[x], setup.depth[0] * px + setup.depth[1] * py + setup.depth[2]);
+				}
+			}
+		}
+	}
+
+#ifdef OCCLUSION_HAS_AVX2_KERNEL
+	static bool cpuHasAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5));
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	static bool useAvx2()
+	{
+		static const bool supported = cpuHasAvx2();
+		return supported;
+	}
+
+	//8 pixels of a row at a time, x0 and x1 are multiples of 8
+		//the sign bit of edge0 | edge1 | edge2 is set wherever a pixel is outside any edge, which is also what blendv selects on
+	OCCLUSION_TARGET_AVX2 void rasterizeAvx2(const TriangleSetup& setup, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+	{
+		const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		__m256 px0 = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x0)), laneOffsets);
+
+		__m256 edgeA[3], edgeStep[3];
+		for (int e = 0; e < 3; e++)
+		{
+			edgeA[e] = _mm256_set1_ps(setup.edges[e][0]);
+			edgeStep[e] = _mm256_set1_ps(setup.edges[e][0] * 8.0f);
+		}
+		__m256 depthA = _mm256_set1_ps(setup.depth[0]);
+		__m256 depthStep = _mm256_set1_ps(setup.depth[0] * 8.0f);
+
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			float py = y + 0.5f;
+			float* row = depth.data() + y * width;
+
+			__m256 edges[3];
+			for (int e = 0; e < 3; e++)
+			{
+				edges[e] = _mm256_add_ps(_mm256_mul_ps(edgeA[e], px0), _mm256_set1_ps(setup.edges[e][1] * py + setup.edges[e][2]));
+			}
+			__m256 z = _mm256_add_ps(_mm256_mul_ps(depthA, px0), _mm256_set1_ps(setup.depth[1] * py + setup.depth[2]));
+
+			for (uint32_t x = x0; x < x1; x += 8)
+			{
+				__m256 outside = _mm256_or_ps(_mm256_or_ps(edges[0], edges[1]), edges[2]);
+				if (_mm256_movemask_ps(outside) != 0xFF)
+				{
+					__m256 current = _mm256_loadu_ps(row + x);
+					_mm256_storeu_ps(row + x, _mm256_blendv_ps(_mm256_min_ps(current, z), current, outside));
+				}
+
+				for (int e = 0; e < 3; e++)
+				{
+					edges[e] = _mm256_add_ps(edges[e], edgeStep[e]);
+				}
+				z = _mm256_add_ps(z, depthStep);
+			}
+		}
+	}
+
+	OCCLUSION_TARGET_AVX2 bool anyNotNearerAvx2(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, float nearest) const
+	{
+		__m256 boxDepth = _mm256_set1_ps(nearest);
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			const float* row = depth.data() + y * width;
+			for (uint32_t x = x0; x < x1; x += 8)
+			{
+				if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(row + x), boxDepth, _CMP_GE_OQ)) != 0)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+#endif
+};
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+//every submission made through it gets a value, counting up from 1 on each queue, so the CPU can wait on or poll any submission
+	//with VK_KHR_timeline_semaphore each queue has a timeline semaphore that its submissions signal with their values
+	//without it each submission signals a fence, and a value is done once its fence and every earlier one on the queue have signaled
+//work given to defer runs from collect once the submission it's keyed to is done, for destroying what the submission used
+//submissions can still wait on and signal binary semaphores, swap chain images and waits between queues use those
+	//with timeline semaphores a submission can also wait on another queue's ticket, see after
+class SubmitScheduler
+{
+public:
+	//one submission, queue is what addQueue returned
+	struct Ticket
+	{
+		uint32_t queue = 0;
+		uint64_t value = 0;	//0 is never submitted, so it's always done
+	};
+
+	//a binary semaphore the submission waits on
+	struct Wait
+	{
+		VkSemaphore semaphore;
+		VkPipelineStageFlags stages;
+		uint64_t value;	//only for the timeline waits made by after, left 0 for binary semaphores
+	};
+
+	//VK_KHR_timeline_semaphore has to be supported for this to mean anything
+	static bool isSupported(VkPhysicalDevice physicalDevice)
+	{
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+		return timelineFeatures.timelineSemaphore == VK_TRUE;
+	}
+
+	static VkPhysicalDeviceTimelineSemaphoreFeaturesKHR requiredFeatures()
+	{
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		features.timelineSemaphore = VK_TRUE;
+		return features;
+	}
+
+	//timelineSemaphores only if the device was made with the extension and its feature enabled
+	void init(VkDevice device, bool timelineSemaphores)
+	{
+		this->device = device;
+
+		waitSemaphores = nullptr;
+		getSemaphoreCounterValue = nullptr;
+		if (timelineSemaphores)
+		{
+			waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+			getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+				vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+			if (waitSemaphores == nullptr || getSemaphoreCounterValue == nullptr)
+			{
+				throw std::runtime_error("failed to load the timeline semaphore functions!");
+			}
+		}
+	}
+
+	bool usesTimelineSemaphores() const { return waitSemaphores != nullptr; }
+
+	//the same VkQueue can be added more than once, each gets its own values
+		//submissions through different ids on one VkQueue have to come from the same thread, like any other vkQueueSubmit
+	uint32_t addQueue(VkQueue queue)
+	{
+		Queue added;
+		added.queue = queue;
+
+		if (usesTimelineSemaphores())
+		{
+			VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			typeInfo.initialValue = 0;
+
+			VkSemaphoreCreateInfo semaphoreInfo = {};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphoreInfo.pNext = &typeInfo;
+
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &added.timeline) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create timeline semaphore!");
+			}
+		}
+
+		queues.push_back(added);
+		return static_cast<uint32_t>(queues.size() - 1);
+	}
+
+	//waits for everything submitted, then runs whatever is still deferred
+	void destroy()
+	{
+		waitAll();
+		collect();
+
+		for (Queue& queue : queues)
+		{
+			vkDestroySemaphore(device, queue.timeline, nullptr);
+		}
+		queues.clear();
+
+		for (VkFence fence : freeFences)
+		{
+			vkDestroyFence(device, fence, nullptr);
+		}
+		freeFences.clear();
+	}
+
+	Ticket submit(uint32_t queue, const std::vector<VkCommandBuffer>& commandBuffers,
+		const std::vector<Wait>& waits = {}, const std::vector<VkSemaphore>& signals = {})
+	{
+		Queue& submitQueue = queues[queue];
+
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<VkPipelineStageFlags> waitStages;
+		for (const Wait& wait : waits)
+		{
+			waitSemaphores.push_back(wait.semaphore);
+			waitStages.push_back(wait.stages);
+		}
+		std::vector<VkSemaphore> signalSemaphores = signals;
+
+		Ticket ticket;
+		ticket.queue = queue;
+		ticket.value = submitQueue.submitted + 1;
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+		//binary semaphores still need an entry in the value arrays, it's ignored
+		std::vector<uint64_t> waitValues;
+		for (const Wait& wait : waits)
+		{
+			waitValues.push_back(wait.value);
+		}
+		std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+		VkFence fence = VK_NULL_HANDLE;
+		if (usesTimelineSemaphores())
+		{
+			signalSemaphores.push_back(submitQueue.timeline);
+			signalValues.push_back(ticket.value);
+
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+			timelineInfo.pWaitSemaphoreValues = waitValues.data();
+			timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+			timelineInfo.pSignalSemaphoreValues = signalValues.data();
+			submitInfo.pNext = &timelineInfo;
+		}
+		else
+		{
+			fence = takeFence();
+		}
+
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		submitInfo.pCommandBuffers = commandBuffers.data();
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+		if (vkQueueSubmit(submitQueue.queue, 1, &submitInfo, fence) != VK_SUCCESS)
+		{
+			if (fence != VK_NULL_HANDLE) freeFences.push_back(fence);
+			throw std::runtime_error("failed to submit to queue!");
+		}
+
+		submitQueue.submitted = ticket.value;
+		if (fence != VK_NULL_HANDLE)
+		{
+			submitQueue.fences.push_back({ ticket.value, fence });
+		}
+		return ticket;
+	}
+
+	//the last submission made on queue, done once everything submitted there so far is
+	Ticket last(uint32_t queue) const
+	{
+		Ticket ticket;
+		ticket.queue = queue;
+		ticket.value = queues[queue].submitted;
+		return ticket;
+	}
+
+	//a wait for submit that holds stages back until ticket is done on the GPU, without a semaphore of its own
+		//ticket can be on another queue, one that hasn't been submitted yet mustn't be waited on by a submission it's behind
+	Wait after(Ticket ticket, VkPipelineStageFlags stages) const
+	{
+		if (!usesTimelineSemaphores())
+		{
+			throw std::runtime_error("waiting on a submission from the GPU needs timeline semaphores!");
+		}
+
+		Wait wait = {};
+		wait.semaphore = queues[ticket.queue].timeline;
+		wait.stages = stages;
+		wait.value = ticket.value;
+		return wait;
+	}
+
+	bool isDone(Ticket ticket)
+	{
+		Queue& queue = queues[ticket.queue];
+		if (ticket.value <= queue.completed) return true;
+
+		if (usesTimelineSemaphores())
+		{
+			getSemaphoreCounterValue(device, queue.timeline, &queue.completed);
+		}
+		else
+		{
+			while (!queue.fences.empty() && vkGetFenceStatus(device, queue.fences.front().fence) == VK_SUCCESS)
+			{
+				retireFence(queue);
+			}
+		}
+		return ticket.value <= queue.completed;
+	}
+
+	void wait(Ticket ticket)
+	{
+		if (isDone(ticket)) return;
+
+		Queue& queue = queues[ticket.queue];
+		if (usesTimelineSemaphores())
+		{
+			VkSemaphoreWaitInfoKHR waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &queue.timeline;
+			waitInfo.pValues = &ticket.value;
+			waitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max());
+			queue.completed = ticket.value;
+		}
+		else
+		{
+			while (!queue.fences.empty() && queue.fences.front().value <= ticket.value)
+			{
+				vkWaitForFences(device, 1, &queue.fences.front().fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+				retireFence(queue);
+			}
+		}
+	}
+
+	//everything submitted on every queue so far
+	void waitAll()
+	{
+		for (uint32_t i = 0; i < queues.size(); i++)
+		{
+			wait(last(i));
+		}
+	}
+
+	void defer(Ticket ticket, std::function<void()> work)
+	{
+		deferred.push_back({ ticket, std::move(work) });
+	}
+
+	//runs the deferred work whose submissions are done, in the order it was deferred
+	void collect()
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < deferred.size(); i++)
+		{
+			if (isDone(deferred[i].ticket))
+			{
+				deferred[i].work();
+			}
+			else
+			{
+				deferred[kept++] = std::move(deferred[i]);
+			}
+		}
+		deferred.resize(kept);
+	}
+
+private:
+	struct PendingFence
+	{
+		uint64_t value;
+		VkFence fence;
+	};
+
+	struct Queue
+	{
+		VkQueue queue = VK_NULL_HANDLE;
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		uint64_t submitted = 0;
+		uint64_t completed = 0;	//as of the last check, can be behind
+		std::deque<PendingFence> fences;	//oldest first, only without timeline semaphores
+	};
+
+	struct Deferred
+	{
+		Ticket ticket;
+		std::function<void()> work;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+	PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+	std::vector<Queue> queues;
+	std::vector<VkFence> freeFences;
+	std::vector<Deferred> deferred;
+
+	VkFence takeFence()
+	{
+		if (!freeFences.empty())
+		{
+			VkFence fence = freeFences.back();
+			freeFences.pop_back();
+			return fence;
+		}
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkFence fence;
+		if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create submission fence!");
+		}
+		return fence;
+	}
+
+	//the oldest pending fence has signaled
+	void retireFence(Queue& queue)
+	{
+		PendingFence pending = queue.fences.front();
+		queue.fences.pop_front();
+		queue.completed = pending.value;
+
+		vkResetFences(device, 1, &pending.fence);
+		freeFences.push_back(pending.fence);
+	}
+};
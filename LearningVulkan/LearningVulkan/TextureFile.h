@@ -0,0 +1,283 @@
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+
+//.vktx is our baked texture container
+//it is laid out so the loader never has to touch individual texels:
+	//a fixed size header
+	//a table with one entry per mip level
+	//the level data, largest level first, each level tightly packed in the final GPU format
+//since every level is already in the format the image is created with,
+	//the whole data block can be memcpy'd into a staging buffer and uploaded with one vkCmdCopyBufferToImage
+namespace TextureFile
+{
+	const char MAGIC[4] = { 'V', 'K', 'T', 'X' };
+	const uint32_t VERSION = 1;
+	//level data offsets are aligned to this, which covers the texel/block size of every format we bake
+	const uint64_t LEVEL_ALIGNMENT = 16;
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t format;	//a VkFormat value
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint64_t dataOffset;	//offset of the first level from the start of the file
+		uint64_t dataSize;	//size of all the levels together, including alignment padding
+	};
+
+	struct Level
+	{
+		uint64_t offset;	//relative to dataOffset, so it can be used as a staging buffer offset directly
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	//the most mip levels a width x height image can have, down to 1x1
+	inline uint32_t maxLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t count = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+		{
+			count++;
+		}
+		return count;
+	}
+
+	//levels[i] holds the bytes for mip level i
+	inline void write(const std::string& path, uint32_t format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels)
+	{
+		Header header = {};
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.format = format;
+		header.width = width;
+		header.height = height;
+		header.mipLevels = static_cast<uint32_t>(levels.size());
+		header.dataOffset = alignUp(sizeof(Header) + sizeof(Level) * levels.size(), LEVEL_ALIGNMENT);
+
+		std::vector<Level> table(levels.size());
+		uint64_t offset = 0;
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			table[i].offset = offset;
+			table[i].size = levels[i].size();
+			table[i].width = std::max(1u, width >> i);
+			table[i].height = std::max(1u, height >> i);
+			offset = alignUp(offset + levels[i].size(), LEVEL_ALIGNMENT);
+		}
+		header.dataSize = offset;
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to open " + path + " for writing!");
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(table.data()), sizeof(Level) * table.size());
+
+		const char zeros[LEVEL_ALIGNMENT] = {};
+		uint64_t written = sizeof(Header) + sizeof(Level) * table.size();
+		file.write(zeros, header.dataOffset - written);
+
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			file.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+			file.write(zeros, alignUp(levels[i].size(), LEVEL_ALIGNMENT) - levels[i].size());
+		}
+
+		if (!file)
+		{
+			throw std::runtime_error("failed to write " + path + "!");
+		}
+	}
+
+	//read only view of a whole file through the OS's memory mapping
+	//pages are only read from disk when they are touched, so opening a large texture is nearly free
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		bool open(const std::string& path)
+		{
+			close();
+
+#ifdef _WIN32
+			fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+			{
+				close();
+				return false;
+			}
+
+			mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mappingHandle == nullptr)
+			{
+				close();
+				return false;
+			}
+
+			data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+			size = static_cast<size_t>(fileSize.QuadPart);
+#else
+			fileDescriptor = ::open(path.c_str(), O_RDONLY);
+			if (fileDescriptor < 0) return false;
+
+			struct stat fileInfo;
+			if (fstat(fileDescriptor, &fileInfo) != 0 || fileInfo.st_size == 0)
+			{
+				close();
+				return false;
+			}
+
+			void* mapping = mmap(nullptr, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+			data = mapping == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapping);
+			size = static_cast<size_t>(fileInfo.st_size);
+#endif
+
+			if (data == nullptr)
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void close()
+		{
+#ifdef _WIN32
+			if (data != nullptr) UnmapViewOfFile(data);
+			if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+			if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+			mappingHandle = nullptr;
+			fileHandle = INVALID_HANDLE_VALUE;
+#else
+			if (data != nullptr) munmap(const_cast<uint8_t*>(data), size);
+			if (fileDescriptor >= 0) ::close(fileDescriptor);
+			fileDescriptor = -1;
+#endif
+			data = nullptr;
+			size = 0;
+		}
+
+		const uint8_t* getData() const { return data; }
+		size_t getSize() const { return size; }
+		bool isOpen() const { return data != nullptr; }
+
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+#ifdef _WIN32
+		HANDLE fileHandle = INVALID_HANDLE_VALUE;
+		HANDLE mappingHandle = nullptr;
+#else
+		int fileDescriptor = -1;
+#endif
+	};
+
+	//a baked texture opened through a memory mapping
+	//header, levels and data all point straight into the mapping
+	class Reader
+	{
+	public:
+		//returns false if the file doesn't exist, throws if it exists but is broken
+		bool open(const std::string& path)
+		{
+			if (!file.open(path)) return false;
+
+			if (file.getSize() < sizeof(Header))
+			{
+				throw std::runtime_error(path + " is too small to be a baked texture!");
+			}
+
+			header = reinterpret_cast<const Header*>(file.getData());
+			if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION)
+			{
+				throw std::runtime_error(path + " is not a supported baked texture!");
+			}
+
+			if (header->width == 0 || header->height == 0
+				|| header->mipLevels == 0 || header->mipLevels > maxLevelCount(header->width, header->height))
+			{
+				throw std::runtime_error(path + " has an invalid size or mip level count!");
+			}
+
+			//the sizes come from the file, so every check is written so it can't overflow
+				//with at most 32 levels the table's size can't
+			if (sizeof(Header) + sizeof(Level) * header->mipLevels > header->dataOffset
+				|| header->dataOffset > file.getSize() || header->dataSize > file.getSize() - header->dataOffset)
+			{
+				throw std::runtime_error(path + " is truncated!");
+			}
+
+			levels = reinterpret_cast<const Level*>(file.getData() + sizeof(Header));
+			for (uint32_t i = 0; i < header->mipLevels; i++)
+			{
+				if (levels[i].offset > header->dataSize || levels[i].size > header->dataSize - levels[i].offset)
+				{
+					throw std::runtime_error(path + " has a mip level outside of its data!");
+				}
+			}
+
+			return true;
+		}
+
+		void close()
+		{
+			file.close();
+			header = nullptr;
+			levels = nullptr;
+		}
+
+		const Header& getHeader() const { return *header; }
+		const Level& getLevel(uint32_t level) const { return levels[level]; }
+		//start of the level data, level offsets are relative to this
+		const uint8_t* getData() const { return file.getData() + header->dataOffset; }
+
+	private:
+		MappedFile file;
+		const Header* header = nullptr;
+		const Level* levels = nullptr;
+	};
+}
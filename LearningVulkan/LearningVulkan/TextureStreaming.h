@@ -0,0 +1,304 @@
+#pragma once
+
+#include "TextureFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//the CPU side of texture streaming, the renderer owns the images and does what this tells it to
+//every streamed texture always has its mip tail resident (the levels at or below some small size)
+//finer levels are loaded one at a time, largest screen coverage first, and given back least recently used first
+namespace TextureStreaming
+{
+	//the finest level worth having when the texture covers screenPixels pixels across
+	//one texel per pixel is enough, anything finer would only be minified away
+	inline uint32_t levelForCoverage(uint32_t width, uint32_t height, uint32_t mipLevels, float screenPixels)
+	{
+		if (screenPixels <= 0.0f) return mipLevels - 1;
+
+		float texelsPerPixel = static_cast<float>(std::max(width, height)) / screenPixels;
+		if (texelsPerPixel <= 1.0f) return 0;
+
+		return std::min(mipLevels - 1, static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))));
+	}
+
+	//the first level whose largest side is maxSize or less
+	inline uint32_t tailLevel(const TextureFile::Reader& file, uint32_t maxSize)
+	{
+		const TextureFile::Header& header = file.getHeader();
+		for (uint32_t i = 0; i < header.mipLevels; i++)
+		{
+			const TextureFile::Level& level = file.getLevel(i);
+			if (std::max(level.width, level.height) <= maxSize) return i;
+		}
+		return header.mipLevels - 1;
+	}
+
+	//GPU memory used when levels [firstLevel, mipLevels) are resident
+	inline uint64_t residentBytes(const TextureFile::Reader& file, uint32_t firstLevel)
+	{
+		uint64_t bytes = 0;
+		for (uint32_t i = firstLevel; i < file.getHeader().mipLevels; i++)
+		{
+			bytes += file.getLevel(i).size;
+		}
+		return bytes;
+	}
+
+	struct TextureState
+	{
+		const TextureFile::Reader* file = nullptr;
+		uint32_t mipLevels = 0;
+		uint32_t tailLevel = 0;	//this level and coarser are never evicted
+		uint32_t residentLevel = 0;	//finest level on the GPU
+		uint32_t wantedLevel = 0;	//from the last coverage update
+		float screenPixels = 0.0f;
+		uint64_t lastVisibleFrame = 0;
+		bool changing = false;	//a change has been handed out and not completed yet
+	};
+
+	//the renderer should make levels [residentLevel, mipLevels) of texture resident
+	struct Change
+	{
+		uint32_t texture;
+		uint32_t residentLevel;
+	};
+
+	class Scheduler
+	{
+	public:
+		explicit Scheduler(uint64_t budgetBytes) : budgetBytes(budgetBytes) {}
+
+		//the mip tail is counted against the budget straight away since the renderer uploads it up front
+		uint32_t addTexture(const TextureFile::Reader* file, uint32_t tail)
+		{
+			TextureState state;
+			state.file = file;
+			state.mipLevels = file->getHeader().mipLevels;
+			state.tailLevel = tail;
+			state.residentLevel = tail;
+			state.wantedLevel = tail;
+			textures.push_back(state);
+
+			usedBytes += residentBytes(*file, tail);
+			return static_cast<uint32_t>(textures.size() - 1);
+		}
+
+		//call every frame for every texture that was drawn
+		void markVisible(uint32_t texture, float screenPixels, uint64_t frame)
+		{
+			TextureState& state = textures[texture];
+			const TextureFile::Header& header = state.file->getHeader();
+
+			state.screenPixels = screenPixels;
+			state.lastVisibleFrame = frame;
+			state.wantedLevel = levelForCoverage(header.width, header.height, state.mipLevels, screenPixels);
+		}
+
+		//hands out at most one load per call, plus whatever evictions it needs to fit in the budget
+		//budget is reserved here, so the renderer must call completeChange for every change it gets
+		std::vector<Change> update(uint64_t frame)
+		{
+			std::vector<Change> changes;
+
+			//visible textures missing the most levels, weighted by how much of the screen they cover
+			int best = -1;
+			float bestPriority = 0.0f;
+			for (size_t i = 0; i < textures.size(); i++)
+			{
+				const TextureState& state = textures[i];
+				if (state.changing || state.lastVisibleFrame != frame || state.wantedLevel >= state.residentLevel) continue;
+
+				float priority = state.screenPixels * (state.residentLevel - state.wantedLevel);
+				if (priority > bestPriority)
+				{
+					best = static_cast<int>(i);
+					bestPriority = priority;
+				}
+			}
+
+			if (best < 0) return changes;
+
+			TextureState& target = textures[best];
+			uint32_t nextLevel = target.residentLevel - 1;
+			uint64_t needed = target.file->getLevel(nextLevel).size;
+
+			//free up space by dropping the finest levels of the least recently visible textures
+			std::vector<uint32_t> evictedLevels(textures.size());
+			for (size_t i = 0; i < textures.size(); i++)
+			{
+				evictedLevels[i] = textures[i].residentLevel;
+			}
+
+			uint64_t freed = 0;
+			while (usedBytes - freed + needed > budgetBytes)
+			{
+				int victim = findVictim(static_cast<uint32_t>(best), evictedLevels, frame);
+				if (victim < 0) return changes;	//everything left is needed more than the new level
+
+				freed += textures[victim].file->getLevel(evictedLevels[victim]).size;
+				evictedLevels[victim]++;
+			}
+
+			for (size_t i = 0; i < textures.size(); i++)
+			{
+				if (evictedLevels[i] != textures[i].residentLevel)
+				{
+					textures[i].changing = true;
+					changes.push_back({ static_cast<uint32_t>(i), evictedLevels[i] });
+				}
+			}
+
+			target.changing = true;
+			changes.push_back({ static_cast<uint32_t>(best), nextLevel });
+			usedBytes = usedBytes - freed + needed;
+
+			return changes;
+		}
+
+		void completeChange(const Change& change)
+		{
+			textures[change.texture].residentLevel = change.residentLevel;
+			textures[change.texture].changing = false;
+		}
+
+		//changes handed out that haven't been completed yet
+		bool hasPendingChanges() const
+		{
+			for (const TextureState& state : textures)
+			{
+				if (state.changing) return true;
+			}
+			return false;
+		}
+
+		void setBudget(uint64_t bytes) { budgetBytes = bytes; }
+		uint64_t getBudget() const { return budgetBytes; }
+		uint64_t getUsedBytes() const { return usedBytes; }
+		const TextureState& getTexture(uint32_t texture) const { return textures[texture]; }
+
+	private:
+		std::vector<TextureState> textures;
+		uint64_t budgetBytes;
+		uint64_t usedBytes = 0;
+
+		//least recently visible texture that still has a level above its tail it can give up
+		//textures visible this frame only give up levels finer than they currently want
+		int findVictim(uint32_t loading, const std::vector<uint32_t>& evictedLevels, uint64_t frame) const
+		{
+			int victim = -1;
+			for (size_t i = 0; i < textures.size(); i++)
+			{
+				const TextureState& state = textures[i];
+				if (i == loading || state.changing || evictedLevels[i] >= state.tailLevel) continue;
+				if (state.lastVisibleFrame == frame && evictedLevels[i] >= state.wantedLevel) continue;
+
+				if (victim < 0 || state.lastVisibleFrame < textures[victim].lastVisibleFrame)
+				{
+					victim = static_cast<int>(i);
+				}
+			}
+			return victim;
+		}
+	};
+
+	//copies level data out of the memory mapped files on a background thread
+	//the first touch of a mapped page is what actually reads the disk, so this keeps the reads off the render thread
+	class Loader
+	{
+	public:
+		struct Job
+		{
+			uint32_t texture;
+			uint32_t level;
+			const uint8_t* source;
+			size_t size;
+			void* destination;	//usually a persistently mapped staging buffer
+		};
+
+		Loader() : worker([this]() { workerLoop(); }) {}
+
+		~Loader()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			condition.notify_all();
+			worker.join();
+		}
+
+		Loader(const Loader&) = delete;
+		Loader& operator=(const Loader&) = delete;
+
+		void submit(const Job& job)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queued.push_back(job);
+			}
+			condition.notify_all();
+		}
+
+		//non blocking, returns false when nothing has finished since the last call
+		bool pollFinished(Job& job)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (finished.empty()) return false;
+
+			job = finished.front();
+			finished.pop_front();
+			return true;
+		}
+
+		//blocks until every submitted job is in the finished list
+		void waitIdle()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return queued.empty() && !busy; });
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Job> queued;
+		std::deque<Job> finished;
+		bool busy = false;
+		bool stopping = false;
+		std::thread worker;
+
+		void workerLoop()
+		{
+			for (;;)
+			{
+				Job job;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					condition.wait(lock, [this]() { return stopping || !queued.empty(); });
+					if (stopping) return;
+
+					job = queued.front();
+					queued.pop_front();
+					busy = true;
+				}
+
+				memcpy(job.destination, job.source, job.size);
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					finished.push_back(job);
+					busy = false;
+				}
+				condition.notify_all();
+			}
+		}
+	};
+}
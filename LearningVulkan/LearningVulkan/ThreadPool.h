@@ -0,0 +1,604 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <future>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+
+//a deque only its owner pushes to and pops from, at the bottom, while any thread can steal from the top
+	//Chase and Lev's "Dynamic Circular Work-Stealing Deque", with the memory orders from
+	//Le et al's "Correct and Efficient Work-Stealing for Weak Memory Models"
+//it doubles when full, the arrays it outgrows are kept until it's destroyed since a thief can still be reading one
+template<typename T>
+class WorkStealingDeque
+{
+public:
+	explicit WorkStealingDeque(int64_t capacity = 256)
+	{
+		arrays.emplace_back(new Array(capacity));
+		array.store(arrays.back().get(), std::memory_order_relaxed);
+	}
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	//owner only
+	void push(T item)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		Array* a = array.load(std::memory_order_relaxed);
+		if (b - t > a->capacity - 1)
+		{
+			a = grow(a, t, b);
+		}
+		a->put(b, item);
+		//release, so a thief that sees the new bottom sees the item too
+		bottom.store(b + 1, std::memory_order_release);
+	}
+
+	//owner only, the newest item, false when it's empty
+	bool pop(T& item)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		Array* a = array.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		item = a->get(b);
+		if (t == b)
+		{
+			//the last item, a thief could be taking it at the same time
+			bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	//any thread, the oldest item, false when it's empty or another thread took it first
+	bool steal(T& item)
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b) return false;
+
+		Array* a = array.load(std::memory_order_acquire);
+		item = a->get(t);
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+private:
+	struct Array
+	{
+		int64_t capacity;
+		std::unique_ptr<std::atomic<T>[]> items;
+
+		explicit Array(int64_t capacity) : capacity(capacity), items(new std::atomic<T>[capacity]) {}
+
+		//capacity is always a power of two, indices only ever go up
+		T get(int64_t i) const { return items[i & (capacity - 1)].load(std::memory_order_relaxed); }
+		void put(int64_t i, T item) { items[i & (capacity - 1)].store(item, std::memory_order_relaxed); }
+	};
+
+	//top is written by thieves and bottom by the owner, so they're kept on separate cache lines
+	std::atomic<int64_t> top{ 0 };
+	char topPadding[64];
+	std::atomic<int64_t> bottom{ 0 };
+	char bottomPadding[64];
+	std::atomic<Array*> array;
+	std::vector<std::unique_ptr<Array>> arrays;	//owner only
+
+	Array* grow(Array* old, int64_t t, int64_t b)
+	{
+		arrays.emplace_back(new Array(old->capacity * 2));
+		Array* a = arrays.back().get();
+		for (int64_t i = t; i < b; i++)
+		{
+			a->put(i, old->get(i));
+		}
+		array.store(a, std::memory_order_release);
+		return a;
+	}
+};
+
+//a fixed size pool of worker threads that steal work from each other
+	//each worker has its own WorkStealingDeque, tasks submitted from a worker go on its deque and it runs the newest first
+	//tasks submitted from any other thread go on a shared queue, which idle workers check before they steal
+	//workers with nothing to run or steal sleep until something is submitted
+//a thread that waits on a Counter runs tasks until it's done, so tasks can split themselves up and wait on the pieces
+class ThreadPool
+{
+public:
+	//how many tasks submitted with it haven't finished yet
+	class Counter
+	{
+	public:
+		Counter() = default;
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool isDone() const { return remaining.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class ThreadPool;
+		std::atomic<uint32_t> remaining{ 0 };
+		std::mutex failureMutex;
+		std::exception_ptr failure;	//the first exception one of its tasks threw
+	};
+
+	//by default leave one hardware thread for the main thread
+		//hardware_concurrency is 0 when it isn't known, which still gets one worker
+	explicit ThreadPool(unsigned int threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1)
+	{
+		//every deque has to be there before a worker starts stealing from them
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			queues.emplace_back(new WorkStealingDeque<Task*>());
+		}
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back([this, i]() { workerLoop(i); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		sleepCondition.notify_all();
+
+		//the workers finish whatever is still queued before they stop
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t size() const { return workers.size(); }
+
+	//tasks that were taken from another worker's deque, since the pool was made
+	uint64_t getStealCount() const { return stealCount.load(std::memory_order_relaxed); }
+
+	//queue up a callable and get a future for its result
+	//exceptions thrown by the task are rethrown from future.get()
+		//get() only blocks, a task that has to wait on others should use a Counter instead
+	template<typename F>
+	auto submit(F&& task) -> std::future<typename std::result_of<F()>::type>
+	{
+		using Result = typename std::result_of<F()>::type;
+
+		//packaged_task is move only, but std::function needs to be copyable, so we keep it in a shared_ptr
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+		std::future<Result> result = packaged->get_future();
+
+		enqueue(new Task([packaged]() { (*packaged)(); }));
+
+		return result;
+	}
+
+	//queue up a callable that counter counts until it has run
+	//the first exception a counter's tasks throw is rethrown from wait
+	template<typename F>
+	void submit(Counter& counter, F&& task)
+	{
+		counter.remaining.fetch_add(1, std::memory_order_relaxed);
+
+		Counter* target = &counter;
+		enqueue(new Task([target, task]() {
+			try
+			{
+				task();
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(target->failureMutex);
+				if (!target->failure) target->failure = std::current_exception();
+			}
+			target->remaining.fetch_sub(1, std::memory_order_release);
+		}));
+	}
+
+	//runs queued tasks on the calling thread until every task counted by counter has finished
+		//fine to call from a task on the pool, the worker keeps working instead of blocking
+	void wait(Counter& counter)
+	{
+		size_t worker = currentWorker();
+		while (!counter.isDone())
+		{
+			Task* task = findTask(worker);
+			if (task != nullptr)
+			{
+				run(task);
+			}
+			else
+			{
+				//what's left is running on other threads
+				std::this_thread::yield();
+			}
+		}
+
+		std::exception_ptr failure;
+		{
+			std::lock_guard<std::mutex> lock(counter.failureMutex);
+			std::swap(failure, counter.failure);
+		}
+		if (failure)
+		{
+			std::rethrow_exception(failure);
+		}
+	}
+
+	//runs function(chunk, first, last) over [0, count) in chunkCount pieces, returns once they're all done
+		//the calling thread runs pieces too, chunks that would be empty are skipped
+	template<typename F>
+	void parallelFor(uint32_t count, uint32_t chunkCount, F function)
+	{
+		if (size() == 0 || chunkCount <= 1)
+		{
+			function(0, 0, count);
+			return;
+		}
+
+		uint32_t perChunk = (count + chunkCount - 1) / chunkCount;
+
+		Counter counter;
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			uint32_t first = std::min(count, chunk * perChunk);
+			uint32_t last = std::min(count, first + perChunk);
+			if (first == last) break;
+
+			submit(counter, [&function, chunk, first, last]() { function(chunk, first, last); });
+		}
+		wait(counter);
+	}
+
+private:
+	typedef std::function<void()> Task;
+
+	//which pool and worker the current thread is, if it's a worker
+	struct ThreadContext
+	{
+		const ThreadPool* pool = nullptr;
+		size_t worker = 0;
+		uint32_t random = 0x9e3779b9;	//where to start looking for work to steal
+	};
+
+	enum : size_t
+	{
+		NO_WORKER = ~size_t(0)
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkStealingDeque<Task*>>> queues;	//one per worker
+
+	//from threads that aren't workers
+	std::deque<Task*> sharedQueue;
+	std::mutex sharedMutex;
+	std::atomic<size_t> sharedCount{ 0 };
+
+	//submitted and not taken off a queue yet, workers only sleep while it's 0
+	std::atomic<int64_t> queuedCount{ 0 };
+	std::atomic<uint32_t> sleepingCount{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	bool stopping = false;
+
+	std::atomic<uint64_t> stealCount{ 0 };
+
+	static ThreadContext& threadContext()
+	{
+		static thread_local ThreadContext context;
+		return context;
+	}
+
+	size_t currentWorker() const
+	{
+		const ThreadContext& context = threadContext();
+		return context.pool == this ? context.worker : NO_WORKER;
+	}
+
+	void enqueue(Task* task)
+	{
+		//counted first, so it's never below 0 when a worker takes the task straight away
+		queuedCount.fetch_add(1, std::memory_order_seq_cst);
+
+		size_t worker = currentWorker();
+		if (worker != NO_WORKER)
+		{
+			queues[worker]->push(task);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(sharedMutex);
+			sharedQueue.push_back(task);
+			sharedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		//taking the lock means a worker that's about to sleep either sees queuedCount or is already waiting to be woken
+		if (sleepingCount.load(std::memory_order_seq_cst) > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+			}
+			sleepCondition.notify_one();
+		}
+	}
+
+	//worker is NO_WORKER for threads that aren't workers, they only take from the shared queue and steal
+	Task* findTask(size_t worker)
+	{
+		Task* task = nullptr;
+		if (worker != NO_WORKER && queues[worker]->pop(task))
+		{
+			return take(task);
+		}
+
+		if (sharedCount.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> lock(sharedMutex);
+			if (!sharedQueue.empty())
+			{
+				task = sharedQueue.front();
+				sharedQueue.pop_front();
+				sharedCount.fetch_sub(1, std::memory_order_relaxed);
+				return take(task);
+			}
+		}
+
+		//each thread starts from a different victim, so thieves don't all pile onto the same deque
+		ThreadContext& context = threadContext();
+		context.random ^= context.random << 13;
+		context.random ^= context.random >> 17;
+		context.random ^= context.random << 5;
+		size_t start = context.random % queues.size();
+		for (size_t i = 0; i < queues.size(); i++)
+		{
+			size_t victim = (start + i) % queues.size();
+			if (victim != worker && queues[victim]->steal(task))
+			{
+				stealCount.fetch_add(1, std::memory_order_relaxed);
+				return take(task);
+			}
+		}
+		return nullptr;
+	}
+
+	Task* take(Task* task)
+	{
+		queuedCount.fetch_sub(1, std::memory_order_relaxed);
+		return task;
+	}
+
+	void run(Task* task)
+	{
+		std::unique_ptr<Task> owned(task);
+		(*owned)();
+	}
+
+	void workerLoop(size_t index)
+	{
+		ThreadContext& context = threadContext();
+		context.pool = this;
+		context.worker = index;
+		context.random += static_cast<uint32_t>(index) * 0x45d9f3b;
+
+		for (;;)
+		{
+			Task* task = findTask(index);
+			if (task != nullptr)
+			{
+				run(task);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			//finish whatever is still queued before shutting down
+			if (stopping && queuedCount.load() == 0) return;
+
+			sleepingCount++;
+			sleepCondition.wait(lock, [this]() { return stopping || queuedCount.load() > 0; });
+			sleepingCount--;
+		}
+	}
+};
+
+//a set of tasks with dependencies between them
+//a task is started as soon as everything it depends on has finished
+	//worker tasks go to the thread pool
+	//main thread tasks run on the thread that calls run(), in the order they become ready
+		//use these for anything that isn't thread safe (queue submission, command pool use, GLFW calls)
+class TaskGraph
+{
+public:
+	typedef size_t TaskId;
+
+	TaskId addTask(std::function<void()> function, std::vector<TaskId> dependencies = {}, bool mainThread = false)
+	{
+		TaskId id = nodes.size();
+
+		Node node;
+		node.function = std::move(function);
+		node.mainThread = mainThread;
+		node.remainingDependencies = dependencies.size();
+		nodes.push_back(std::move(node));
+
+		for (TaskId dependency : dependencies)
+		{
+			nodes[dependency].dependents.push_back(id);
+		}
+
+		return id;
+	}
+
+	TaskId addMainThreadTask(std::function<void()> function, std::vector<TaskId> dependencies = {})
+	{
+		return addTask(std::move(function), std::move(dependencies), true);
+	}
+
+	//runs every task, blocking until the whole graph is done
+	//a graph can only be run once since dependency counts are consumed as tasks finish
+	//if a task throws, nothing new is started and the first exception is rethrown once running tasks finish
+	void run(ThreadPool& pool)
+	{
+		std::unique_lock<std::mutex> lock(graphMutex);
+
+		runningCount = 0;
+		failure = nullptr;
+
+		for (TaskId i = 0; i < nodes.size(); i++)
+		{
+			if (nodes[i].remainingDependencies == 0)
+			{
+				schedule(pool, i);
+			}
+		}
+
+		for (;;)
+		{
+			graphCondition.wait(lock, [this]() {
+				return !readyMainThreadTasks.empty() || runningCount == 0;
+			});
+
+			if (!readyMainThreadTasks.empty())
+			{
+				//a task failed, so drop anything that hasn't started yet
+				if (failure)
+				{
+					runningCount -= readyMainThreadTasks.size();
+					readyMainThreadTasks.clear();
+					continue;
+				}
+
+				TaskId id = readyMainThreadTasks.front();
+				readyMainThreadTasks.pop_front();
+
+				lock.unlock();
+				execute(pool, id);
+				lock.lock();
+				continue;
+			}
+
+			if (runningCount == 0) break;
+		}
+
+		if (failure)
+		{
+			std::rethrow_exception(failure);
+		}
+	}
+
+	//runs every task on the calling thread in a valid dependency order
+	//useful to compare against run() or to debug ordering problems
+	void runSerial()
+	{
+		std::vector<size_t> remaining(nodes.size());
+		std::deque<TaskId> ready;
+		for (TaskId i = 0; i < nodes.size(); i++)
+		{
+			remaining[i] = nodes[i].remainingDependencies;
+			if (remaining[i] == 0) ready.push_back(i);
+		}
+
+		while (!ready.empty())
+		{
+			TaskId id = ready.front();
+			ready.pop_front();
+
+			nodes[id].function();
+
+			for (TaskId dependent : nodes[id].dependents)
+			{
+				if (--remaining[dependent] == 0) ready.push_back(dependent);
+			}
+		}
+	}
+
+private:
+	struct Node
+	{
+		std::function<void()> function;
+		std::vector<TaskId> dependents;
+		size_t remainingDependencies = 0;
+		bool mainThread = false;
+	};
+
+	std::vector<Node> nodes;
+	std::deque<TaskId> readyMainThreadTasks;
+	std::mutex graphMutex;
+	std::condition_variable graphCondition;
+	size_t runningCount = 0;
+	std::exception_ptr failure;
+
+	//graphMutex must be held
+	void schedule(ThreadPool& pool, TaskId id)
+	{
+		runningCount++;
+
+		if (nodes[id].mainThread)
+		{
+			readyMainThreadTasks.push_back(id);
+			graphCondition.notify_all();
+		}
+		else
+		{
+			pool.submit([this, &pool, id]() { execute(pool, id); });
+		}
+	}
+
+	void execute(ThreadPool& pool, TaskId id)
+	{
+		std::exception_ptr error;
+		try
+		{
+			nodes[id].function();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(graphMutex);
+
+		if (error && !failure)
+		{
+			failure = error;
+		}
+
+		if (!failure)
+		{
+			for (TaskId dependent : nodes[id].dependents)
+			{
+				if (--nodes[dependent].remainingDependencies == 0)
+				{
+					schedule(pool, dependent);
+				}
+			}
+		}
+
+		runningCount--;
+		graphCondition.notify_all();
+	}
+};
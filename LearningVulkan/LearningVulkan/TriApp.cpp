@@ -15,6 +15,24 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include "ThreadPool.h"
+#include "TextureFile.h"
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+#include "Downsampler.h"
+#include "TextureStreaming.h"
+#include "BindlessTextures.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorTemplate.h"
+#include "GpuCulling.h"
+#include "SoftwareOcclusion.h"
+#include "SceneBvh.h"
+#include "RenderGraph.h"
+#include "BarrierTracker.h"
+#include "SubmitScheduler.h"
+#include "FramePacer.h"
+#include "TripleBuffer.h"
+
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
@@ -25,6 +43,12 @@
 #include <array>
 #include <chrono>
 #include <unordered_map>
+#include <random>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define THROW(x) { throw std::runtime_error(x); }
 
@@ -89,6 +113,45 @@ namespace std {
 	};
 }
 
+//per instance vertex data, every copy of a mesh in the scene is one of these in the instance buffer
+struct InstanceData
+{
+	glm::mat4 model;
+	uint32_t materialIndex;	//slot in the bindless texture array
+	uint32_t padding[3];	//keeps the stride a multiple of 16
+
+	//binding 1 steps once per instance instead of once per vertex
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 1;
+		bindingDescription.stride = sizeof(InstanceData);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return bindingDescription;
+	}
+
+	//a mat4 attribute takes 4 locations, one per column
+	static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions = {};
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			attributeDescriptions[i].binding = 1;
+			attributeDescriptions[i].location = 3 + i;
+			attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			attributeDescriptions[i].offset = static_cast<uint32_t>(offsetof(InstanceData, model) + sizeof(glm::vec4) * i);
+		}
+
+		attributeDescriptions[4].binding = 1;
+		attributeDescriptions[4].location = 7;
+		attributeDescriptions[4].format = VK_FORMAT_R32_UINT;
+		attributeDescriptions[4].offset = offsetof(InstanceData, materialIndex);
+
+		return attributeDescriptions;
+	}
+};
+
 //we will be compiling glsl into SPIR-V with
 	//glslangValidator.exe
 
@@ -100,12 +163,85 @@ public:
 
 	const std::string MODEL_PATH = "models/chalet.obj";
 	const std::string TEXTURE_PATH = "textures/chalet.jpg";
+	//made from TEXTURE_PATH by running with --bake
+	//one file per format, createTextureImage picks the best one the device can sample
+	const std::string BAKED_TEXTURE_BASE = "textures/chalet";
+	const std::vector<VkFormat> BAKED_TEXTURE_FORMATS = {
+		VK_FORMAT_BC7_UNORM_BLOCK,
+		VK_FORMAT_BC3_UNORM_BLOCK,
+		VK_FORMAT_BC1_RGB_UNORM_BLOCK,
+		VK_FORMAT_R8G8B8A8_UNORM
+	};
+	//baked textures are streamed: only levels of STREAMING_TAIL_SIZE and smaller are uploaded before the first frame
+	//set streamTextures to false to upload every level up front instead
+	const bool streamTextures = true;
+	const uint32_t STREAMING_TAIL_SIZE = 128;
+	//GPU memory the streamed textures can use between them, least recently seen textures lose levels first
+	const uint64_t TEXTURE_BUDGET = 256ull * 1024 * 1024;
+	//copies of the model placed in a square grid, all drawn with one instanced draw
+	const uint32_t SCENE_INSTANCE_COUNT = 1;
+	//CPU occlusion culling, used when culling isn't done on the GPU
+		//the SOFTWARE_OCCLUDER_COUNT nearest instances are drawn as occluders, with the model simplified on an OCCLUDER_GRID_SIZE^3 grid
+	const uint32_t SOFTWARE_OCCLUSION_WIDTH = 320;
+	const uint32_t SOFTWARE_OCCLUSION_HEIGHT = 192;
+	const uint32_t SOFTWARE_OCCLUDER_COUNT = 16;
+	const uint32_t OCCLUDER_GRID_SIZE = 32;
+	//present mode, swap chain size, frame rate limit and how many frames can be queued on the GPU, main sets them from the command line
+		//the defaults are what it did before there was a pacer: mailbox if it can, one more image than the minimum, no limit
+	FramePacer::Settings pacing;
+	//only draw when the frame would look different from the last one, in between the loop sleeps in glfwWaitEvents
+		//main sets it with --on-demand, the model's spin is a change every frame so space pauses it
+	bool renderOnDemand = false;
+	bool spinModel = true;
+	//the simulation steps this many times a second on its own thread, whatever rate the frames are drawn at
+	const uint32_t SIMULATION_RATE = 60;
 
 	void run()
 	{
 		initWindow();
 		initVulkan();
-		mainLoop();
+
+		startSimulation();
+		try
+		{
+			mainLoop();
+		}
+		catch (...)
+		{
+			endSimulation();
+			throw;
+		}
+		endSimulation();
+
+		cleanup();
+	}
+
+	//offline import step, doesn't need a window or a device
+	void bakeAssets(BlockCompression::Quality quality, MipGenerator::Filter mipFilter)
+	{
+		bakeTexture(TEXTURE_PATH, BAKED_TEXTURE_BASE, quality, mipFilter);
+	}
+
+	//CPU side benchmarks, don't need a window or a device either
+	void runBenchmarks()
+	{
+		benchmarkBlockCompression();
+		benchmarkMipGeneration();
+		benchmarkSoftwareOcclusion();
+		benchmarkSceneCulling();
+		benchmarkTaskSystem();
+	}
+
+	//benchmarks that need a device, they run on whichever GPU pickPhysicalDevice chooses
+	void runGpuBenchmarks()
+	{
+		initWindow();
+		initVulkan();
+		benchmarkMipGenerationGpu();
+		benchmarkDescriptorAllocation();
+		benchmarkDescriptorUpdates();
+		benchmarkInstancing();
+		benchmarkAsyncCompute();
 		cleanup();
 	}
 
@@ -117,6 +253,18 @@ private:
 	VkDevice device;
 	VkQueue graphicsQueue;	//the queue used for drawing the graphics
 	VkQueue presentQueue;	//the queue used to present images
+	VkQueue transferQueue = VK_NULL_HANDLE;	//the queue streamed textures are copied on, only if useTransferQueue is set
+	VkQueue computeQueue = VK_NULL_HANDLE;	//the queue culling can be dispatched on, see useAsyncCompute
+	uint32_t graphicsQueueFamily = 0;
+	uint32_t transferQueueFamily = 0;
+	uint32_t computeQueueFamily = 0;
+	//every submission goes through it, the ids are what addQueue gave back for the queues above
+	SubmitScheduler scheduler;
+	uint32_t graphicsSubmitQueue = 0;
+	uint32_t transferSubmitQueue = 0;
+	uint32_t computeSubmitQueue = 0;
+	//made from pacing once the device exists
+	FramePacer pacer;
 	VkDebugReportCallbackEXT callback;	//the callback function to access details about errors
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapChain;	//the swap chain
@@ -125,34 +273,121 @@ private:
 	std::vector<VkImageView> swapChainImageViews;	//the image views for the images in the swap chain
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
+	//the draw pass's render pass, made by frameGraph, the pipeline is created against it
 	VkRenderPass renderPass;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline graphicsPipeline;
-	std::vector<VkFramebuffer> swapChainFramebuffers;
 	VkCommandPool commandPool;
-	std::vector<VkCommandBuffer> commandBuffers;
-	VkSemaphore imageAvailableSemaphore;
-	VkSemaphore renderFinishedSemaphore;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+	VkCommandPool computeCommandPool = VK_NULL_HANDLE;
 	VkBuffer vertexBuffer;
 	VkDeviceMemory vertexBufferMemory;
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
-	VkBuffer uniformBuffer;
-	VkDeviceMemory uniformBufferMemory;
-	VkDescriptorPool descriptorPool;
-	VkDescriptorSet descriptorSet;
+	//device local, filled from sceneInstances by uploadSceneInstances
+	VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory instanceBufferMemory = VK_NULL_HANDLE;
+	//sceneObjects for the cull shader, same capacity as the instance buffer
+	VkBuffer objectBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory objectBufferMemory = VK_NULL_HANDLE;
+	//whether each object was visible at the end of last frame, written by the late occlusion phase
+	VkBuffer visibilityBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory visibilityBufferMemory = VK_NULL_HANDLE;
+	size_t instanceBufferCapacity = 0;
 	uint32_t mipLevels;
-	VkImage textureImage;
-	VkImageView textureImageView;
+	VkFormat textureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	//stay null when the texture is streamed, see streamedTextures
+	VkImage textureImage = VK_NULL_HANDLE;
+	VkImageView textureImageView = VK_NULL_HANDLE;
 	VkSampler textureSampler;
-	VkDeviceMemory textureImageMemory;
-	VkImage depthImage;
-	VkDeviceMemory depthImageMemory;
-	VkImageView depthImageView;
+	VkDeviceMemory textureImageMemory = VK_NULL_HANDLE;
+	//the depth buffer and the depth pyramid are transient images in frameGraph
+	//the pyramid is a max reduced copy of the depth buffer at half its size, rebuilt every frame after the early draws
+		//padded up to a power of two by sizeDepthPyramid
+	Downsampler::Target depthPyramidTarget;
+	VkExtent2D depthPyramidExtent = {};
+	uint32_t depthPyramidShift = 0;
+	uint32_t depthPyramidLevels = 0;
 	
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	//the scene list, one entry per copy of the model
+	std::vector<InstanceData> sceneInstances;
+	//bounds and draw of each sceneInstances entry, what the cull shader works from
+	std::vector<GpuCulling::Object> sceneObjects;
+
+	//filled in by worker threads during initVulkan
+	stbi_uc* texturePixels = nullptr;
+	//one entry per BAKED_TEXTURE_FORMATS, null if that variant wasn't baked
+	std::vector<std::unique_ptr<TextureFile::Reader>> bakedTextures;
+	int texWidth, texHeight;
+	std::vector<char> vertShaderCode;
+	std::vector<char> fragShaderCode;
+	//empty if the compute shaders haven't been compiled, the blit path is used instead
+	std::vector<char> downsampleShaderCode;
+	std::vector<char> downsampleDepthShaderCode;
+	//fragment shader for the bindless path, empty if it hasn't been compiled
+	std::vector<char> bindlessFragShaderCode;
+	//compute shader for GPU culling, empty if it hasn't been compiled
+	std::vector<char> cullShaderCode;
+	std::vector<char> cullOcclusionShaderCode;
+
+	ThreadPool threadPool;
+	Downsampler downsampler;
+	//layouts and pending work of the textures, the upload and streaming code records its barriers through it
+	BarrierTracker barrierTracker;
+	//every texture in one descriptor set, used instead of the model set's combined image sampler when useBindless is set
+	BindlessTextures bindlessTextures;
+	//turns sceneObjects into indirect draws on the GPU when useGpuCulling is set
+	GpuCulling gpuCulling;
+	//sceneInstances' world space bounds, frustum culled on the CPU when GPU culling isn't used
+	SceneBvh sceneBvh;
+	std::vector<uint32_t> visibleInstances;
+	//draws occluderMesh for the nearest instances when useSoftwareOcclusion is set
+	SoftwareOcclusion softwareOcclusion;
+	SoftwareOcclusion::Mesh occluderMesh;
+	//runs of consecutive instances that passed the software occlusion test, each one is drawn with one instanced draw
+	struct InstanceRun
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+	std::vector<InstanceRun> visibleInstanceRuns;
+	uint32_t modelTextureIndex = BindlessTextures::INVALID_INDEX;
+
+	//a texture whose finer levels are loaded while rendering, see TextureStreaming.h
+	struct StreamedTexture
+	{
+		std::unique_ptr<TextureFile::Reader> file;	//stays mapped, levels are read out of it as they are needed
+		VkFormat format;
+		uint32_t residentLevel = 0;	//the image holds levels [residentLevel, mipLevels) of the file
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		//being filled by the loader thread while a load is in flight
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+	};
+	//index 0 is the texture the model is drawn with
+	std::vector<StreamedTexture> streamedTextures;
+	TextureStreaming::Scheduler textureScheduler{ TEXTURE_BUDGET };
+	TextureStreaming::Loader textureLoader;
+	uint64_t frameNumber = 0;
+
+	//a streaming change being copied on transferQueue, see submitStreamingUpload
+	struct StreamingUpload
+	{
+		uint32_t texture;
+		uint32_t level;	//the new resident level
+		VkImage image;
+		VkDeviceMemory imageMemory;
+		VkCommandBuffer commandBuffer;
+		VkSemaphore semaphore;	//signaled after the release, the frame that acquires the image waits on it
+		SubmitScheduler::Ticket ticket;	//polled to find out when the copy is done
+	};
+	std::vector<StreamingUpload> streamingUploads;	//still copying
+	std::vector<StreamingUpload> streamingAcquires;	//copied, the next frame drawn acquires them
 
 	//old vertex and index data
 	/*const std::vector<Vertex> vertices = {
@@ -187,10 +422,112 @@ private:
 	const bool enableValidationLayers = true;
 #endif
 
+	//set to false to run initVulkan's task graph on the main thread, for comparing startup times
+	const bool parallelInit = true;
+
+	//how many frames the CPU can get ahead of the GPU, everything a frame writes to has one copy per frame in flight
+	static const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+	struct FrameData
+	{
+		//recorded again every frame, so per draw data can go in push constants
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+		VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
+		//the frame's submission, once it's done anything the frame used can be reused
+		SubmitScheduler::Ticket ticket;
+		//the model set for this frame's uniform buffer, out of descriptorCache
+			//looked up again by updateModelDescriptorSet when the texture view it points at changes
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkImageView descriptorSetView = VK_NULL_HANDLE;
+		//the frame's UniformBufferObject, persistently mapped
+		VkBuffer uniformBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory uniformBufferMemory = VK_NULL_HANDLE;
+		void* uniformBufferMapped = nullptr;
+		//the indirect draws the cull shader writes for this frame
+			//with occlusion culling cullTarget is the early phase and lateCullTarget the late one
+		GpuCulling::Target cullTarget;
+		GpuCulling::Target lateCullTarget;
+		//the cull dispatch when useAsyncCompute is set, commandBuffer waits on cullFinishedSemaphore before its draws
+			//ticket covers it too, since the draws can't finish before it does
+			//with occlusion culling it's only the early phase
+		VkCommandBuffer computeCommandBuffer = VK_NULL_HANDLE;
+		VkSemaphore cullFinishedSemaphore = VK_NULL_HANDLE;
+		//the late draws, submitted after commandBuffer when the frame is split, see splitsFrame
+		VkCommandBuffer lateCommandBuffer = VK_NULL_HANDLE;
+	};
+	std::array<FrameData, MAX_FRAMES_IN_FLIGHT> frames;
+	uint32_t currentFrame = 0;
+
+	//draw with textures picked by index out of one bindless array instead of one descriptor set per texture
+	//only used if the device supports VK_EXT_descriptor_indexing and shaders/bindless_frag.spv exists, createLogicalDevice decides
+	const bool preferBindless = true;
+	bool useBindless = false;
+
+	//track submissions with one VK_KHR_timeline_semaphore per queue instead of a fence per submission
+	//only used if the device supports it, createLogicalDevice decides
+	const bool preferTimelineSemaphores = true;
+	bool useTimelineSemaphores = false;
+
+	//measure frame latency up to when the image is presented with VK_KHR_present_wait, instead of up to when the GPU finishes it
+	//only used if the device supports it, createLogicalDevice decides
+	const bool preferPresentWait = true;
+	bool usePresentWait = false;
+
+	//record barriers with VK_KHR_synchronization2, so each barrier in a batch only waits on its own stages
+	//only used if the device supports it, createLogicalDevice decides
+	const bool preferSynchronization2 = true;
+	bool useSynchronization2 = false;
+
+	//copy streamed texture levels on a queue family without graphics, so the copies run alongside the frames
+	//only used if the device has one, createLogicalDevice decides, otherwise they go on graphicsQueue and wait for it to idle
+	const bool preferTransferQueue = true;
+	bool useTransferQueue = false;
+
+	//dispatch the frame's culling on a queue family without graphics, so it runs alongside the previous frame's draws
+	//only used if the device has one and culls on the GPU, createLogicalDevice decides
+		//with occlusion only the early phase moves, the pyramid and the late phase read this frame's depth so they stay on graphicsQueue
+		//it waits on the last frame's late phase with a timeline semaphore, so occlusion needs those as well
+	const bool preferAsyncCompute = true;
+	bool useAsyncCompute = false;
+	//the submission of the last frame's late cull, what the next early phase on computeQueue waits on
+	SubmitScheduler::Ticket visibilityWritten;
+
+	//cull on the GPU and draw with indirect draws instead of drawing every instance
+	//only used if the device has the features GpuCulling needs and shaders/cull.spv exists, createLogicalDevice decides
+	const bool preferGpuCulling = true;
+	bool useGpuCulling = false;
+	bool useDrawIndirectCount = false;
+
+	//two phase occlusion culling against a depth pyramid, on top of GPU culling
+	//needs shaders/cull_occlusion.spv, shaders/downsample_depth.spv and a depth format that can be sampled
+	const bool preferOcclusionCulling = true;
+	bool useOcclusionCulling = false;
+
+	//test every instance's bounds against a small depth buffer drawn on the CPU before recording the draws
+	//only used when GPU culling isn't, see SoftwareOcclusion.h
+	const bool preferSoftwareOcclusion = true;
+	bool useSoftwareOcclusion = false;
+
+	//how createTextureImage fills in the mip chain when the texture isn't baked
+		//Blit - vkCmdBlitImage level by level, 2 barriers per level
+		//Compute - the single pass downsampler, one dispatch and 2 barriers in total
+		//Cpu - MipGenerator on the thread pool, then one copy
+	//if the chosen mode isn't supported by the device it falls back to one that is
+	enum class MipGenMode
+	{
+		Blit,
+		Compute,
+		Cpu
+	};
+	const MipGenMode mipGenMode = MipGenMode::Compute;
+
 	struct QueueFamilyIndices
 	{
 		int graphicsFamily = -1;
 		int presentFamily = -1;
+		int transferFamily = -1;	//optional, a family without graphics that can copy
+		int computeFamily = -1;	//optional, a family without graphics that can dispatch
 
 		bool isComplete()
 		{
@@ -205,13 +542,85 @@ private:
 		std::vector<VkPresentModeKHR> presentModes;
 	};
 
+	//per frame data shared by every draw, one buffer per frame in flight
+		//viewProj is proj * view done once per frame on the CPU, the vertex shader takes each draw's model matrix to clip space with it
 	struct UniformBufferObject
+	{
+		glm::mat4 viewProj;
+	};
+
+	//per draw data, pushed with vkCmdPushConstants for each draw
+		//each instance's own transform is applied before model, and its material comes from the instance buffer
+	struct DrawConstants
 	{
 		glm::mat4 model;
-		glm::mat4 view;
-		glm::mat4 proj;
 	};
 
+	//everything the model's descriptor set points at, packed the way modelSetDescription says
+	struct ModelDescriptors
+	{
+		VkDescriptorBufferInfo uniformBuffer;
+		VkDescriptorImageInfo texture;	//unused with bindless textures
+	};
+	DescriptorSetDescription modelSetDescription;
+	//long lived sets, they come out of descriptorCache so identical ones are only made once
+	DescriptorAllocator descriptorAllocator;
+	DescriptorCache descriptorCache;
+
+	//for the texture streaming screen coverage estimate
+	float modelRadius = 1.0f;
+	//the model's bounding box, what the software occlusion test works from
+	glm::vec3 modelBoundsMin = glm::vec3(0.0f);
+	glm::vec3 modelBoundsMax = glm::vec3(0.0f);
+	UniformBufferObject currentUbo = {};
+	glm::mat4 modelMatrix = glm::mat4(1.0f);
+	//the parts of currentUbo.viewProj, for the texture streaming screen coverage estimate
+	glm::mat4 viewMatrix = glm::mat4(1.0f);
+	glm::mat4 projMatrix = glm::mat4(1.0f);
+
+	//what the simulation works out on each tick, the rest of what a frame is drawn from depends on the window
+	struct SceneState
+	{
+		uint64_t tick = 0;
+		std::chrono::steady_clock::time_point time;	//when the tick is meant to be on screen
+		float spinAngle = 0.0f;	//radians around z, only moves on while spinModel is set
+		glm::vec3 eye = glm::vec3(2.0f, 2.0f, 2.0f);
+		glm::vec3 center = glm::vec3(0.0f, 0.0f, 0.0f);
+	};
+	//the last two ticks, frames are drawn somewhere in between so they move smoothly at any rate
+	struct SceneSnapshot
+	{
+		SceneState previous;
+		SceneState current;
+	};
+	//published by the simulation thread and read by the main thread, neither waits on the other
+	TripleBuffer<SceneSnapshot> sceneSnapshots;
+	std::thread simulationThread;
+	//held by the simulation thread except while it sleeps, spinModel and simulationStopping are only changed under it
+	std::mutex simulationMutex;
+	std::condition_variable simulationWake;
+	bool simulationStopping = false;
+	//what the last frame drawn was made from, renderOnDemand only draws again once these change
+	UniformBufferObject drawnUbo = {};
+	glm::mat4 drawnModelMatrix = glm::mat4(1.0f);
+	//the window was resized or its contents were lost, so the next frame has to be drawn even if nothing changed
+	bool redrawRequested = true;
+
+	//the frame's passes, declared by createFrameGraph and executed by recordCommandBuffer
+	RenderGraph frameGraph;
+	RenderGraph::ResourceId swapChainResource = RenderGraph::INVALID_ID;
+	RenderGraph::ResourceId depthResource = RenderGraph::INVALID_ID;
+	RenderGraph::ResourceId depthPyramidResource = RenderGraph::INVALID_ID;
+	//the cull targets' buffers, [0] is written by the first (or only) cull and [1] by the late one
+	std::array<RenderGraph::ResourceId, 2> drawBufferResources = { RenderGraph::INVALID_ID, RenderGraph::INVALID_ID };
+	std::array<RenderGraph::ResourceId, 2> countBufferResources = { RenderGraph::INVALID_ID, RenderGraph::INVALID_ID };
+	//what the passes record with, set by recordCommandBuffer before it executes frameGraph
+	FrameData* recordingFrame = nullptr;
+	VkDescriptorSet recordingDescriptorSet = VK_NULL_HANDLE;
+	DrawConstants recordingDraw = {};
+	glm::mat4 recordingMvp = glm::mat4(1.0f);	//what the cull passes take the bounds to clip space with
+	bool printedFrameGraphStats = false;
+
 #pragma region Primary functions
 
 	void initWindow()
@@ -228,44 +637,139 @@ private:
 		//allows us to store an arbitrary pointer in the window object
 		glfwSetWindowUserPointer(window, this);
 		glfwSetWindowSizeCallback(window, TriApp::onWindowResized);
+		glfwSetWindowRefreshCallback(window, TriApp::onWindowRefresh);
+		glfwSetKeyCallback(window, TriApp::onKey);
 	}
 
 	void initVulkan()
 	{
-		createInstance();
-		setupDebugCallback();
-		createSurface();
-		pickPhysicalDevice();
-		createLogicalDevice();
-		createSwapChain();
-		createImageViews();
-		createRenderPass();
-		createDescriptorSetLayout();
-		createGraphicsPipeline();
-		createCommandPool();
-		createDepthResources();
-		createFramebuffers();
-		createTextureImage();
-		createTextureImageView();
-		createTextureSampler();
-		loadModel();
-		createVertexBuffer();
-		createIndexBuffer();
-		createUniformBuffer();
-		createDescriptorPool();
-		createDescriptorSet();
-		createCommandBuffers();
-		createSemaphores();
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		//initialization is a dependency graph
+			//decoding the texture, parsing the model and reading shaders don't need vulkan at all
+			//pipeline compilation only needs the render pass (from the frame graph) and descriptor set layout
+			//anything that submits to a queue or uses the command pool has to stay on the main thread
+		TaskGraph graph;
+
+		auto decodeTexture = graph.addTask([this]() { loadTexturePixels(); });
+		auto parseModel = graph.addTask([this]() { loadModel(); });
+		auto readShaders = graph.addTask([this]() { loadShaders(); });
+
+		auto createDevice = graph.addMainThreadTask([this]() {
+			createInstance();
+			setupDebugCallback();
+			createSurface();
+			pickPhysicalDevice();
+			createLogicalDevice();
+			createSwapChain();
+			createImageViews();
+			createFrameGraph();
+			createDescriptorSetLayout();
+		});
+
+		//vkCreateGraphicsPipelines doesn't need external synchronization, so it can run on a worker
+		auto compilePipeline = graph.addTask([this]() { createGraphicsPipeline(); }, { createDevice, readShaders });
+
+		auto createPool = graph.addMainThreadTask([this]() { createCommandPool(); }, { createDevice });
+
+		auto uploadTexture = graph.addMainThreadTask([this]() {
+			//streaming only uploads the mip tail here, the rest comes in while rendering
+			if (!createStreamedTextures())
+			{
+				createTextureImage();
+				createTextureImageView();
+			}
+			createTextureSampler();
+		}, { createPool, decodeTexture, readShaders });
+
+		auto uploadModel = graph.addMainThreadTask([this]() {
+			createVertexBuffer();
+			createIndexBuffer();
+			createUniformBuffer();
+		}, { createPool, parseModel });
+
+		auto createDescriptors = graph.addMainThreadTask([this]() {
+			createDescriptorAllocators();
+			registerBindlessTextures();
+		}, { uploadTexture, uploadModel });
+
+		//the instances need the model's size to be spaced out and its texture's bindless slot
+		auto uploadScene = graph.addMainThreadTask([this]() {
+			createDepthPyramid();
+			buildScene();
+			uploadSceneInstances();
+		}, { createDescriptors });
+
+		graph.addMainThreadTask([this]() {
+			createCommandBuffers();
+			createSyncObjects();
+		}, { uploadScene, compilePipeline });
+
+		if (parallelInit)
+		{
+			graph.run(threadPool);
+		}
+		else
+		{
+			graph.runSerial();
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		std::cout << "initVulkan took "
+			<< std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count()
+			<< " ms (" << (parallelInit ? "parallel" : "serial") << ")" << std::endl;
+		std::cout << "uploads recorded " << barrierTracker.getStats().barrierCount << " barriers in "
+			<< barrierTracker.getStats().batchCount << " batches" << std::endl;
 	}
 
 	void mainLoop()
 	{
+		bool idle = false;
 		while (!glfwWindowShouldClose(window))
 		{
+			if (idle)
+			{
+				//sleeps until there's an event, the timeout is only there so the stats still get printed
+				glfwWaitEventsTimeout(1.0);
+				pacer.pause();
+			}
+
+			//both wait before the input is read, so the frame is made from the newest input there is
+			pacer.waitForFrameStart();
+			waitForQueuedFrames();
 			glfwPollEvents();
 
-			updateUniformBuffer();
-			drawFrame();
+			//minimized, the surface has no extent and there's no swap chain to draw to until it comes back
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			idle = width == 0 || height == 0;
+
+			if (!idle)
+			{
+				updateUniformBuffer();
+				bool streaming = updateTextureStreaming();
+				idle = renderOnDemand && !redrawRequested && !streaming
+					&& memcmp(&currentUbo, &drawnUbo, sizeof(currentUbo)) == 0 && modelMatrix == drawnModelMatrix;
+			}
+
+			if (idle)
+			{
+				//nothing else is going to get submitted to release what's deferred
+				scheduler.collect();
+			}
+			else
+			{
+				redrawRequested = false;
+				drawnUbo = currentUbo;
+				drawnModelMatrix = modelMatrix;
+				drawFrame();
+			}
+
+			if (pacer.getStats().seconds >= 1.0)
+			{
+				printPacingStats();
+				pacer.resetStats();
+			}
 		}
 
 		//idles the program until drawing is done and the semaphores are released
@@ -274,29 +778,55 @@ private:
 
 	void cleanup()
 	{
-		cleanupSwapChain();
+		//everything is done by now, so what cleanupSwapChain hands over is destroyed straight away
+		scheduler.waitAll();
+		cleanupSwapChain(scheduler.last(graphicsSubmitQueue));
+		scheduler.collect();
 
 		vkDestroySampler(device, textureSampler, nullptr);
+		destroyStreamedTextures();
 		vkDestroyImageView(device, textureImageView, nullptr);
+		barrierTracker.untrackImage(textureImage);
 		vkDestroyImage(device, textureImage, nullptr);
 		vkFreeMemory(device, textureImageMemory, nullptr);
 
-		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-
+		descriptorCache.destroy();
+		descriptorAllocator.destroy();
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-		vkDestroyBuffer(device, uniformBuffer, nullptr);
-		vkFreeMemory(device, uniformBufferMemory, nullptr);
-
+		bindlessTextures.destroy();
 		vkDestroyBuffer(device, indexBuffer, nullptr);
 		vkFreeMemory(device, indexBufferMemory, nullptr);
 
+		vkDestroyBuffer(device, instanceBuffer, nullptr);
+		vkFreeMemory(device, instanceBufferMemory, nullptr);
+		vkDestroyBuffer(device, objectBuffer, nullptr);
+		vkFreeMemory(device, objectBufferMemory, nullptr);
+		vkDestroyBuffer(device, visibilityBuffer, nullptr);
+		vkFreeMemory(device, visibilityBufferMemory, nullptr);
+
 		vkDestroyBuffer(device, vertexBuffer, nullptr);
 		vkFreeMemory(device, vertexBufferMemory, nullptr);
 
-		vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-		vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
+		for (FrameData& frame : frames)
+		{
+			vkDestroySemaphore(device, frame.renderFinishedSemaphore, nullptr);
+			vkDestroySemaphore(device, frame.imageAvailableSemaphore, nullptr);
+			vkDestroySemaphore(device, frame.cullFinishedSemaphore, nullptr);
+			//freeing mapped memory unmaps it
+			vkDestroyBuffer(device, frame.uniformBuffer, nullptr);
+			vkFreeMemory(device, frame.uniformBufferMemory, nullptr);
+			gpuCulling.destroyTarget(frame.cullTarget);
+			gpuCulling.destroyTarget(frame.lateCullTarget);
+		}
+
+		downsampler.destroy();
+		gpuCulling.destroy();
+		scheduler.destroy();
+		pacer.destroy();
 
 		vkDestroyCommandPool(device, commandPool, nullptr);
+		vkDestroyCommandPool(device, transferCommandPool, nullptr);
+		vkDestroyCommandPool(device, computeCommandPool, nullptr);
 
 		vkDestroyDevice(device, nullptr);
 
@@ -320,6 +850,27 @@ private:
 		app->recreateSwapChain();
 	}
 
+	//the window system lost what was in the window, like after it was uncovered, with renderOnDemand it has to be drawn again
+	static void onWindowRefresh(GLFWwindow* window)
+	{
+		TriApp* app = reinterpret_cast<TriApp*>(glfwGetWindowUserPointer(window));
+		app->redrawRequested = true;
+	}
+
+	static void onKey(GLFWwindow* window, int key, int scancode, int action, int mods)
+	{
+		TriApp* app = reinterpret_cast<TriApp*>(glfwGetWindowUserPointer(window));
+		if (key == GLFW_KEY_SPACE && action == GLFW_PRESS)
+		{
+			{
+				std::lock_guard<std::mutex> lock(app->simulationMutex);
+				app->spinModel = !app->spinModel;
+			}
+			//it sleeps while there's nothing to step
+			app->simulationWake.notify_all();
+		}
+	}
+
 #pragma endregion
 
 #pragma region Debug Callback Functions
@@ -571,14 +1122,7 @@ private:
 	{
 		//so, for the staging queue you need a queue family that supports transfer ops
 			//any queue family that supports graphics or comput already implicitly support it
-		//we won't make a new queue, but if you want to
-		/*
-		Modify QueueFamilyIndices and findQueueFamilies to explicitly look for a queue family with the VK_QUEUE_TRANSFER bit, but not the VK_QUEUE_GRAPHICS_BIT.
-		Modify createLogicalDevice to request a handle to the transfer queue
-		Create a second command pool for command buffers that are submitted on the transfer queue family
-		Change the sharingMode of resources to be VK_SHARING_MODE_CONCURRENT and specify both the graphics and transfer queue families
-		Submit any transfer commands like vkCmdCopyBuffer (which we'll be using in this chapter) to the transfer queue instead of the graphics queue
-		*/
+		//transferFamily is one that doesn't support graphics, so its copies can run alongside the graphics queue's work
 
 		QueueFamilyIndices indices;
 
@@ -612,6 +1156,25 @@ private:
 			i++;
 		}
 
+		//usually a DMA engine, one without compute is the most dedicated to copying so it's preferred
+		for (uint32_t family = 0; family < queueFamilyCount; family++)
+		{
+			VkQueueFlags flags = queueFamilies[family].queueFlags;
+			if (queueFamilies[family].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) continue;
+
+			if ((flags & VK_QUEUE_COMPUTE_BIT) && indices.computeFamily < 0)
+			{
+				indices.computeFamily = static_cast<int>(family);
+			}
+			if (!(flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT))) continue;
+
+			if (indices.transferFamily < 0
+				|| ((queueFamilies[indices.transferFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT)))
+			{
+				indices.transferFamily = static_cast<int>(family);
+			}
+		}
+
 		return indices;
 	}
 
@@ -659,6 +1222,22 @@ private:
 		return requiredExtensions.empty();
 	}
 
+	//for optional extensions, the required ones are checked by checkDeviceExtensionSupport
+	bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* name)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions)
+		{
+			if (strcmp(extension.extensionName, name) == 0) return true;
+		}
+		return false;
+	}
+
 #pragma endregion
 
 	void createLogicalDevice()
@@ -666,8 +1245,19 @@ private:
 		float queuePriority = 1.0f;
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
+		useTransferQueue = preferTransferQueue && indices.transferFamily >= 0;
+
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+		if (useTransferQueue)
+		{
+			uniqueQueueFamilies.insert(indices.transferFamily);
+		}
+		//the queue is created whenever there is one, benchmarkAsyncCompute switches between it and graphicsQueue
+		if (preferAsyncCompute && indices.computeFamily >= 0)
+		{
+			uniqueQueueFamilies.insert(indices.computeFamily);
+		}
 
 		for (int queueFamily : uniqueQueueFamilies)
 		{
@@ -680,16 +1270,102 @@ private:
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		//needed to sample the BC baked textures, if it's missing createTextureImage falls back to RGBA8
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+
+		useGpuCulling = preferGpuCulling && fileExists("shaders/cull.spv") && GpuCulling::isSupported(supportedFeatures);
+		if (useGpuCulling)
+		{
+			deviceFeatures.multiDrawIndirect = VK_TRUE;
+			deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+
+			//lets the draw count come from the cull shader, without it the culled draws are still issued with no instances
+			useDrawIndirectCount = isDeviceExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			if (useDrawIndirectCount)
+			{
+				enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			}
+
+			useOcclusionCulling = preferOcclusionCulling
+				&& fileExists("shaders/cull_occlusion.spv") && fileExists("shaders/downsample_depth.spv")
+				&& isFormatSupported(findDepthFormat(), VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+		}
+		useSoftwareOcclusion = preferSoftwareOcclusion && !useGpuCulling;
+
+		//extension features have to be chained through VkPhysicalDeviceFeatures2 instead of pEnabledFeatures
+		VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.features = deviceFeatures;
+
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = BindlessTextures::requiredFeatures();
+
+		useBindless = preferBindless && fileExists("shaders/bindless_frag.spv")
+			&& isDeviceExtensionSupported(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+			&& BindlessTextures::isSupported(BindlessTextures::queryFeatures(physicalDevice));
+		if (useBindless)
+		{
+			//its dependency VK_KHR_maintenance3 is core in 1.1, which is what createInstance asks for
+			enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			deviceFeatures2.pNext = &indexingFeatures;
+		}
+
+		VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = BarrierTracker::requiredFeatures();
+
+		useSynchronization2 = preferSynchronization2
+			&& isDeviceExtensionSupported(physicalDevice, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)
+			&& BarrierTracker::isSupported(physicalDevice);
+		if (useSynchronization2)
+		{
+			enabledExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+			synchronization2Features.pNext = deviceFeatures2.pNext;
+			deviceFeatures2.pNext = &synchronization2Features;
+		}
+
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = SubmitScheduler::requiredFeatures();
+
+		useTimelineSemaphores = preferTimelineSemaphores
+			&& isDeviceExtensionSupported(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)
+			&& SubmitScheduler::isSupported(physicalDevice);
+		if (useTimelineSemaphores)
+		{
+			enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineFeatures.pNext = deviceFeatures2.pNext;
+			deviceFeatures2.pNext = &timelineFeatures;
+		}
+
+		useAsyncCompute = preferAsyncCompute && indices.computeFamily >= 0 && useGpuCulling
+			&& (!useOcclusionCulling || useTimelineSemaphores);
+
+		FramePacer::PresentWaitFeatures presentWaitFeatures = FramePacer::requiredFeatures();
+
+		usePresentWait = preferPresentWait
+			&& isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+			&& isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)
+			&& FramePacer::isPresentWaitSupported(physicalDevice);
+		if (usePresentWait)
+		{
+			enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			presentWaitFeatures.presentId.pNext = deviceFeatures2.pNext;
+			presentWaitFeatures.presentWait.pNext = &presentWaitFeatures.presentId;
+			deviceFeatures2.pNext = &presentWaitFeatures.presentWait;
+		}
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = &deviceFeatures2;
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
-		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.pEnabledFeatures = nullptr;	//given by deviceFeatures2 instead
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 		if (enableValidationLayers)
 		{
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -705,8 +1381,51 @@ private:
 			THROW("failed to create logical device!")
 		}
 
+		std::cout << "textures are bound " << (useBindless ? "bindless" : "with one descriptor set each") << std::endl;
+		std::cout << "culling " << (useGpuCulling ? (useDrawIndirectCount ? "on the GPU with a draw count" : "on the GPU")
+			: (useSoftwareOcclusion ? std::string("on the CPU with software occlusion, ") + SoftwareOcclusion::kernelName() : "off"))
+			<< (useOcclusionCulling ? ", with occlusion" : "") << std::endl;
+		std::cout << "barriers are recorded with " << (useSynchronization2 ? "vkCmdPipelineBarrier2KHR" : "vkCmdPipelineBarrier") << std::endl;
+		std::cout << "streamed textures are copied on "
+			<< (useTransferQueue ? "queue family " + std::to_string(indices.transferFamily) : std::string("the graphics queue")) << std::endl;
+		if (useGpuCulling)
+		{
+			std::cout << (useOcclusionCulling ? "early culling is dispatched on " : "culling is dispatched on ")
+				<< (useAsyncCompute ? "queue family " + std::to_string(indices.computeFamily) : std::string("the graphics queue")) << std::endl;
+		}
+
+		std::cout << "submissions are tracked with " << (useTimelineSemaphores ? "timeline semaphores" : "fences") << std::endl;
+
+		barrierTracker.init(device, useSynchronization2);
+		scheduler.init(device, useTimelineSemaphores);
+		pacer.init(device, pacing, MAX_FRAMES_IN_FLIGHT, usePresentWait);
+
+		std::cout << "frame latency is measured up to " << (usePresentWait ? "the present" : "the GPU finishing the frame")
+			<< ", at most " << pacer.getSettings().maxQueuedFrames << " frames are queued" << std::endl;
+
 		vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
 		vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+		graphicsQueueFamily = static_cast<uint32_t>(indices.graphicsFamily);
+		if (useTransferQueue)
+		{
+			transferQueueFamily = static_cast<uint32_t>(indices.transferFamily);
+			vkGetDeviceQueue(device, transferQueueFamily, 0, &transferQueue);
+		}
+		if (preferAsyncCompute && indices.computeFamily >= 0)
+		{
+			computeQueueFamily = static_cast<uint32_t>(indices.computeFamily);
+			vkGetDeviceQueue(device, computeQueueFamily, 0, &computeQueue);
+		}
+
+		graphicsSubmitQueue = scheduler.addQueue(graphicsQueue);
+		if (transferQueue != VK_NULL_HANDLE)
+		{
+			transferSubmitQueue = scheduler.addQueue(transferQueue);
+		}
+		if (computeQueue != VK_NULL_HANDLE)
+		{
+			computeSubmitQueue = scheduler.addQueue(computeQueue);
+		}
 	}
 
 	void createSurface()
@@ -732,32 +1451,40 @@ private:
 
 #pragma region Swap Chain Functions
 
-	void cleanupSwapChain()
+	//everything sized by the swap chain is handed to the scheduler and destroyed once lastUse is done
+		//so a new swap chain can be made while the frames in flight are still drawing with the old one
+	void cleanupSwapChain(SubmitScheduler::Ticket lastUse)
 	{
-		vkDestroyImageView(device, depthImageView, nullptr);
-		vkDestroyImage(device, depthImage, nullptr);
-		vkFreeMemory(device, depthImageMemory, nullptr);
-
-		for (auto framebuffer : swapChainFramebuffers)
-		{
-			vkDestroyFramebuffer(device, framebuffer, nullptr);
-		}
-
-		//instead of recreating the command pool, they are just cleaning up the existing command buffers
-		//this way we just use the existing pool to allocate the new buffers
-		vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-
-		vkDestroyPipeline(device, graphicsPipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyRenderPass(device, renderPass, nullptr);
-
-		//since we create the image views we have to destroy them
-		for (auto imageView : swapChainImageViews)
-		{
-			vkDestroyImageView(device, imageView, nullptr);
-		}
+		//the graph's transient images, render passes and framebuffers are all sized by the swap chain
+			//it's moved out whole, createFrameGraph builds the new one in its place
+		std::shared_ptr<RenderGraph> oldFrameGraph = std::make_shared<RenderGraph>(std::move(frameGraph));
+		frameGraph = RenderGraph();
+		Downsampler::Target oldDepthPyramid = depthPyramidTarget;
+		depthPyramidTarget = Downsampler::Target();
+
+		//the command buffers are recorded every frame, so they don't refer to anything here for longer than a frame
+			//and are kept as they are
+
+		VkPipeline oldPipeline = graphicsPipeline;
+		VkPipelineLayout oldPipelineLayout = pipelineLayout;
+		std::vector<VkImageView> oldImageViews = swapChainImageViews;
+		VkSwapchainKHR oldSwapChain = swapChain;
+
+		scheduler.defer(lastUse, [this, oldFrameGraph, oldDepthPyramid, oldPipeline, oldPipelineLayout, oldImageViews, oldSwapChain]() mutable {
+			destroyDepthPyramid(oldDepthPyramid);
+			oldFrameGraph->reset();
+
+			vkDestroyPipeline(device, oldPipeline, nullptr);
+			vkDestroyPipelineLayout(device, oldPipelineLayout, nullptr);
+
+			//since we create the image views we have to destroy them
+			for (auto imageView : oldImageViews)
+			{
+				vkDestroyImageView(device, imageView, nullptr);
+			}
 
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
+			vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+		});
 	}
 
 	void recreateSwapChain()
@@ -766,34 +1493,37 @@ private:
 		glfwGetWindowSize(window, &width, &height);
 		if (width == 0 || height == 0) return;
 
-		//wait until all resources are free
-		vkDeviceWaitIdle(device);
-
-		cleanupSwapChain();
+		//nothing waits for the frames in flight, the last one submitted is the last to use the old swap chain
+			//their culls are done before them
+		VkSwapchainKHR oldSwapChain = swapChain;
+		cleanupSwapChain(scheduler.last(graphicsSubmitQueue));
+		pacer.dropPending();
+		//the frame that found the old one out of date may never have been presented
+		redrawRequested = true;
 
-		createSwapChain();
+		createSwapChain(oldSwapChain);
 		createImageViews();
-		createRenderPass();
+		createFrameGraph();
 		//we could avoid recreating the pipeline by using dynamic state for viewports and scissor rects
 		createGraphicsPipeline();
-		createDepthResources();
-		createFramebuffers();
-		createCommandBuffers();
+
+		//the cull targets point at the old depth pyramid
+		createDepthPyramid();
+		if (useOcclusionCulling && instanceBufferCapacity > 0)
+		{
+			createCullTargets();
+		}
 	}
 
-	void createSwapChain()
+	//oldSwapChain is the one being replaced, if any, it's still destroyed by cleanupSwapChain
+	void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE)
 	{
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-		//maxImageCount == 0, it means there is no limit besides memory requirements
-		if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
-		{
-			imageCount = swapChainSupport.capabilities.maxImageCount;
-		}
+		uint32_t imageCount = FramePacer::chooseImageCount(pacing.swapChainImages, swapChainSupport.capabilities);
 
 		VkSwapchainCreateInfoKHR createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -842,7 +1572,8 @@ private:
 		//if clipped == true that means we don't care about the color of obscured pixels
 		createInfo.clipped = true;
 		//oldSwapchain used when you need to recreate the swapchain
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+			//lets the driver reuse what it can, and the old one's images can still be presented until it's destroyed
+		createInfo.oldSwapchain = oldSwapChain;
 
 		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS)
 		{
@@ -857,6 +1588,8 @@ private:
 
 		swapChainImageFormat = surfaceFormat.format;
 		swapChainExtent = extent;
+
+		std::cout << "swap chain has " << imageCount << " images, presenting with " << FramePacer::presentModeName(presentMode) << std::endl;
 	}
 
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device)
@@ -916,26 +1649,8 @@ private:
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes)
 	{
 		//the only guaranteed available mode is VK_PRESENT_MODE_FIFO_KHR
-		//so as a last resort we will return it
-		VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
-
-
-		for (const auto& availablePresentMode : availablePresentModes)
-		{
-			//try to find triple buffering if possible
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-			{
-				return availablePresentMode;
-			}
-			//but some drivers might not support VK_PRESENT_MODE_FIFO_KHR yet,
-			//so query for immediate swapping
-			else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
-			{
-				bestMode = availablePresentMode;
-			}
-		}
-
-		return bestMode;
+		//so every policy falls back to it
+		return FramePacer::choosePresentMode(pacing.presentPolicy, availablePresentModes);
 	}
 
 	//swap extent is the resolution of the swap chain images
@@ -975,100 +1690,116 @@ private:
 
 #pragma region Graphics Pipeline Functions
 
-	//create a render pass object to describe:
-		//number of color and depth buffers
-		//number of samples to use for each
-		//how content should be handled throughout rendering ops
-	void createRenderPass()
-	{
-		//will create a single color buffer attachment
-		//represented by one of the images from the swap chain
-		VkAttachmentDescription colorAttachment = {};
-		colorAttachment.format = swapChainImageFormat;
-		//no multisampling, so we will only use 1 sample
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		//loadOp determines what to do with attachment before rendering
-		//currently we will clear the values to a constant at the start
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		//storeOp determines what to do with attachment after rendering
-		//currently we are going to store into memory for reading later
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		//initialLayout specifies which layout image before the render pass begins
-		//don't care what the previous layout the image was in
-		//contents of image are not guaranteed to be preserved, but we are going to clear it anyway
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		//finalLayout specifies which layout image after the render pass ends
-		//tells the image to be ready for presentation using the swap chain after rendering
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentDescription depthAttachment = {};
-		depthAttachment.format = findDepthFormat();
-		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference depthAttachmentRef = {};
-		depthAttachmentRef.attachment = 1;
-		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		//Subpasses reference one or more attachments
-		//the below is the reference
-		VkAttachmentReference colorAttachmentRef = {};
-		//index into attachment descriptions array
-		colorAttachmentRef.attachment = 0;
-		//specifies which layout we want the attachment to have during a subpass
-		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		//subpass can only use a single depth(+stencil) attachment
-		VkSubpassDescription subpass = {};
-		//since Vulkan may support comput subpasses in the future,
-		//we have to be explicit about this being a graphics subpass
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef;
-		subpass.pDepthStencilAttachment = &depthAttachmentRef;
-		//the index of the attachment in this array is directly referenced from the fragment shader
-		//by "layout(location = 0) out vec4 outColor" directive
-
-		//subpass dependencies
-		//subpasses in a render pass automatically take care of image layout transitions
-		//transitions are controlled by subpass dependencies
-		VkSubpassDependency dependency = {};
-		//srcSubpass refers to the dependent subpass
-		//VK_SUBPASS_EXTERNAL refers to the implicit subpass before or after the render pass
-		//depends on whether it is srcSubpass or dstSubpass
-		//dstSubpass mush always be higher than srcSubpass
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-
-		//access mask is the op to wait on
-		//stage mask is the stages in which these operations occur
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		//wait on either reading or writing the color attachment in the color attachment stage
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		renderPassInfo.pAttachments = attachments.data();
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
-
-		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
-		{
-			THROW("failed to create a render pass!")
+	//declares the frame's passes and what each one uses, frameGraph works out the render passes and barriers between them
+		//with occlusion culling: early cull, early draw, depth pyramid, late cull, late draw
+		//with GPU culling: cull, draw, or only the draw with async compute
+		//otherwise only the draw
+	//called again whenever the swap chain changes, since the graph's images and render passes are sized by it
+	void createFrameGraph()
+	{
+		frameGraph.init(physicalDevice, device, useSynchronization2);
+
+		//contents of the swap chain image are not needed, every frame clears it
+			//the acquire semaphore is waited on at the color attachment stage, so that's what the first barrier waits on
+		RenderGraph::ImageDesc colorDesc = { swapChainImageFormat, swapChainExtent.width, swapChainExtent.height, 1, 0 };
+		swapChainResource = frameGraph.importImage("swap chain", colorDesc,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		frameGraph.markOutput(swapChainResource);
+
+		RenderGraph::ImageDesc depthDesc = { findDepthFormat(), swapChainExtent.width, swapChainExtent.height, 1, 0 };
+		depthResource = frameGraph.createImage("depth", depthDesc);
+
+		if (useOcclusionCulling)
+		{
+			sizeDepthPyramid();
+
+			RenderGraph::ImageDesc pyramidDesc = { VK_FORMAT_R32_SFLOAT, depthPyramidExtent.width, depthPyramidExtent.height, depthPyramidLevels, 0 };
+			depthPyramidResource = frameGraph.createImage("depth pyramid", pyramidDesc);
+		}
+
+		if (useGpuCulling)
+		{
+			drawBufferResources[0] = frameGraph.importBuffer("draws");
+			countBufferResources[0] = frameGraph.importBuffer("draw count");
+			if (useOcclusionCulling)
+			{
+				drawBufferResources[1] = frameGraph.importBuffer("late draws");
+				countBufferResources[1] = frameGraph.importBuffer("late draw count");
+			}
+		}
+
+		VkClearValue colorClear = {};
+		colorClear.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		VkClearValue depthClear = {};
+		depthClear.depthStencil = { 1.0f, 0 };
+
+		//the dispatch has to be outside a render pass, so it's a pass of its own
+			//with async compute it's submitted on computeQueue by submitCull instead, and the draws wait on its semaphore
+		if (useGpuCulling && !useAsyncCompute)
+		{
+			RenderGraph::PassId cull = frameGraph.addPass("cull", RenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer) {
+				gpuCulling.record(commandBuffer, recordingFrame->cullTarget, &recordingMvp[0][0], static_cast<uint32_t>(sceneObjects.size()),
+					useOcclusionCulling ? GpuCulling::Phase::Early : GpuCulling::Phase::All);
+			});
+			frameGraph.use(cull, drawBufferResources[0], RenderGraph::Usage::StorageBufferWriteCompute);
+			frameGraph.use(cull, countBufferResources[0], RenderGraph::Usage::StorageBufferWriteCompute);
+		}
+
+		RenderGraph::PassId draw = frameGraph.addPass("draw", RenderGraph::PassType::Graphics, [this](VkCommandBuffer commandBuffer) {
+			recordSceneDraws(commandBuffer, false);
+		});
+		frameGraph.use(draw, swapChainResource, RenderGraph::Usage::ColorAttachment);
+		frameGraph.use(draw, depthResource, RenderGraph::Usage::DepthAttachment);
+		frameGraph.setClearValue(draw, swapChainResource, colorClear);
+		frameGraph.setClearValue(draw, depthResource, depthClear);
+		if (useGpuCulling)
+		{
+			frameGraph.use(draw, drawBufferResources[0], RenderGraph::Usage::IndirectBuffer);
+			frameGraph.use(draw, countBufferResources[0], RenderGraph::Usage::IndirectBuffer);
+		}
+
+		if (useOcclusionCulling)
+		{
+			RenderGraph::PassId pyramid = frameGraph.addPass("depth pyramid", RenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer) {
+				buildDepthPyramid(commandBuffer);
+			});
+			frameGraph.use(pyramid, depthResource, RenderGraph::Usage::SampledCompute);
+			frameGraph.use(pyramid, depthPyramidResource, RenderGraph::Usage::StorageImageCompute);
+
+			RenderGraph::PassId lateCull = frameGraph.addPass("late cull", RenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer) {
+				gpuCulling.record(commandBuffer, recordingFrame->lateCullTarget, &recordingMvp[0][0], static_cast<uint32_t>(sceneObjects.size()),
+					GpuCulling::Phase::Late);
+			});
+			frameGraph.use(lateCull, depthPyramidResource, RenderGraph::Usage::SampledCompute);
+			frameGraph.use(lateCull, drawBufferResources[1], RenderGraph::Usage::StorageBufferWriteCompute);
+			frameGraph.use(lateCull, countBufferResources[1], RenderGraph::Usage::StorageBufferWriteCompute);
+
+			//no clear values, so both attachments are loaded as the early draws left them
+			RenderGraph::PassId lateDraw = frameGraph.addPass("late draw", RenderGraph::PassType::Graphics, [this](VkCommandBuffer commandBuffer) {
+				recordSceneDraws(commandBuffer, true);
+			});
+			frameGraph.use(lateDraw, swapChainResource, RenderGraph::Usage::ColorAttachment);
+			frameGraph.use(lateDraw, depthResource, RenderGraph::Usage::DepthAttachment);
+			frameGraph.use(lateDraw, drawBufferResources[1], RenderGraph::Usage::IndirectBuffer);
+			frameGraph.use(lateDraw, countBufferResources[1], RenderGraph::Usage::IndirectBuffer);
+
+			//the next frame's early phase can start once the late cull has written the visibility, not once this frame is drawn
+			if (splitsFrame())
+			{
+				frameGraph.beginPartAt(lateDraw);
+			}
 		}
+
+		frameGraph.compile();
+
+		//the late draw's render pass has the same attachment formats, so the pipeline works with it too
+		renderPass = frameGraph.getRenderPass(draw);
+
+		const RenderGraph::Stats& stats = frameGraph.getStats();
+		std::cout << "frame graph: " << stats.passCount - stats.culledPassCount << " of " << stats.passCount << " passes, "
+			<< stats.transientImageCount << " transient images in " << stats.allocatedSize / 1024 << " KB, "
+			<< (stats.transientSize - stats.allocatedSize) / 1024 << " KB saved by aliasing" << std::endl;
+		printedFrameGraphStats = false;
 	}
 
 	void createGraphicsPipeline()
@@ -1077,11 +1808,9 @@ private:
 		VkShaderModule vertShaderModule;
 		VkShaderModule fragShaderModule;
 
-		auto vertShaderCode = readFile("shaders/vert.spv");
-		auto fragShaderCode = readFile("shaders/frag.spv");
-
+		//the SPIR-V is read once in loadShaders, so recreating the swap chain doesn't touch the disk
 		vertShaderModule = createShaderModule(vertShaderCode);
-		fragShaderModule = createShaderModule(fragShaderCode);
+		fragShaderModule = createShaderModule(useBindless ? bindlessFragShaderCode : fragShaderCode);
 
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -1097,8 +1826,15 @@ private:
 
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescription = Vertex::getAttributeDescriptions();
+		//binding 0 is per vertex and binding 1 per instance
+		std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {
+			Vertex::getBindingDescription(),
+			InstanceData::getBindingDescription()
+		};
+		auto vertexAttributes = Vertex::getAttributeDescriptions();
+		auto instanceAttributes = InstanceData::getAttributeDescriptions();
+		std::vector<VkVertexInputAttributeDescription> attributeDescription(vertexAttributes.begin(), vertexAttributes.end());
+		attributeDescription.insert(attributeDescription.end(), instanceAttributes.begin(), instanceAttributes.end());
 
 		//describes format of vertex data that will be passed to the vertex shader
 			//can do this in 2 ways:
@@ -1107,8 +1843,8 @@ private:
 		//for now we will specify that there is not vertex data to load
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescription.size());
 		vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
 
@@ -1259,13 +1995,25 @@ private:
 		depthStencil.maxDepthBounds = 1.0f;	//Optional
 		//rest are for a stencil component
 
+		//DrawConstants goes to the vertex shader, the bindless path adds the texture array as set 1
+		std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayout };
+		if (useBindless)
+		{
+			setLayouts.push_back(bindlessTextures.getLayout());
+		}
+
+		std::vector<VkPushConstantRange> pushConstantRanges(1);
+		pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRanges[0].offset = 0;
+		pushConstantRanges[0].size = sizeof(DrawConstants);
+
 		//you need to specify uniform values during pipeline creation
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;	//Optional
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;	//Optional
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());	//Optional
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();	//Optional
 
 		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
 		{
@@ -1304,6 +2052,39 @@ private:
 		vkDestroyShaderModule(device, vertShaderModule, nullptr);
 	}
 
+	void loadShaders()
+	{
+		vertShaderCode = readFile("shaders/vert.spv");
+		fragShaderCode = readFile("shaders/frag.spv");
+
+		if (fileExists("shaders/downsample.spv"))
+		{
+			downsampleShaderCode = readFile("shaders/downsample.spv");
+		}
+		if (fileExists("shaders/downsample_depth.spv"))
+		{
+			downsampleDepthShaderCode = readFile("shaders/downsample_depth.spv");
+		}
+		if (fileExists("shaders/bindless_frag.spv"))
+		{
+			bindlessFragShaderCode = readFile("shaders/bindless_frag.spv");
+		}
+		if (fileExists("shaders/cull.spv"))
+		{
+			cullShaderCode = readFile("shaders/cull.spv");
+		}
+		if (fileExists("shaders/cull_occlusion.spv"))
+		{
+			cullOcclusionShaderCode = readFile("shaders/cull_occlusion.spv");
+		}
+	}
+
+	static bool fileExists(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		return file.is_open();
+	}
+
 	static std::vector<char> readFile(const std::string& filename)
 	{
 		//ate says to read starting at the end and binary says to read it as a binary file
@@ -1344,37 +2125,7 @@ private:
 
 #pragma endregion
 
-	//Set up the render pass to expect a single framebuffer with same format as the swap chain images
-	//the attachments specified during render pass creation are bound by wrapping them into a VkFramebuffer obj
-		//A framebuffer obj references all VkImageView objects that represent attachments ?????Confused on this point?????
-			//means there will only be a single one (color attachment)
-			//the image we use depends on which image the swap chain returns when we retrieve one for presentation
-				//So we have to create a framebuffer for all images in swap chain and choose the correct one at drawing time
-	void createFramebuffers()
-	{
-		swapChainFramebuffers.resize(swapChainImageViews.size());
-
-		for (size_t i = 0; i < swapChainImageViews.size(); i++)
-		{
-			std::array<VkImageView, 2> attachments = { swapChainImageViews[i], depthImageView };
-
-			VkFramebufferCreateInfo framebufferInfo = {};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = renderPass;
-			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-			framebufferInfo.pAttachments = attachments.data();
-			framebufferInfo.width = swapChainExtent.width;
-			framebufferInfo.height = swapChainExtent.height;
-			framebufferInfo.layers = 1;
-
-			if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS)
-			{
-				THROW("failed to create framebuffer!")
-			}
-		}
-	}
-
-	void createCommandPool()
+	void createCommandPool()
 	{
 		//Command buffers are executed by submitting them on one of the device queues
 		//Each command pool can only allocate command buffers that are submitted on a single type of queue
@@ -1385,17 +2136,42 @@ private:
 		VkCommandPoolCreateInfo poolInfo = {};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-		poolInfo.flags = 0;
+		//the frame command buffers are reset one at a time when they're recorded again
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
 		{
 			THROW("failed to create command pool!")
 		}
+
+		//streaming uploads allocate one command buffer each and free it when the upload is done
+		if (useTransferQueue)
+		{
+			poolInfo.queueFamilyIndex = transferQueueFamily;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+			{
+				THROW("failed to create transfer command pool!")
+			}
+		}
+
+		//one cull command buffer per frame, reset when it's recorded again like the frame's own
+		if (computeQueue != VK_NULL_HANDLE)
+		{
+			poolInfo.queueFamilyIndex = computeQueueFamily;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+			if (vkCreateCommandPool(device, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS)
+			{
+				THROW("failed to create compute command pool!")
+			}
+		}
 	}
 
 	void createCommandBuffers()
 	{
-		commandBuffers.resize(swapChainFramebuffers.size());
+		std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> commandBuffers;
 
 		VkCommandBufferAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1412,86 +2188,227 @@ private:
 			THROW("failed to allocate command buffers")
 		}
 
-		//recording a command buffer
-		for (size_t i = 0; i < commandBuffers.size(); i++)
+		for (size_t i = 0; i < frames.size(); i++)
+		{
+			frames[i].commandBuffer = commandBuffers[i];
+		}
+
+		//benchmarkAsyncCompute switches whether the frame is split, so these are there whenever it can be
+		if (useOcclusionCulling && computeQueue != VK_NULL_HANDLE)
+		{
+			if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+			{
+				THROW("failed to allocate late command buffers")
+			}
+
+			for (size_t i = 0; i < frames.size(); i++)
+			{
+				frames[i].lateCommandBuffer = commandBuffers[i];
+			}
+		}
+
+		if (computeQueue != VK_NULL_HANDLE)
+		{
+			allocInfo.commandPool = computeCommandPool;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+			{
+				THROW("failed to allocate compute command buffers")
+			}
+
+			for (size_t i = 0; i < frames.size(); i++)
+			{
+				frames[i].computeCommandBuffer = commandBuffers[i];
+			}
+		}
+	}
+
+	//one frame's draw into the swap chain image at imageIndex, descriptorSet is the model set for this frame
+	void recordCommandBuffer(FrameData& frame, uint32_t imageIndex, VkDescriptorSet descriptorSet)
+	{
+		VkCommandBuffer commandBuffer = frame.commandBuffer;
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		//one time submit since the buffer is recorded again before its next use
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = nullptr;	//Optional
+
+		//if the buffer was already recorded once, then a call to the below function will implicitly reset it
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		if (splitsFrame())
+		{
+			vkBeginCommandBuffer(frame.lateCommandBuffer, &beginInfo);
+		}
+
+		//streamed images copied on the transfer queue are taken over before anything samples them
+			//same layouts as the release in submitStreamingUpload, both halves have to match
+		for (const StreamingUpload& upload : streamingAcquires)
+		{
+			barrierTracker.acquireImage(upload.image, transferQueueFamily, graphicsQueueFamily,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+		barrierTracker.flush(commandBuffer);
+
+		//the only per draw state, the whole scene turns with modelMatrix
+		DrawConstants draw = {};
+		draw.model = modelMatrix;
+		glm::mat4 mvp = sceneMvp();
+
+		//the bounds are in the space mvp takes points from, so the frustum is taken from it too
+		if (!useGpuCulling)
+		{
+			cullSceneInstances(mvp);
+		}
+
+		//the passes and the barriers between them are recorded by frameGraph, see createFrameGraph
+		recordingFrame = &frame;
+		recordingDescriptorSet = descriptorSet;
+		recordingDraw = draw;
+		recordingMvp = mvp;
+		//the graph makes a framebuffer for each swap chain image the first time it's drawn to
+		frameGraph.setImage(swapChainResource, swapChainImages[imageIndex], swapChainImageViews[imageIndex]);
+		if (useGpuCulling)
+		{
+			frameGraph.setBuffer(drawBufferResources[0], frame.cullTarget.drawBuffer);
+			frameGraph.setBuffer(countBufferResources[0], frame.cullTarget.countBuffer);
+			if (useOcclusionCulling)
+			{
+				frameGraph.setBuffer(drawBufferResources[1], frame.lateCullTarget.drawBuffer);
+				frameGraph.setBuffer(countBufferResources[1], frame.lateCullTarget.countBuffer);
+			}
+		}
+
+		if (splitsFrame())
+		{
+			frameGraph.execute({ commandBuffer, frame.lateCommandBuffer });
+		}
+		else
+		{
+			frameGraph.execute(commandBuffer);
+		}
+
+		//the barriers are the same every frame, so once is enough
+		if (!printedFrameGraphStats)
 		{
-			VkCommandBufferBeginInfo beginInfo = {};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			//simultaneous use means the buffer can be resubmitted while it is also already pending execution
-				//we use simultaneous flag since we may already be scheduling the drawing commands for the next frame while the last frame isn't done
-			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			beginInfo.pInheritanceInfo = nullptr;	//Optional
+			const RenderGraph::Stats& stats = frameGraph.getStats();
+			std::cout << "frame graph: " << stats.barrierCount << " barriers in " << stats.barrierBatchCount << " batches per frame" << std::endl;
+			printedFrameGraphStats = true;
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS
+			|| (splitsFrame() && vkEndCommandBuffer(frame.lateCommandBuffer) != VK_SUCCESS))
+		{
+			THROW("failed to record command buffer!")
+		}
+	}
+
+	glm::mat4 sceneMvp() const
+	{
+		return currentUbo.viewProj * modelMatrix;
+	}
 
-			//if the buffer was already recorded once, then a call to the below function will implicitly reset it
-			vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
+	//the frame is submitted as everything up to the late cull, then the late draws
+		//only needed when the next frame's early cull is on computeQueue, on graphicsQueue it's behind the whole frame anyway
+	bool splitsFrame() const
+	{
+		return useAsyncCompute && useOcclusionCulling;
+	}
 
-			VkRenderPassBeginInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			//we created a framebuffer for each swap chain image that specifies it as a color attachment
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
+	//records and submits the frame's cull dispatch on computeQueue, before the frame's own command buffer is recorded
+		//the GPU can start on it while it's still drawing the previous frame
+		//with occlusion it's the early phase, the rest is in the frame's command buffer
+	void submitCull(FrameData& frame)
+	{
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(frame.computeCommandBuffer, &beginInfo);
 
-			//The below define the size of the render area
-			renderPassInfo.renderArea.offset = { 0,0 };
-			renderPassInfo.renderArea.extent = swapChainExtent;
+		glm::mat4 mvp = sceneMvp();
+		gpuCulling.record(frame.computeCommandBuffer, frame.cullTarget, &mvp[0][0], static_cast<uint32_t>(sceneObjects.size()),
+			useOcclusionCulling ? GpuCulling::Phase::Early : GpuCulling::Phase::All);
 
-			//These are the clear values to use for VK_ATTACHMENT_LOAD_OP_CLEAR
-				//we use this as the load operation for the color attachment
-			std::array<VkClearValue, 2> clearValues = {};
-			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-			clearValues[1].depthStencil = { 1.0f, 0 };
+		if (vkEndCommandBuffer(frame.computeCommandBuffer) != VK_SUCCESS)
+		{
+			THROW("failed to record cull command buffer!")
+		}
 
-			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
+		//the early phase reads the visibility the last frame's late phase wrote
+			//that's in the first part of the last frame, so this runs alongside its late draws
+		std::vector<SubmitScheduler::Wait> waits;
+		if (useOcclusionCulling)
+		{
+			waits.push_back(scheduler.after(visibilityWritten, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT));
+		}
 
-			//all functions that record commands can be recognized by "vkCmd" prefix
-			//the final parameter controls how the drawing commands within the render pass will be provided
-				//VK_SUBPASS_CONTENTS_INLINE - render pass commands will be embedded in the primary command buffer itself, no secondary buffers will be executed
-				//VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS - render pass commands will be executed from secondary command buffers
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		//signaling the semaphore makes the draw and count buffers available, the wait makes them visible to the indirect draws
+		scheduler.submit(computeSubmitQueue, { frame.computeCommandBuffer }, waits, { frame.cullFinishedSemaphore });
+	}
 
-			//bind the graphics pipeline
-			//second parameter tells whether the pipeline is graphics or compute
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	//the scene's draws, inside a draw pass's render pass
+		//late is the occlusion culling phase, drawing what the early draws missed on top of them
+	void recordSceneDraws(VkCommandBuffer commandBuffer, bool late)
+	{
+		//bind the graphics pipeline
+		//second parameter tells whether the pipeline is graphics or compute
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 
-			VkBuffer vertexBuffers[] = { vertexBuffer };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+		VkBuffer vertexBuffers[] = { vertexBuffer, instanceBuffer };
+		VkDeviceSize offsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-			//not unique to graphics pipelines, so we need to specify
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		//not unique to graphics pipelines, so we need to specify
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &recordingDescriptorSet, 0, nullptr);
 
-			//the fourth parameter is the offset into the vertex buffer
-				//defines lowest value of Gl_VertexIndex
-			//the last one is the offset for instanced rendering
-				//defines lowest value of gl_InstanceIndex
-			//vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+		if (useBindless)
+		{
+			//every texture is in this one set, instances with other materials only need a different material index
+			VkDescriptorSet textureSet = bindlessTextures.getSet();
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &textureSet, 0, nullptr);
+		}
 
-			//now using indices
-			//not using instancing so we say only 1 instance
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(recordingDraw), &recordingDraw);
 
-			//end the render pass
-			vkCmdEndRenderPass(commandBuffers[i]);
+		//the fourth parameter is the offset into the vertex buffer
+			//defines lowest value of Gl_VertexIndex
+		//the last one is the offset for instanced rendering
+			//defines lowest value of gl_InstanceIndex
+		//vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
 
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
+		//now using indices
+		if (useGpuCulling)
+		{
+			//one indirect draw per visible object, firstInstance picks its entry of the instance buffer
+			gpuCulling.draw(commandBuffer, late ? recordingFrame->lateCullTarget : recordingFrame->cullTarget);
+		}
+		else
+		{
+			//one draw for every run of visible copies of the mesh, each instance reads its own entry of the instance buffer
+			for (const InstanceRun& run : visibleInstanceRuns)
 			{
-				THROW("failed to record command buffer!")
+				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), run.count, 0, 0, run.first);
 			}
 		}
 	}
 
-	void createSemaphores()
+	void createSyncObjects()
 	{
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS
-			|| vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS)
+		//each frame's ticket starts out at value 0, which is always done, so the first wait on it doesn't block
+		for (FrameData& frame : frames)
 		{
-			THROW("failed to create semaphores!")
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore) != VK_SUCCESS
+				|| vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.renderFinishedSemaphore) != VK_SUCCESS
+				|| vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.cullFinishedSemaphore) != VK_SUCCESS)
+			{
+				THROW("failed to create synchronization objects for a frame!")
+			}
 		}
 	}
 
@@ -1506,6 +2423,19 @@ private:
 			//fences are designed to sync rendering with app itself
 			//semaphores are used to sync ops within or accross command queues
 
+		FrameData& frame = frames[currentFrame];
+
+		//wait for the GPU to finish the last frame that used this FrameData
+			//this is what keeps the CPU at most MAX_FRAMES_IN_FLIGHT frames ahead
+		scheduler.wait(frame.ticket);
+		//and destroy whatever the frames and uploads that are done by now were holding on to
+		scheduler.collect();
+		pacer.update(scheduler, swapChain);
+
+		//nothing pending uses this frame's set or uniform buffer anymore
+		updateModelDescriptorSet(frame);
+		memcpy(frame.uniformBufferMapped, &currentUbo, sizeof(currentUbo));
+
 		//acquire image from swap chain
 		uint32_t imageIndex;
 
@@ -1514,7 +2444,7 @@ private:
 		//the fourth and fifth params are for the semaphore and fence
 			//we are only using a semaphore
 		//final param the out variable to store index of the newly avaiable swap chain image
-		VkResult result = vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(), imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+		VkResult result = vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(), frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
 
 		//if the swap chain is out of date, recreate it and try again next frame
 		//we are ignoring the suboptimal case
@@ -1528,27 +2458,51 @@ private:
 			THROW("failed to acquire swap chain image!")
 		}
 
-		//submit the command buffer
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		//after the acquire, so an out of date swap chain can't leave the semaphore signaled with nothing waiting on it
+		if (useAsyncCompute)
+		{
+			submitCull(frame);
+		}
 
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;	//what stage(s) of the pipeline to wait
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+		recordCommandBuffer(frame, imageIndex, frame.descriptorSet);
+
+		//submit the command buffer
+			//the stages are what stage(s) of the pipeline wait on each semaphore
+		std::vector<SubmitScheduler::Wait> waits = { { frame.imageAvailableSemaphore, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT } };
+		//the acquire barriers have to come after the releases, their copies are already done so this doesn't hold anything up
+		for (const StreamingUpload& upload : streamingAcquires)
+		{
+			waits.push_back({ upload.semaphore, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT });
+		}
+		if (useAsyncCompute)
+		{
+			//the late cull writes the visibility the early one reads, so it waits as well
+			VkPipelineStageFlags cullStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+				| (useOcclusionCulling ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : 0);
+			waits.push_back({ frame.cullFinishedSemaphore, cullStages });
+		}
 
-		VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
+		VkSemaphore signalSemaphores[] = { frame.renderFinishedSemaphore };
+		if (splitsFrame())
+		{
+			visibilityWritten = scheduler.submit(graphicsSubmitQueue, { frame.commandBuffer }, waits);
+			frame.ticket = scheduler.submit(graphicsSubmitQueue, { frame.lateCommandBuffer }, {}, { frame.renderFinishedSemaphore });
+		}
+		else
+		{
+			frame.ticket = scheduler.submit(graphicsSubmitQueue, { frame.commandBuffer }, waits, { frame.renderFinishedSemaphore });
+			visibilityWritten = frame.ticket;
+		}
+		uint64_t presentId = pacer.frameSubmitted(frame.ticket);
 
-		//can take an array of VkSubmitInfo structs for when the workload is much larger
-		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		for (const StreamingUpload& upload : streamingAcquires)
 		{
-			THROW("failed to submit draw command buffer!")
+			scheduler.defer(frame.ticket, [this, upload]() {
+				vkDestroySemaphore(device, upload.semaphore, nullptr);
+				vkFreeCommandBuffers(device, transferCommandPool, 1, &upload.commandBuffer);
+			});
 		}
+		streamingAcquires.clear();
 
 		//present the images
 			//submitting the result to the swap chain to have it eventually show up on the screen
@@ -1564,6 +2518,16 @@ private:
 		presentInfo.pResults = nullptr;	//Optional: allows you to specify an array of VkResult values
 			//good for checking every individual swap chain if presentation is successful
 
+		//lets the pacer wait on this present to measure the frame's latency
+		VkPresentIdKHR presentIds = {};
+		presentIds.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentIds.swapchainCount = 1;
+		presentIds.pPresentIds = &presentId;
+		if (usePresentWait)
+		{
+			presentInfo.pNext = &presentIds;
+		}
+
 		//submits the request to present an image to the swap chain
 		result = vkQueuePresentKHR(presentQueue, &presentInfo);
 
@@ -1576,11 +2540,37 @@ private:
 			THROW("failed to present swap chain image!")
 		}
 
-		if (enableValidationLayers)
+		//the frame tickets keep the CPU from running ahead, this used to be a vkQueueWaitIdle on the present queue
+		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	}
+
+	//wait for the frame maxQueuedFrames back, so no more than that many are left queued on the GPU
+		//at MAX_FRAMES_IN_FLIGHT it's the frame that last used frames[currentFrame], which drawFrame waits on anyway
+	void waitForQueuedFrames()
+	{
+		uint32_t maxQueued = pacer.getSettings().maxQueuedFrames;
+		scheduler.wait(frames[(currentFrame + MAX_FRAMES_IN_FLIGHT - maxQueued) % MAX_FRAMES_IN_FLIGHT].ticket);
+	}
+
+	//the frame times and latencies since the last call
+	void printPacingStats()
+	{
+		FramePacer::Stats stats = pacer.getStats();
+		if (stats.frameCount == 0)
+		{
+			std::cout << "idle";
+		}
+		else
+		{
+			std::cout << stats.frameCount / stats.seconds << " fps, frames took " << stats.minFrameMilliseconds
+				<< " to " << stats.maxFrameMilliseconds << " ms";
+		}
+		if (stats.latencyCount > 0)
 		{
-			//wait for presentation to finish before starting to draw the next frame
-			vkQueueWaitIdle(presentQueue);
+			std::cout << ", submit to " << (pacer.usesPresentWait() ? "present " : "GPU done ") << stats.averageLatencyMilliseconds
+				<< " ms average, " << stats.maxLatencyMilliseconds << " ms max";
 		}
+		std::cout << ", " << stats.cpuUtilization * 100.0 << "% CPU" << std::endl;
 	}
 
 #pragma region Buffer Functions
@@ -1645,12 +2635,71 @@ private:
 		vkFreeMemory(device, stagingBufferMemory, nullptr);
 	}
 
+	//a device local buffer filled with size bytes of data through a staging buffer
+		//TRANSFER_DST is added to usage since that's how the data gets in
+	//returns the upload's submission, see uploadToBuffer
+	SubmitScheduler::Ticket createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+		VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool sharedWithCompute = false)
+	{
+		createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory, sharedWithCompute);
+		return uploadToBuffer(data, size, buffer);
+	}
+
+	//overwrites the start of a device local buffer, waits for the copy so nothing pending can still be reading it
+	//only submits the copy, the staging buffer is destroyed once it's done
+		//on graphicsQueue the copy waits for everything submitted before it and everything after it sees the new contents
+		//work on another queue has to wait on the returned submission
+	SubmitScheduler::Ticket uploadToBuffer(const void* data, VkDeviceSize size, VkBuffer buffer)
+	{
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer, stagingBufferMemory);
+
+		void* mapped;
+		vkMapMemory(device, stagingBufferMemory, 0, size, 0, &mapped);
+		memcpy(mapped, data, static_cast<size_t>(size));
+		vkUnmapMemory(device, stagingBufferMemory);
+
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+		//frames in flight may still be reading the old contents
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 0, nullptr);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = size;
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+
+		SubmitScheduler::Ticket ticket = submitSingleTimeCommands(commandBuffer);
+		scheduler.defer(ticket, [this, stagingBuffer, stagingBufferMemory]() {
+			vkDestroyBuffer(device, stagingBuffer, nullptr);
+			vkFreeMemory(device, stagingBufferMemory, nullptr);
+		});
+		return ticket;
+	}
+
+	//one per frame in flight, so a frame can be written while the GPU is still reading the last one
 	void createUniformBuffer()
 	{
 		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			uniformBuffer, uniformBufferMemory);
+		for (FrameData& frame : frames)
+		{
+			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				frame.uniformBuffer, frame.uniformBufferMemory);
+
+			//mapped for as long as the buffer lives instead of mapping every frame
+			vkMapMemory(device, frame.uniformBufferMemory, 0, bufferSize, 0, &frame.uniformBufferMapped);
+		}
 	}
 
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
@@ -1676,8 +2725,9 @@ private:
 		THROW("failed to find suitable memory type!")
 	}
 
+	//sharedWithCompute is for buffers computeQueue uses as well, they're concurrent so neither queue has to hand them over
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-		VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+		VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool sharedWithCompute = false)
 	{
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1688,6 +2738,14 @@ private:
 			//can also be shared by multiple queue families
 		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+		uint32_t queueFamilyIndices[] = { graphicsQueueFamily, computeQueueFamily };
+		if (sharedWithCompute && computeQueue != VK_NULL_HANDLE)
+		{
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = 2;
+			bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+		}
+
 		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
 		{
 			THROW("failed to create buffer!")
@@ -1767,164 +2825,309 @@ private:
 
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer)
 	{
-		vkEndCommandBuffer(commandBuffer);
-
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
 		//we want the transfer on buffers immediately, so there are 2 ways
 			//use a fence and wait with vkWaitForFences()
 				//would allow you to schedule multiple transfers simultaneously and wait for them all to complete
 			//or wait for transfer queue to become idle with vkQueueWaitIdle()
-		vkQueueWaitIdle(graphicsQueue);
+		//the scheduler waits for this one submission, so frames still in flight aren't waited on with it
+		scheduler.wait(submitSingleTimeCommands(commandBuffer));
+		scheduler.collect();
+	}
+
+	//the same without waiting, the command buffer is freed once the returned submission is done
+		//it runs after everything submitted on graphicsQueue before it, and before anything after it, with barriers to match
+	SubmitScheduler::Ticket submitSingleTimeCommands(VkCommandBuffer commandBuffer)
+	{
+		vkEndCommandBuffer(commandBuffer);
 
-		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+		SubmitScheduler::Ticket ticket = scheduler.submit(graphicsSubmitQueue, { commandBuffer });
+		scheduler.defer(ticket, [this, commandBuffer]() {
+			vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+		});
+		return ticket;
 	}
 
 	void createDescriptorSetLayout()
 	{
-		VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-		//binding specifies the binding variable in the shader
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.descriptorCount = 1;
-		//below specifies in which shader stage this is going to be used
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		//only for image sampling related descriptors
-		uboLayoutBinding.pImmutableSamplers = nullptr;	//Optional
-
-		VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-		samplerLayoutBinding.binding = 1;
-		samplerLayoutBinding.descriptorCount = 1;
-		samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerLayoutBinding.pImmutableSamplers = nullptr;
-		samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		//binding specifies the binding variable in the shader, then in which shader stage it's going to be used
+			//the offset is where the descriptor sits in ModelDescriptors, for writing the set with an update template
+		modelSetDescription = DescriptorSetDescription();
+		modelSetDescription.add(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT,
+			offsetof(ModelDescriptors, uniformBuffer));
+
+		//with bindless textures the texture comes from bindlessTextures' set instead
+		if (!useBindless)
+		{
+			modelSetDescription.add(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT,
+				offsetof(ModelDescriptors, texture));
+		}
 
-		std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
-		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
+		descriptorSetLayout = modelSetDescription.createLayout(device);
 
-		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		//the pipeline layout needs the bindless set layout, so it's made here too
+		if (useBindless)
 		{
-			THROW("failed to create descriptor set layout!")
+			bindlessTextures.init(physicalDevice, device);
 		}
 	}
 
+	//only works out the matrices, drawFrame copies them into the frame's buffer once the GPU is done with it
 	void updateUniformBuffer()
 	{
 		//the most efficient way to pass frequently changing values to the shader is push constants
+			//so the model matrix goes in DrawConstants and only the view projection is in the buffer
 
-		static auto startTime = std::chrono::high_resolution_clock::now();
+		//the newest ticks the simulation has published, until it has published any this is the starting state
+		sceneSnapshots.update();
+		const SceneSnapshot& snapshot = sceneSnapshots.front();
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+		//drawn a tick behind, so there's always a tick on either side to blend between
+			//0 at the moment current was meant to be on screen, 1 a tick later, when the next one should have come in
+		std::chrono::duration<float> sinceTick = std::chrono::steady_clock::now() - snapshot.current.time;
+		float blend = glm::clamp(sinceTick.count() * SIMULATION_RATE, 0.0f, 1.0f);
+		float spinAngle = glm::mix(snapshot.previous.spinAngle, snapshot.current.spinAngle, blend);
+		glm::vec3 eye = glm::mix(snapshot.previous.eye, snapshot.current.eye, blend);
+		glm::vec3 center = glm::mix(snapshot.previous.center, snapshot.current.center, blend);
 
 		UniformBufferObject ubo = {};
 		//glm::mat4(1.0f) gives the 4x4 identity matrix
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		modelMatrix = glm::rotate(glm::mat4(1.0f), spinAngle, glm::vec3(0.0f, 0.0f, 1.0f));
 		//looking at the geometry from above at a 45 degree angle
 			//takes eye position, center position, and up axis parameters
-		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		viewMatrix = glm::lookAt(eye, center, glm::vec3(0.0f, 0.0f, 1.0f));
 		//using 45 degree vertical field-of-view
 		//then aspect ratio, then near and far view planes
-		ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
+		projMatrix = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
 		//since glm was made for OpenGl where the Y coordinate of the clip coordinates is inverted,
 			//easiest way to compensat is to flip the sign on the scaling factor of the Y axis in the projection matrix
-		ubo.proj[1][1] *= -1;
+		projMatrix[1][1] *= -1;
+		ubo.viewProj = projMatrix * viewMatrix;
 
-		void* data;
-		vkMapMemory(device, uniformBufferMemory, 0, sizeof(ubo), 0, &data);
-		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(device, uniformBufferMemory);
+		currentUbo = ubo;
 	}
 
 #pragma endregion
 
-	void createDescriptorPool()
+#pragma region Simulation
+
+	//the main thread has to stay the one that handles the window's events, so it draws the frames too
+	void startSimulation()
+	{
+		simulationStopping = false;
+		simulationThread = std::thread([this]() { simulationLoop(); });
+	}
+
+	void endSimulation()
 	{
-		//need to describe which descriptor types our descriptor set are going to contain and how many
-		std::array<VkDescriptorPoolSize, 2> poolSizes = {};
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = 1;
+		{
+			std::lock_guard<std::mutex> lock(simulationMutex);
+			simulationStopping = true;
+		}
+		simulationWake.notify_all();
+		simulationThread.join();
+	}
 
-		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[1].descriptorCount = 1;
+	//steps the scene at SIMULATION_RATE and publishes every tick with the one before it
+		//each step is the same length however late it runs, so the same input gives the same ticks
+	void simulationLoop()
+	{
+		typedef std::chrono::steady_clock Clock;
+		const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / SIMULATION_RATE));
 
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = 1;
+		SceneState state;
+		state.time = Clock::now();
+		Clock::time_point nextTick = state.time;
 
-		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		std::unique_lock<std::mutex> lock(simulationMutex);
+		while (!simulationStopping)
 		{
-			THROW("failed to create descriptor pool!")
+			//nothing moves, sleep until there's input that could change that
+				//the last tick published stays on screen, then the ticks start again from now instead of catching up
+			if (!spinModel)
+			{
+				simulationWake.wait(lock, [this]() { return simulationStopping || spinModel; });
+				nextTick = Clock::now();
+				continue;
+			}
+
+			nextTick += step;
+			//fell more than a few ticks behind, like in a debugger, skip them rather than run them all at once
+			if (Clock::now() > nextTick + 4 * step)
+			{
+				nextTick = Clock::now();
+			}
+			if (simulationWake.wait_until(lock, nextTick, [this]() { return simulationStopping; })) break;
+
+			SceneState next = state;
+			next.tick++;
+			next.time = nextTick;
+			if (spinModel)
+			{
+				next.spinAngle += glm::radians(90.0f) / SIMULATION_RATE;
+			}
+
+			SceneSnapshot& snapshot = sceneSnapshots.back();
+			snapshot.previous = state;
+			snapshot.current = next;
+			sceneSnapshots.publish();
+			state = next;
+
+			//the main thread might be waiting for events with nothing else to wake it
+			if (renderOnDemand)
+			{
+				glfwPostEmptyEvent();
+			}
 		}
 	}
 
-	void createDescriptorSet()
+#pragma endregion
+
+	void createDescriptorAllocators()
 	{
-		//don't need to explicitly clean up descriptor sets,
-			//because they are freed when the descriptor pool is destroyed
+		//need to describe which descriptor types our descriptor sets are going to contain and how many
+			//the allocator makes pools of this shape and chains a bigger one on whenever one runs out
+		std::vector<DescriptorAllocator::PoolSizeRatio> ratios = { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f } };
+		if (!useBindless)
+		{
+			ratios.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f });
+		}
 
-		//allocate the descriptor set
-		VkDescriptorSetLayout layouts[] = { descriptorSetLayout };
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = layouts;
+		//one model set per frame in flight, plus the ones the benchmarks ask for
+		descriptorAllocator.init(device, 4, ratios);
+		descriptorCache.init(device, &descriptorAllocator);
+	}
+
+	//the frame's model set, out of descriptorCache, only called once nothing pending uses the frame's current one
+		//the set is only looked up again when the texture view it points at changes, with bindless textures it has none so that's never
+	void updateModelDescriptorSet(FrameData& frame)
+	{
+		VkImageView view = useBindless ? VK_NULL_HANDLE : modelTextureView();
+		if (frame.descriptorSet != VK_NULL_HANDLE && frame.descriptorSetView == view) return;
+
+		//handed back so the cache writes the new bindings over it instead of allocating another one
+		if (frame.descriptorSet != VK_NULL_HANDLE)
+		{
+			descriptorCache.release(frame.descriptorSet);
+		}
 
-		if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS)
+		frame.descriptorSet = descriptorCache.get(descriptorSetLayout, modelSetBindings(frame));
+		frame.descriptorSetView = view;
+	}
+
+	std::vector<DescriptorCache::Binding> modelSetBindings(const FrameData& frame) const
+	{
+		std::vector<DescriptorCache::Binding> bindings = {
+			DescriptorCache::Binding::uniformBuffer(0, frame.uniformBuffer, 0, sizeof(UniformBufferObject))
+		};
+		//the bindless set layout has no texture binding, the texture goes in the bindless array instead
+		if (!useBindless)
 		{
-			THROW("failed to allocate descriptor set!")
+			bindings.push_back(DescriptorCache::Binding::combinedImageSampler(1, modelTextureView(), textureSampler));
 		}
+		return bindings;
+	}
+
+	VkImageView modelTextureView() const
+	{
+		return streamedTextures.empty() ? textureImageView : streamedTextures[0].imageView;
+	}
 
-		//configure inner descriptors
-		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = uniformBuffer;
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
+	void registerBindlessTextures()
+	{
+		if (!useBindless) return;
+
+		bindlessTextures.setSampler(textureSampler);
+		modelTextureIndex = bindlessTextures.add(modelTextureView());
+	}
 
-		VkDescriptorImageInfo imageInfo = {};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = textureImageView;
-		imageInfo.sampler = textureSampler;
+	//for when the model texture's view is replaced, the frames in flight are still sampling the old slot so it can't be written
+		//the view goes in a spare slot and the instances are pointed at that instead
+		//the instance copy is ordered behind those frames on graphicsQueue, and the old slot is freed once they're done
+	void swapModelTextureSlot(VkImageView imageView)
+	{
+		SubmitScheduler::Ticket lastFrame = scheduler.last(graphicsSubmitQueue);
+		uint32_t oldIndex = modelTextureIndex;
+		modelTextureIndex = bindlessTextures.add(imageView);
 
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = descriptorSet;
-		descriptorWrites[0].dstBinding = 0;	//binding index in shader
-		descriptorWrites[0].dstArrayElement = 0;	//first index in the array to update
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;	//used for descriptors with buffer data
-		descriptorWrites[0].pImageInfo = nullptr;	//Optional: used for descriptors using image data
-		descriptorWrites[0].pTexelBufferView = nullptr;	//Optional: used for descriptors using buffer views
+		for (InstanceData& instance : sceneInstances)
+		{
+			if (instance.materialIndex == oldIndex)
+			{
+				instance.materialIndex = modelTextureIndex;
+			}
+		}
 
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = descriptorSet;
-		descriptorWrites[1].dstBinding = 1;	//binding index in shader
-		descriptorWrites[1].dstArrayElement = 0;	//first index in the array to update
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+		//only the vertex stage reads the instances, so unlike uploadSceneInstances nothing on computeQueue has to wait for it
+		if (!sceneInstances.empty())
+		{
+			uploadToBuffer(sceneInstances.data(), sizeof(InstanceData) * sceneInstances.size(), instanceBuffer);
+		}
 
-		//can take a VkWriteDescriptorSet or VkCopyDescriptorSet
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		scheduler.defer(lastFrame, [this, oldIndex]() {
+			bindlessTextures.remove(oldIndex);
+		});
 	}
 
 #pragma region Texture Functions
 
+	//decoding the jpeg is the slowest part of startup and doesn't need vulkan, so it runs on a worker thread
+	//if the texture has been baked we only map the files and skip decoding entirely
+		//mapping is cheap, so every variant is opened and the device picks between them later
+	void loadTexturePixels()
+	{
+		bool anyBaked = false;
+		bakedTextures.resize(BAKED_TEXTURE_FORMATS.size());
+		for (size_t i = 0; i < BAKED_TEXTURE_FORMATS.size(); i++)
+		{
+			std::unique_ptr<TextureFile::Reader> reader(new TextureFile::Reader());
+			if (reader->open(bakedTexturePath(BAKED_TEXTURE_BASE, BAKED_TEXTURE_FORMATS[i])))
+			{
+				bakedTextures[i] = std::move(reader);
+				anyBaked = true;
+			}
+		}
+
+		if (anyBaked) return;
+
+		std::cout << "no baked texture found, decoding " << TEXTURE_PATH
+			<< " (run with --bake to skip this)" << std::endl;
+
+		decodeTexturePixels();
+	}
+
+	void decodeTexturePixels()
+	{
+		int texChannels;
+		texturePixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+		if (!texturePixels)
+		{
+			THROW("failed to load texture image")
+		}
+	}
+
 	void createTextureImage()
 	{
-		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		for (size_t i = 0; i < bakedTextures.size(); i++)
+		{
+			//a block compressed format can only be used if the device can sample and filter it
+			if (bakedTextures[i] && isFormatSupported(BAKED_TEXTURE_FORMATS[i], VK_IMAGE_TILING_OPTIMAL,
+				VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+			{
+				createTextureImageFromBaked(*bakedTextures[i]);
+				bakedTextures.clear();
+				return;
+			}
+		}
+
+		//none of the baked variants work on this device
+		bakedTextures.clear();
+		if (!texturePixels)
+		{
+			decodeTexturePixels();
+		}
+
+		stbi_uc* pixels = texturePixels;
 		//pixels are laid out row by row with 4 bytes per pixel with STBI_rgb_alpha
 		VkDeviceSize imageSize = texWidth * texHeight * 4;
 		//calculate the number of levels of the mip chain
@@ -1934,11 +3137,19 @@ private:
 			//add 1 for the original image
 		mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
 
-		if (!pixels)
+		//recordBlitMipmaps blits with VK_FILTER_LINEAR, which the format has to support
+		bool canBlit = isFormatSupported(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+		bool canCompute = canGenerateMipmapsOnCompute(VK_FORMAT_R8G8B8A8_UNORM, texWidth, texHeight, mipLevels);
+
+		if (mipGenMode == MipGenMode::Cpu || (!canBlit && !canCompute))
 		{
-			THROW("failed to load texture image")
+			createTextureImageWithCpuMipmaps();
+			return;
 		}
 
+		bool useCompute = canCompute && (mipGenMode == MipGenMode::Compute || !canBlit);
+
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingBufferMemory;
 
@@ -1952,34 +3163,245 @@ private:
 		vkUnmapMemory(device, stagingBufferMemory);
 
 		stbi_image_free(pixels);
+		texturePixels = nullptr;
 
 		createImage(texWidth, texHeight, mipLevels, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+			| (useCompute ? VK_IMAGE_USAGE_STORAGE_BIT : 0),
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
 
-		transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+		Downsampler::Target target;
+		if (useCompute)
+		{
+			target = createMipmapTarget(textureImage, VK_FORMAT_R8G8B8A8_UNORM, texWidth, texHeight, mipLevels);
+		}
+
+		//the copy, the mip chain and every layout change between them go in one submission
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
-		//image was created with VK_IMAGE_LAYOUT_UNDEFINED layout, so we use that as the old layout
-		copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+		//only level 0 is copied to, the mipmap generation transitions the others when it gets to them
+		barrierTracker.trackImage(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+		barrierTracker.useImage(textureImage, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		barrierTracker.flush(commandBuffer);
 
-		//To start sampling from the texture image in the shader
-			//transition to prepare it for shader access
-			//removing for Mipmap generation
-		/*transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);*/
+		copyBufferToImage(commandBuffer, stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 
 		//now instead of just sending it, create mipmaps
 			//now the texture's mipmaps are completely filled
-		generateMipmaps(textureImage, texWidth, texHeight, mipLevels);
+		if (useCompute)
+		{
+			recordComputeMipmaps(commandBuffer, textureImage, target, mipLevels);
+		}
+		else
+		{
+			recordBlitMipmaps(commandBuffer, textureImage, texWidth, texHeight, mipLevels);
+		}
+
+		endSingleTimeCommands(commandBuffer);
+
+		if (useCompute)
+		{
+			downsampler.destroyTarget(target);
+		}
+
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingBufferMemory, nullptr);
+	}
+
+	//every mip level is already in the file, so this is one memcpy, one copy command and no blits
+	void createTextureImageFromBaked(TextureFile::Reader& bakedTexture)
+	{
+		const TextureFile::Header& header = bakedTexture.getHeader();
+		textureFormat = static_cast<VkFormat>(header.format);
+		mipLevels = header.mipLevels;
+
+		VkDeviceSize imageSize = header.dataSize;
+
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+
+		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer, stagingBufferMemory);
+
+		//the levels are laid out in the file exactly as they need to be in the staging buffer
+		void* data;
+		vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+		memcpy(data, bakedTexture.getData(), static_cast<size_t>(imageSize));
+		vkUnmapMemory(device, stagingBufferMemory);
+
+		createImage(header.width, header.height, mipLevels, textureFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+
+		std::vector<VkBufferImageCopy> regions(mipLevels);
+		for (uint32_t i = 0; i < mipLevels; i++)
+		{
+			const TextureFile::Level& level = bakedTexture.getLevel(i);
+
+			regions[i] = {};
+			regions[i].bufferOffset = level.offset;
+			regions[i].bufferRowLength = 0;
+			regions[i].bufferImageHeight = 0;
+			regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[i].imageSubresource.mipLevel = i;
+			regions[i].imageSubresource.baseArrayLayer = 0;
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].imageOffset = { 0,0,0 };
+			regions[i].imageExtent = { level.width, level.height, 1 };
+		}
+
+		uploadTextureLevels(stagingBuffer, textureImage, mipLevels, regions);
+
+		//done with the mapping
+		bakedTexture.close();
+
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingBufferMemory, nullptr);
+	}
+
+	//builds the mip chain on the CPU and uploads every level with one copy
+	//slower to start up than blitting, but works on any device and filters in linear space
+	void createTextureImageWithCpuMipmaps()
+	{
+		std::cout << "generating mipmaps on the CPU" << std::endl;
+
+		std::vector<std::vector<uint8_t>> levels = MipGenerator::generate(texturePixels,
+			static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), MipGenerator::Settings(), &threadPool);
+
+		stbi_image_free(texturePixels);
+		texturePixels = nullptr;
+
+		textureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		mipLevels = static_cast<uint32_t>(levels.size());
+
+		//pack the levels into one staging buffer, keeping every offset a multiple of the texel size
+		std::vector<VkDeviceSize> offsets(mipLevels);
+		VkDeviceSize imageSize = 0;
+		for (uint32_t i = 0; i < mipLevels; i++)
+		{
+			offsets[i] = imageSize;
+			imageSize = TextureFile::alignUp(imageSize + levels[i].size(), TextureFile::LEVEL_ALIGNMENT);
+		}
+
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+
+		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer, stagingBufferMemory);
+
+		void* data;
+		vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+		for (uint32_t i = 0; i < mipLevels; i++)
+		{
+			memcpy(static_cast<uint8_t*>(data) + offsets[i], levels[i].data(), levels[i].size());
+		}
+		vkUnmapMemory(device, stagingBufferMemory);
+
+		createImage(texWidth, texHeight, mipLevels, textureFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+
+		std::vector<VkBufferImageCopy> regions(mipLevels);
+		for (uint32_t i = 0; i < mipLevels; i++)
+		{
+			regions[i] = {};
+			regions[i].bufferOffset = offsets[i];
+			regions[i].bufferRowLength = 0;
+			regions[i].bufferImageHeight = 0;
+			regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[i].imageSubresource.mipLevel = i;
+			regions[i].imageSubresource.baseArrayLayer = 0;
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].imageOffset = { 0,0,0 };
+			regions[i].imageExtent = { std::max(1u, static_cast<uint32_t>(texWidth) >> i), std::max(1u, static_cast<uint32_t>(texHeight) >> i), 1 };
+		}
+
+		uploadTextureLevels(stagingBuffer, textureImage, mipLevels, regions);
 
 		vkDestroyBuffer(device, stagingBuffer, nullptr);
 		vkFreeMemory(device, stagingBufferMemory, nullptr);
 	}
 
+	static std::string bakedTexturePath(const std::string& basePath, VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC7_UNORM_BLOCK: return basePath + ".bc7.vktx";
+		case VK_FORMAT_BC3_UNORM_BLOCK: return basePath + ".bc3.vktx";
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return basePath + ".bc1.vktx";
+		default: return basePath + ".vktx";
+		}
+	}
+
+	//decode the source image, build the full mip chain on the CPU and write out a .vktx per format:
+		//uncompressed RGBA8, which every device can use
+		//BC7
+		//BC1, or BC3 if the image has any alpha
+	void bakeTexture(const std::string& sourcePath, const std::string& bakedBasePath, BlockCompression::Quality quality,
+		MipGenerator::Filter mipFilter)
+	{
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load(sourcePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+		if (!pixels)
+		{
+			THROW("failed to load texture image")
+		}
+
+		MipGenerator::Settings mipSettings;
+		mipSettings.filter = mipFilter;
+
+		std::vector<std::vector<uint8_t>> levels = MipGenerator::generate(pixels, width, height, mipSettings, &threadPool);
+		stbi_image_free(pixels);
+
+		TextureFile::write(bakedTexturePath(bakedBasePath, VK_FORMAT_R8G8B8A8_UNORM), VK_FORMAT_R8G8B8A8_UNORM, width, height, levels);
+
+		bool alpha = BlockCompression::hasAlpha(levels[0].data(), levels[0].size() / 4);
+		bakeCompressedTexture(bakedBasePath, width, height, levels, BlockCompression::Format::BC7, quality);
+		bakeCompressedTexture(bakedBasePath, width, height, levels,
+			alpha ? BlockCompression::Format::BC3 : BlockCompression::Format::BC1, quality);
+
+		std::cout << "baked " << sourcePath << " (" << levels.size() << " mip levels, "
+			<< MipGenerator::filterName(mipFilter) << " filter)" << std::endl;
+	}
+
+	//compresses every level and reports the PSNR of the top level against the uncompressed image
+	void bakeCompressedTexture(const std::string& bakedBasePath, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels, BlockCompression::Format format, BlockCompression::Quality quality)
+	{
+		VkFormat vkFormat = format == BlockCompression::Format::BC7 ? VK_FORMAT_BC7_UNORM_BLOCK
+			: format == BlockCompression::Format::BC3 ? VK_FORMAT_BC3_UNORM_BLOCK
+			: VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		std::vector<std::vector<uint8_t>> compressedLevels(levels.size());
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			uint32_t levelWidth = std::max(1u, width >> i);
+			uint32_t levelHeight = std::max(1u, height >> i);
+			compressedLevels[i] = BlockCompression::compress(levels[i].data(), levelWidth, levelHeight, format, quality, &threadPool);
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		std::vector<uint8_t> decoded = BlockCompression::decompress(compressedLevels[0].data(), width, height, format);
+		double psnr = BlockCompression::computePSNR(levels[0].data(), decoded.data(), static_cast<size_t>(width) * height,
+			format == BlockCompression::Format::BC3);
+
+		std::string path = bakedTexturePath(bakedBasePath, vkFormat);
+		TextureFile::write(path, vkFormat, width, height, compressedLevels);
+
+		std::cout << "\t" << path << ": " << BlockCompression::formatName(format) << " " << BlockCompression::qualityName(quality)
+			<< ", " << std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count() << " ms, "
+			<< "PSNR " << psnr << " dB" << std::endl;
+	}
+
 	void createTextureImageView()
 	{
-		textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+		textureImageView = createImageView(textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 	}
 
 	void createTextureSampler()
@@ -2076,99 +3498,9 @@ private:
 		vkBindImageMemory(device, image, imageMemory, 0);
 	}
 
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
-	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		//common way to perform layout transitions is using an image memory barrier
-			//pipeline barrier generally used to synchronize access to resources
-			//can be used to transition image layouts and transfer queue family ownership when VK_SHARING_MODE_EXCLUSIVE is used
-		VkImageMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		//these two specify layout transition
-			//if you don't care about the existing contents you can use VK_IMAGE_LAYOUT_UNDEFINED
-		barrier.oldLayout = oldLayout;
-		barrier.newLayout = newLayout;
-		//if using a barrier to transfer queue family ownership, then these should be the indicies of the queue families
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		//specifies the image that is affected and the specific part of the image
-		barrier.image = image;
-
-		if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-		{
-			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-			if (hasStencilComponent(format))
-			{
-				barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-			}
-		}
-		else
-		{
-			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		}
-
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = mipLevels;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-		barrier.srcAccessMask = 0;	//TODO
-		barrier.dstAccessMask = 0;	//TODO
-
-		VkPipelineStageFlags sourceStage;
-		VkPipelineStageFlags destinationStage;
-
-		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-			newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-		{
-			//since we aren't waiting on anything
-				//we can have a NULL access mask
-				//earliest stage to access is the top of the pipeline
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		}
-		else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-			newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-		{
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		}
-		else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-			newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-		{
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
-				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		}
-		else
-		{
-			throw std::invalid_argument("unsupported layout transition!");
-		}
-
-		//since barriers are synchronization primitives
-		//must specify which types of operations involing the resource happen before and after the barrier
-			//the right values depend on the old and new layout
-		vkCmdPipelineBarrier(commandBuffer,
-			sourceStage, destinationStage,
-			0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		endSingleTimeCommands(commandBuffer);
-	}
-
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+	//the image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL by the time the copy runs
+	void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
 	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
 		//specify which part of the buffer is going to be copied to which part of the image
 		VkBufferImageCopy region = {};
 		region.bufferOffset = 0;
@@ -2185,6 +3517,30 @@ private:
 
 		vkCmdCopyBufferToImage(commandBuffer, buffer, image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	//same as above, but with any number of regions in a single copy command
+		//used to upload every mip level at once
+	void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy>& regions)
+	{
+		vkCmdCopyBufferToImage(commandBuffer, buffer, image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	}
+
+	//starts tracking a new image and fills all of its levels from the staging buffer, leaving it ready to sample
+		//the transition, the copy and the transition after it are one submission
+	void uploadTextureLevels(VkBuffer stagingBuffer, VkImage image, uint32_t levelCount, const std::vector<VkBufferImageCopy>& regions)
+	{
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+		barrierTracker.trackImage(image, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+		barrierTracker.useImage(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		barrierTracker.flush(commandBuffer);
+
+		copyBufferToImage(commandBuffer, stagingBuffer, image, regions);
+
+		barrierTracker.useImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		barrierTracker.flush(commandBuffer);
 
 		endSingleTimeCommands(commandBuffer);
 	}
@@ -2214,34 +3570,19 @@ private:
 		return imageView;
 	}
 
-	void generateMipmaps(VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
+	//level 0 has to be tracked by barrierTracker with its contents in it, the other levels' contents don't matter
+	//every level ends in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	void recordBlitMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
 	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-		
-		VkImageMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.image = image;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-		barrier.subresourceRange.levelCount = 1;
-
 		int32_t mipWidth = texWidth;
 		int32_t mipHeight = texHeight;
 
 		for (uint32_t i = 1; i < mipLevels; i++)
 		{
-			barrier.subresourceRange.baseMipLevel = i - 1;
-			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-			vkCmdPipelineBarrier(commandBuffer,
-				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-				0, nullptr, 0, nullptr, 1, &barrier);
+			//level i-1 is read now that it's written, level i is about to be written, both are in one barrier
+			barrierTracker.useImage(image, i - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+			barrierTracker.useImage(image, i, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+			barrierTracker.flush(commandBuffer);
 
 			//now we specify the regions used in the blit operation
 			//source mip level is i-1 and destination mip level is i
@@ -2263,16 +3604,6 @@ private:
 			vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 				image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 				1, &blit, VK_FILTER_LINEAR);
-			
-			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			
-			//transitions mip level i-1 to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			vkCmdPipelineBarrier(commandBuffer,
-				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-				0, nullptr, 0, nullptr, 1, &barrier);
 
 			//makes sure the dimensions never become 0
 				//important for non-square images
@@ -2280,149 +3611,1793 @@ private:
 			if (mipHeight > 1) mipHeight /= 2;
 		}
 
-		barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		//transitions the last mip level from VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			//since this wasn't handled in the above loop
-		vkCmdPipelineBarrier(commandBuffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-			0, nullptr, 0, nullptr, 1, &barrier);
-
-		endSingleTimeCommands(commandBuffer);
+		//every level but the last is in TRANSFER_SRC_OPTIMAL and the last is in TRANSFER_DST_OPTIMAL
+			//so this is one batch of two barriers instead of one barrier per level
+		barrierTracker.useImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		barrierTracker.flush(commandBuffer);
 	}
 
-#pragma endregion
-
-#pragma region Depth Buffer Functions
-
-	void createDepthResources()
+	//the single pass downsampler needs the SPIR-V, storage image support and a graphics queue that can run compute
+	bool canGenerateMipmapsOnCompute(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
 	{
-		VkFormat depthFormat = findDepthFormat();
+		if (downsampleShaderCode.empty() || mipLevels < 2 || !Downsampler::canDownsample(width, height, mipLevels - 1))
+		{
+			return false;
+		}
+
+		if (!isFormatSupported(format, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT))
+		{
+			return false;
+		}
 
-		createImage(swapChainExtent.width, swapChainExtent.height, 1,
-			depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
-		depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
-		//we could do this in the render pass, but since we are only doing this once
-			//we will just use a pipeline barrier
-		transitionImageLayout(depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+		return (queueFamilies[indices.graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
 	}
 
-	bool hasStencilComponent(VkFormat format)
+	//level 0 of the image is the source and levels 1 and up are written
+	Downsampler::Target createMipmapTarget(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
 	{
-		return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
-			format == VK_FORMAT_D24_UNORM_S8_UINT;
-	}
+		if (!downsampler.isInitialized())
+		{
+			downsampler.init(physicalDevice, device, downsampleShaderCode, downsampleDepthShaderCode);
+		}
 
-	VkFormat findDepthFormat()
-	{
-		return findSupportedFormat(
-		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-		);
+		Downsampler::TargetInfo targetInfo = {};
+		targetInfo.source = image;
+		targetInfo.sourceFormat = format;
+		targetInfo.sourceAspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		targetInfo.sourceLevel = 0;
+		targetInfo.sourceWidth = width;
+		targetInfo.sourceHeight = height;
+		targetInfo.destination = image;
+		targetInfo.destinationFormat = format;
+		targetInfo.destinationBaseLevel = 1;
+		targetInfo.mipCount = mipLevels - 1;
+		targetInfo.variant = Downsampler::Variant::Color;
+
+		return downsampler.createTarget(targetInfo);
 	}
 
-	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,
-		VkImageTiling tiling, VkFormatFeatureFlags features)
+	//same job as recordBlitMipmaps, but the whole chain comes from one compute dispatch
+	//the image needs VK_IMAGE_USAGE_STORAGE_BIT, layouts match recordBlitMipmaps
+	void recordComputeMipmaps(VkCommandBuffer commandBuffer, VkImage image, const Downsampler::Target& target, uint32_t mipLevels)
 	{
-		for (VkFormat format : candidates)
-		{
-			VkFormatProperties props;
-			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+		//level 0 is sampled and the rest are written as storage images
+		barrierTracker.useImage(image, 0, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		barrierTracker.useImage(image, 1, mipLevels - 1, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		barrierTracker.flush(commandBuffer);
 
-			if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features)
-			{
-				return format;
-			}
-			else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features)
-			{
-				return format;
-			}
+		//the texture is sRGB encoded data in a UNORM image, so average it in linear space
+		downsampler.record(commandBuffer, target, Downsampler::Reduction::Average, true);
 
-			THROW("failed to find supported format!")
-			//the below is just there so the compiler stops yelling
-			return VK_FORMAT_UNDEFINED;
-		}
+		barrierTracker.useImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		barrierTracker.flush(commandBuffer);
 	}
 
 #pragma endregion
 
-	void loadModel()
-	{
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string err;
-
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, MODEL_PATH.c_str()))
-		{
-			THROW(err)
-		}
+#pragma region Texture Streaming Functions
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+	//takes over the baked variant createTextureImage would have picked and uploads only its mip tail
+	//returns false if streaming is off or nothing baked can be used, createTextureImage handles those
+	bool createStreamedTextures()
+	{
+		if (!streamTextures) return false;
 
-		//tinyobj has a triangulate feature, so we assume all faces are tris
-		for (const auto& shape : shapes)
+		for (size_t i = 0; i < bakedTextures.size(); i++)
 		{
-			for (const auto& index : shape.mesh.indices)
+			if (bakedTextures[i] && isFormatSupported(BAKED_TEXTURE_FORMATS[i], VK_IMAGE_TILING_OPTIMAL,
+				VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
 			{
-				Vertex vertex = {};
-
-				//it is an array of float values rather than vec3s so you multiply by 3
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
+				StreamedTexture texture;
+				texture.format = BAKED_TEXTURE_FORMATS[i];
+				texture.file = std::move(bakedTextures[i]);
 
-				//same as with verts, there are 2 texture components per entry, so we multiply by 2
-				vertex.texCoord = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-				};
+				uint32_t tail = TextureStreaming::tailLevel(*texture.file, STREAMING_TAIL_SIZE);
+				textureScheduler.addTexture(texture.file.get(), tail);
 
-				vertex.color = { 1.0f, 1.0f, 1.0f };
+				textureFormat = texture.format;
+				mipLevels = texture.file->getHeader().mipLevels;
 
-				if (uniqueVertices.count(vertex) == 0)
-				{
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
-				}
+				streamedTextures.push_back(std::move(texture));
+				uploadStreamedLevels(streamedTextures.back(), tail);
 
-				indices.push_back(uniqueVertices[vertex]);
+				bakedTextures.clear();
+				return true;
 			}
 		}
+
+		return false;
 	}
 
-};
+	//image for levels [firstLevel, mipLevels) of a streamed texture, its level 0 is the file's firstLevel
+	void createStreamedImage(const StreamedTexture& texture, uint32_t firstLevel, VkImage& image, VkDeviceMemory& imageMemory)
+	{
+		const TextureFile::Level& level = texture.file->getLevel(firstLevel);
 
-#pragma region Helpful Advice for Real Apps
+		//transfer source so the levels can be copied across when the image is replaced
+		createImage(level.width, level.height, texture.file->getHeader().mipLevels - firstLevel, texture.format,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+	}
 
-/*
-All of the helper functions that submit commands so far have been set up to execute synchronously
-by waiting for the queue to become idle. For practical applications it is recommended to combine
-these operations in a single command buffer and execute them asynchronously for higher throughput,
-especially the transitions and copy in the createTextureImage function. Try to experiment
-with this by creating a setupCommandBuffer that the helper functions record commands into,
-and add a flushSetupCommands to execute the commands that have been recorded so far.
-It's best to do this after the texture mapping works to check if the texture resources are still set up correctly.
-*/
+	//copy regions for levels [firstLevel, mipLevels) from a staging buffer that starts at firstLevel's offset in the file
+	std::vector<VkBufferImageCopy> streamedLevelRegions(const StreamedTexture& texture, uint32_t firstLevel)
+	{
+		uint32_t levelCount = texture.file->getHeader().mipLevels - firstLevel;
+		VkDeviceSize baseOffset = texture.file->getLevel(firstLevel).offset;
 
-//In a game with the state changin every frame the most efficient way is:
+		std::vector<VkBufferImageCopy> regions(levelCount);
+		for (uint32_t i = 0; i < levelCount; i++)
+		{
+			const TextureFile::Level& level = texture.file->getLevel(firstLevel + i);
+
+			regions[i] = {};
+			regions[i].bufferOffset = level.offset - baseOffset;
+			regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[i].imageSubresource.mipLevel = i;
+			regions[i].imageSubresource.baseArrayLayer = 0;
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].imageOffset = { 0,0,0 };
+			regions[i].imageExtent = { level.width, level.height, 1 };
+		}
+		return regions;
+	}
 
-/*
-void drawFrame() {
-	updateAppState();
+	//levels are stored largest first, so [firstLevel, mipLevels) is one contiguous block of the file
+	void uploadStreamedLevels(StreamedTexture& texture, uint32_t firstLevel)
+	{
+		const TextureFile::Header& header = texture.file->getHeader();
+		uint32_t levelCount = header.mipLevels - firstLevel;
+		VkDeviceSize baseOffset = texture.file->getLevel(firstLevel).offset;
+		VkDeviceSize imageSize = header.dataSize - baseOffset;
 
-	vkQueueWaitIdle(presentQueue);
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+
+		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer, stagingBufferMemory);
+
+		void* data;
+		vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+		memcpy(data, texture.file->getData() + baseOffset, static_cast<size_t>(imageSize));
+		vkUnmapMemory(device, stagingBufferMemory);
+
+		createStreamedImage(texture, firstLevel, texture.image, texture.imageMemory);
+
+		uploadTextureLevels(stagingBuffer, texture.image, levelCount, streamedLevelRegions(texture, firstLevel));
+
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+		texture.imageView = createImageView(texture.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+		texture.residentLevel = firstLevel;
+	}
+
+	//once per frame: finished loads go to the GPU, then the scheduler picks what to load or evict next
+	//returns whether the textures are still changing, the frames have to keep coming until they settle
+	bool updateTextureStreaming()
+	{
+		if (streamedTextures.empty()) return false;
+
+		bool applied = false;
+
+		frameNumber++;
+		//the model is the only thing drawn and it uses texture 0
+		textureScheduler.markVisible(0, estimateScreenCoverage(), frameNumber);
+
+		TextureStreaming::Loader::Job job;
+		while (textureLoader.pollFinished(job))
+		{
+			if (useTransferQueue)
+			{
+				submitStreamingUpload(job.texture, job.level);
+			}
+			else
+			{
+				applyStreamingChange(job.texture, job.level);
+				textureScheduler.completeChange({ job.texture, job.level });
+				applied = true;
+			}
+		}
+		if (useTransferQueue)
+		{
+			finishStreamingUploads();
+		}
+
+		for (const TextureStreaming::Change& change : textureScheduler.update(frameNumber))
+		{
+			StreamedTexture& texture = streamedTextures[change.texture];
+
+			if (change.residentLevel < texture.residentLevel || useTransferQueue)
+			{
+				//reading the level out of the file is the slow part, so the loader thread does it straight into the staging buffer
+					//the transfer queue can't copy out of the old image, which belongs to the graphics queue, so it gets every level
+				const TextureFile::Level& level = texture.file->getLevel(change.residentLevel);
+				VkDeviceSize size = useTransferQueue ? texture.file->getHeader().dataSize - level.offset : level.size;
+
+				createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					texture.stagingBuffer, texture.stagingBufferMemory);
+
+				void* data;
+				vkMapMemory(device, texture.stagingBufferMemory, 0, size, 0, &data);
+
+				TextureStreaming::Loader::Job load = {};
+				load.texture = change.texture;
+				load.level = change.residentLevel;
+				load.source = texture.file->getData() + level.offset;
+				load.size = static_cast<size_t>(size);
+				load.destination = data;
+				textureLoader.submit(load);
+			}
+			else
+			{
+				applyStreamingChange(change.texture, change.residentLevel);
+				textureScheduler.completeChange(change);
+				applied = true;
+			}
+		}
+
+		//the acquires are recorded into the next frame
+		return applied || !streamingAcquires.empty() || textureScheduler.hasPendingChanges();
+	}
+
+	//rough diameter of the model on screen in pixels, from its bounding sphere
+	float estimateScreenCoverage()
+	{
+		glm::vec4 center = viewMatrix * modelMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		float distance = std::max(-center.z, 0.001f);
+
+		//proj[1][1] is 1 / tan(fov / 2), flipped for vulkan's y axis
+		return modelRadius * std::abs(projMatrix[1][1]) / distance * swapChainExtent.height;
+	}
+
+	//vulkan images can't be resized, so moving to a new resident level means a new image
+	//levels both images have are copied on the GPU, a newly loaded level comes from the texture's staging buffer
+	void applyStreamingChange(uint32_t textureIndex, uint32_t newLevel)
+	{
+		StreamedTexture& texture = streamedTextures[textureIndex];
+		uint32_t totalLevels = texture.file->getHeader().mipLevels;
+		bool loading = newLevel < texture.residentLevel;
+
+		VkImage image;
+		VkDeviceMemory imageMemory;
+		createStreamedImage(texture, newLevel, image, imageMemory);
+
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+		//the old image's levels are copied out of, in the same batch as the new one's transition
+		barrierTracker.trackImage(image, VK_IMAGE_ASPECT_COLOR_BIT, totalLevels - newLevel);
+		barrierTracker.useImage(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		barrierTracker.useImage(texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+		barrierTracker.flush(commandBuffer);
+
+		if (loading)
+		{
+			const TextureFile::Level& level = texture.file->getLevel(newLevel);
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0,0,0 };
+			region.imageExtent = { level.width, level.height, 1 };
+
+			vkCmdCopyBufferToImage(commandBuffer, texture.stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+
+		std::vector<VkImageCopy> copies;
+		for (uint32_t level = std::max(newLevel, texture.residentLevel); level < totalLevels; level++)
+		{
+			const TextureFile::Level& info = texture.file->getLevel(level);
+
+			VkImageCopy copy = {};
+			copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture.residentLevel, 0, 1 };
+			copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - newLevel, 0, 1 };
+			copy.srcOffset = { 0,0,0 };
+			copy.dstOffset = { 0,0,0 };
+			copy.extent = { info.width, info.height, 1 };
+			copies.push_back(copy);
+		}
+
+		vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+
+		barrierTracker.useImage(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		barrierTracker.flush(commandBuffer);
+
+		//nothing waits for the copy, the barriers keep the frames drawn after it from sampling the new image too early
+			//it's submitted after every frame still sampling the old image, so once it's done they are too
+		SubmitScheduler::Ticket copied = submitSingleTimeCommands(commandBuffer);
+
+		VkImage oldImage = texture.image;
+		VkDeviceMemory oldImageMemory = texture.imageMemory;
+		VkImageView oldImageView = texture.imageView;
+		//freeing mapped memory unmaps it, the buffers are null unless loading
+		VkBuffer stagingBuffer = texture.stagingBuffer;
+		VkDeviceMemory stagingBufferMemory = texture.stagingBufferMemory;
+		texture.stagingBuffer = VK_NULL_HANDLE;
+		texture.stagingBufferMemory = VK_NULL_HANDLE;
+		scheduler.defer(copied, [this, oldImage, oldImageMemory, oldImageView, stagingBuffer, stagingBufferMemory]() {
+			vkDestroyImageView(device, oldImageView, nullptr);
+			barrierTracker.untrackImage(oldImage);
+			vkDestroyImage(device, oldImage, nullptr);
+			vkFreeMemory(device, oldImageMemory, nullptr);
+			vkDestroyBuffer(device, stagingBuffer, nullptr);
+			vkFreeMemory(device, stagingBufferMemory, nullptr);
+		});
+
+		texture.image = image;
+		texture.imageMemory = imageMemory;
+		texture.imageView = createImageView(image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, totalLevels - newLevel);
+		texture.residentLevel = newLevel;
+
+		if (useBindless && textureIndex == 0)
+		{
+			swapModelTextureSlot(texture.imageView);
+		}
+		//without bindless textures there's nothing to do, each frame's set is pointed at the new view once the frame comes round again
+
+		printStreamingChange(textureIndex);
+	}
+
+	void printStreamingChange(uint32_t textureIndex)
+	{
+		const StreamedTexture& texture = streamedTextures[textureIndex];
+		const TextureFile::Level& top = texture.file->getLevel(texture.residentLevel);
+		std::cout << "streamed texture " << textureIndex << " to " << top.width << "x" << top.height << ", "
+			<< textureScheduler.getUsedBytes() / (1024 * 1024) << "/" << textureScheduler.getBudget() / (1024 * 1024)
+			<< " MB of texture budget" << std::endl;
+	}
+
+	//copies levels [newLevel, mipLevels) from the texture's staging buffer into a new image on transferQueue
+		//the image is released to the graphics family in SHADER_READ_ONLY_OPTIMAL
+		//nothing waits for it here, finishStreamingUploads hands it to a frame once the copy is done
+	void submitStreamingUpload(uint32_t textureIndex, uint32_t newLevel)
+	{
+		StreamedTexture& texture = streamedTextures[textureIndex];
+		uint32_t levelCount = texture.file->getHeader().mipLevels - newLevel;
+
+		StreamingUpload upload = {};
+		upload.texture = textureIndex;
+		upload.level = newLevel;
+		createStreamedImage(texture, newLevel, upload.image, upload.imageMemory);
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = transferCommandPool;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &upload.commandBuffer) != VK_SUCCESS)
+		{
+			THROW("failed to allocate streaming upload command buffer!")
+		}
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(upload.commandBuffer, &beginInfo);
+
+		barrierTracker.trackImage(upload.image, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+		barrierTracker.useImage(upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		barrierTracker.flush(upload.commandBuffer);
+
+		copyBufferToImage(upload.commandBuffer, texture.stagingBuffer, upload.image, streamedLevelRegions(texture, newLevel));
+
+		barrierTracker.releaseImage(upload.image, transferQueueFamily, graphicsQueueFamily, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		barrierTracker.flush(upload.commandBuffer);
+
+		vkEndCommandBuffer(upload.commandBuffer);
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &upload.semaphore) != VK_SUCCESS)
+		{
+			THROW("failed to create streaming upload semaphore!")
+		}
+
+		upload.ticket = scheduler.submit(transferSubmitQueue, { upload.commandBuffer }, {}, { upload.semaphore });
+		streamingUploads.push_back(upload);
+	}
+
+	//once per frame with a transfer queue: swaps in the images whose copies are done
+		//the swapped in images are acquired by the frame recorded next, the images they replace are still sampled by frames in flight
+	void finishStreamingUploads()
+	{
+		for (size_t i = 0; i < streamingUploads.size();)
+		{
+			if (!scheduler.isDone(streamingUploads[i].ticket))
+			{
+				i++;
+				continue;
+			}
+
+			StreamingUpload upload = streamingUploads[i];
+			streamingUploads.erase(streamingUploads.begin() + i);
+
+			StreamedTexture& texture = streamedTextures[upload.texture];
+			uint32_t levelCount = texture.file->getHeader().mipLevels - upload.level;
+
+			//freeing mapped memory unmaps it
+			vkDestroyBuffer(device, texture.stagingBuffer, nullptr);
+			vkFreeMemory(device, texture.stagingBufferMemory, nullptr);
+			texture.stagingBuffer = VK_NULL_HANDLE;
+			texture.stagingBufferMemory = VK_NULL_HANDLE;
+
+			VkImage oldImage = texture.image;
+			VkDeviceMemory oldImageMemory = texture.imageMemory;
+			VkImageView oldImageView = texture.imageView;
+			//the last frame submitted is the last one that samples the old image
+			scheduler.defer(scheduler.last(graphicsSubmitQueue), [this, oldImage, oldImageMemory, oldImageView]() {
+				vkDestroyImageView(device, oldImageView, nullptr);
+				barrierTracker.untrackImage(oldImage);
+				vkDestroyImage(device, oldImage, nullptr);
+				vkFreeMemory(device, oldImageMemory, nullptr);
+			});
+
+			texture.image = upload.image;
+			texture.imageMemory = upload.imageMemory;
+			texture.imageView = createImageView(upload.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+			texture.residentLevel = upload.level;
+
+			if (useBindless && upload.texture == 0)
+			{
+				swapModelTextureSlot(texture.imageView);
+			}
+
+			streamingAcquires.push_back(upload);
+			printStreamingChange(upload.texture);
+			textureScheduler.completeChange({ upload.texture, upload.level });
+		}
+	}
+
+	void destroyStreamedTextures()
+	{
+		//the loader may still be copying into a staging buffer
+		textureLoader.waitIdle();
+
+		//uploads may still be copying, and the images they replace still waiting on frames
+		scheduler.waitAll();
+		scheduler.collect();
+
+		for (StreamingUpload& upload : streamingUploads)
+		{
+			barrierTracker.untrackImage(upload.image);
+			vkDestroyImage(device, upload.image, nullptr);
+			vkFreeMemory(device, upload.imageMemory, nullptr);
+			vkDestroySemaphore(device, upload.semaphore, nullptr);
+			vkFreeCommandBuffers(device, transferCommandPool, 1, &upload.commandBuffer);
+		}
+		streamingUploads.clear();
+
+		//the image already belongs to its texture and is destroyed with it below
+		for (StreamingUpload& upload : streamingAcquires)
+		{
+			vkDestroySemaphore(device, upload.semaphore, nullptr);
+			vkFreeCommandBuffers(device, transferCommandPool, 1, &upload.commandBuffer);
+		}
+		streamingAcquires.clear();
+
+		for (StreamedTexture& texture : streamedTextures)
+		{
+			vkDestroyImageView(device, texture.imageView, nullptr);
+			barrierTracker.untrackImage(texture.image);
+			vkDestroyImage(device, texture.image, nullptr);
+			vkFreeMemory(device, texture.imageMemory, nullptr);
+			vkDestroyBuffer(device, texture.stagingBuffer, nullptr);
+			vkFreeMemory(device, texture.stagingBufferMemory, nullptr);
+		}
+
+		streamedTextures.clear();
+	}
+
+#pragma endregion
+
+#pragma region Depth Buffer Functions
+
+	//each level 0 texel is the farthest of a 2x2 block of the depth buffer
+		//level 0 is a power of two at least half the depth buffer's size, so every level halves exactly and no last row or column gets dropped
+		//the texels past the depth buffer's edge reduce clamped reads of its last row and column, so they only hold depths that are there
+	//past the downsampler's MAX_SIZE level 0 gets coarser instead, each texel taking a 4x4 (8x8, ...) block
+	void sizeDepthPyramid()
+	{
+		uint32_t width = 1;
+		uint32_t height = 1;
+		while (width * 2 < swapChainExtent.width) width *= 2;
+		while (height * 2 < swapChainExtent.height) height *= 2;
+
+		depthPyramidShift = 0;
+		while (std::max(width, height) * 2 > Downsampler::MAX_SIZE)
+		{
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+			depthPyramidShift++;
+		}
+
+		depthPyramidExtent = { width, height };
+		depthPyramidLevels = std::min(Downsampler::MAX_MIPS, MipGenerator::levelCount(width, height));
+	}
+
+	//the downsampler target that reduces the graph's depth image into its depth pyramid image
+		//the images are sized and made by createFrameGraph
+	void createDepthPyramid()
+	{
+		if (!useOcclusionCulling) return;
+
+		if (!downsampler.isInitialized())
+		{
+			downsampler.init(physicalDevice, device, downsampleShaderCode, downsampleDepthShaderCode);
+		}
+
+		Downsampler::TargetInfo targetInfo = {};
+		targetInfo.source = frameGraph.getImage(depthResource);
+		targetInfo.sourceFormat = findDepthFormat();
+		targetInfo.sourceAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		targetInfo.sourceLevel = 0;
+		//the padded size, the reads past the depth buffer's edge are clamped to it
+		targetInfo.sourceWidth = depthPyramidExtent.width * 2 << depthPyramidShift;
+		targetInfo.sourceHeight = depthPyramidExtent.height * 2 << depthPyramidShift;
+		targetInfo.sourceShift = depthPyramidShift;
+		targetInfo.destination = frameGraph.getImage(depthPyramidResource);
+		targetInfo.destinationFormat = VK_FORMAT_R32_SFLOAT;
+		targetInfo.destinationBaseLevel = 0;
+		targetInfo.mipCount = depthPyramidLevels;
+		targetInfo.variant = Downsampler::Variant::Depth;
+
+		depthPyramidTarget = downsampler.createTarget(targetInfo);
+	}
+
+	//target is a depthPyramidTarget cleanupSwapChain took out
+	void destroyDepthPyramid(Downsampler::Target& target)
+	{
+		if (target.descriptorSet == VK_NULL_HANDLE) return;
+
+		downsampler.destroyTarget(target);
+	}
+
+	//between the early and late draws, the graph has put the depth in SHADER_READ_ONLY_OPTIMAL and the pyramid in GENERAL
+	void buildDepthPyramid(VkCommandBuffer commandBuffer)
+	{
+		//regular z, so the farthest depth is the largest
+		downsampler.record(commandBuffer, depthPyramidTarget, Downsampler::Reduction::Max, false);
+	}
+
+	VkFormat findDepthFormat()
+	{
+		return findSupportedFormat(
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+		);
+	}
+
+	bool isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+		if (tiling == VK_IMAGE_TILING_LINEAR)
+		{
+			return (props.linearTilingFeatures & features) == features;
+		}
+
+		return (props.optimalTilingFeatures & features) == features;
+	}
+
+	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,
+		VkImageTiling tiling, VkFormatFeatureFlags features)
+	{
+		for (VkFormat format : candidates)
+		{
+			VkFormatProperties props;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+			if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features)
+			{
+				return format;
+			}
+			else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features)
+			{
+				return format;
+			}
+
+			THROW("failed to find supported format!")
+			//the below is just there so the compiler stops yelling
+			return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+#pragma endregion
+
+	void loadModel()
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string err;
+
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, MODEL_PATH.c_str()))
+		{
+			THROW(err)
+		}
+
+		std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+
+		//tinyobj has a triangulate feature, so we assume all faces are tris
+		for (const auto& shape : shapes)
+		{
+			for (const auto& index : shape.mesh.indices)
+			{
+				Vertex vertex = {};
+
+				//it is an array of float values rather than vec3s so you multiply by 3
+				vertex.pos = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2]
+				};
+
+				//same as with verts, there are 2 texture components per entry, so we multiply by 2
+				vertex.texCoord = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+				};
+
+				vertex.color = { 1.0f, 1.0f, 1.0f };
+
+				if (uniqueVertices.count(vertex) == 0)
+				{
+					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(vertex);
+				}
+
+				indices.push_back(uniqueVertices[vertex]);
+			}
+		}
+
+		//bounding sphere around the origin, used to estimate how much of the screen the model covers
+		modelRadius = 0.0f;
+		modelBoundsMin = modelBoundsMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].pos;
+		for (const Vertex& vertex : vertices)
+		{
+			modelRadius = std::max(modelRadius, glm::length(vertex.pos));
+			modelBoundsMin = glm::min(modelBoundsMin, vertex.pos);
+			modelBoundsMax = glm::max(modelBoundsMax, vertex.pos);
+		}
+	}
+
+#pragma region Scene Functions
+
+	//SCENE_INSTANCE_COUNT copies of the model in a square grid around the origin, spaced so they don't overlap
+	void buildScene()
+	{
+		sceneInstances.clear();
+		sceneObjects.clear();
+
+		uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(SCENE_INSTANCE_COUNT))));
+		float spacing = modelRadius * 2.0f;
+		float start = -spacing * (side - 1) * 0.5f;
+
+		for (uint32_t i = 0; i < SCENE_INSTANCE_COUNT; i++)
+		{
+			InstanceData instance = {};
+			instance.model = glm::translate(glm::mat4(1.0f),
+				glm::vec3(start + spacing * (i % side), start + spacing * (i / side), 0.0f));
+			instance.materialIndex = useBindless ? modelTextureIndex : 0;
+			sceneInstances.push_back(instance);
+
+			//the model is centered on the origin, so the sphere is centered on the instance's translation
+			GpuCulling::Object object = {};
+			object.boundingSphere[0] = instance.model[3][0];
+			object.boundingSphere[1] = instance.model[3][1];
+			object.boundingSphere[2] = instance.model[3][2];
+			object.boundingSphere[3] = modelRadius;
+			object.indexCount = static_cast<uint32_t>(indices.size());
+			object.firstIndex = 0;
+			object.vertexOffset = 0;
+			object.firstInstance = i;
+			sceneObjects.push_back(object);
+		}
+
+		if (!useGpuCulling)
+		{
+			sceneBvh.clear();
+			for (const InstanceData& instance : sceneInstances)
+			{
+				glm::vec3 boundsMin, boundsMax;
+				SceneBvh::transformBounds(&instance.model[0][0], &modelBoundsMin.x, &modelBoundsMax.x, &boundsMin.x, &boundsMax.x);
+				sceneBvh.add(&boundsMin.x, &boundsMax.x);
+			}
+			sceneBvh.build();
+		}
+
+		if (useSoftwareOcclusion && occluderMesh.indices.empty())
+		{
+			occluderMesh = SoftwareOcclusion::simplify(&vertices[0].pos.x, vertices.size(), sizeof(Vertex),
+				indices.data(), indices.size(), OCCLUDER_GRID_SIZE);
+			softwareOcclusion.resize(SOFTWARE_OCCLUSION_WIDTH, SOFTWARE_OCCLUSION_HEIGHT);
+		}
+	}
+
+	//fills visibleInstanceRuns with the instances that should be drawn this frame, mvp is the frame's DrawConstants::mvp
+	//frustum culled through sceneBvh, then tested against the software occlusion buffer if that's on
+	void cullSceneInstances(const glm::mat4& mvp)
+	{
+		visibleInstanceRuns.clear();
+		visibleInstances.clear();
+		if (sceneInstances.empty()) return;
+
+		//mvp takes the instances' world space to clip space, so the planes come out in the space sceneBvh is in
+		sceneBvh.cull(Frustum::fromMatrix(&mvp[0][0]), visibleInstances, &threadPool);
+		//in instance order, so neighbours that are both visible end up in one draw
+		std::sort(visibleInstances.begin(), visibleInstances.end());
+
+		if (useSoftwareOcclusion)
+		{
+			renderOccluders(mvp);
+		}
+
+		for (uint32_t i : visibleInstances)
+		{
+			if (useSoftwareOcclusion)
+			{
+				glm::mat4 instanceMvp = mvp * sceneInstances[i].model;
+				if (!softwareOcclusion.isBoxVisible(&modelBoundsMin.x, &modelBoundsMax.x, &instanceMvp[0][0])) continue;
+			}
+
+			if (!visibleInstanceRuns.empty() && visibleInstanceRuns.back().first + visibleInstanceRuns.back().count == i)
+			{
+				visibleInstanceRuns.back().count++;
+			}
+			else
+			{
+				visibleInstanceRuns.push_back({ i, 1 });
+			}
+		}
+	}
+
+	//the nearest instances cover the most of the screen, so they're the ones worth drawing as occluders
+	void renderOccluders(const glm::mat4& mvp)
+	{
+		std::vector<std::pair<float, uint32_t>> byDistance;
+		for (uint32_t i : visibleInstances)
+		{
+			byDistance.push_back({ (mvp * sceneInstances[i].model[3]).w, i });
+		}
+		size_t occluderCount = std::min(byDistance.size(), static_cast<size_t>(SOFTWARE_OCCLUDER_COUNT));
+		std::partial_sort(byDistance.begin(), byDistance.begin() + occluderCount, byDistance.end());
+
+		softwareOcclusion.beginFrame();
+		for (size_t i = 0; i < occluderCount; i++)
+		{
+			glm::mat4 occluderMvp = mvp * sceneInstances[byDistance[i].second].model;
+			softwareOcclusion.addOccluder(occluderMesh, &occluderMvp[0][0]);
+		}
+		softwareOcclusion.render(&threadPool);
+	}
+
+	//call again after changing sceneInstances and sceneObjects, the buffers only get recreated when they have to grow
+	void uploadSceneInstances()
+	{
+		if (sceneInstances.empty()) return;
+
+		VkDeviceSize size = sizeof(InstanceData) * sceneInstances.size();
+		VkDeviceSize objectsSize = sizeof(GpuCulling::Object) * sceneObjects.size();
+
+		//computeQueue doesn't wait on graphicsQueue, so with async compute the cull has to wait for the objects on the CPU
+		SubmitScheduler::Ticket objectsUploaded;
+		if (sceneInstances.size() > instanceBufferCapacity)
+		{
+			//the old buffers may still be in use by a frame in flight
+			VkBuffer oldBuffers[] = { instanceBuffer, objectBuffer, visibilityBuffer };
+			VkDeviceMemory oldMemory[] = { instanceBufferMemory, objectBufferMemory, visibilityBufferMemory };
+			scheduler.defer(scheduler.last(graphicsSubmitQueue), [this, oldBuffers, oldMemory]() {
+				for (size_t i = 0; i < 3; i++)
+				{
+					vkDestroyBuffer(device, oldBuffers[i], nullptr);
+					vkFreeMemory(device, oldMemory[i], nullptr);
+				}
+			});
+
+			createDeviceLocalBuffer(sceneInstances.data(), size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				instanceBuffer, instanceBufferMemory);
+			objectsUploaded = createDeviceLocalBuffer(sceneObjects.data(), objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				objectBuffer, objectBufferMemory, true);
+
+			//nothing counts as visible to start with, so the first frame draws everything in the late phase
+				//the early phase reads it on computeQueue with async compute, and it's uploaded after the objects so waiting on it covers both
+			std::vector<uint32_t> visibility(sceneObjects.size(), 0);
+			objectsUploaded = createDeviceLocalBuffer(visibility.data(), sizeof(uint32_t) * visibility.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				visibilityBuffer, visibilityBufferMemory, true);
+			instanceBufferCapacity = sceneInstances.size();
+
+			if (useGpuCulling)
+			{
+				createCullTargets();
+			}
+		}
+		else
+		{
+			//nor does the copy wait on the culls still reading the old objects
+			if (useAsyncCompute)
+			{
+				scheduler.wait(scheduler.last(graphicsSubmitQueue));
+			}
+			uploadToBuffer(sceneInstances.data(), size, instanceBuffer);
+			objectsUploaded = uploadToBuffer(sceneObjects.data(), objectsSize, objectBuffer);
+		}
+
+		if (useAsyncCompute)
+		{
+			scheduler.wait(objectsUploaded);
+		}
+	}
+
+	//one set of indirect draws per frame in flight (two with occlusion culling), sized for the whole object buffer
+	void createCullTargets()
+	{
+		if (!gpuCulling.isInitialized())
+		{
+			gpuCulling.init(physicalDevice, device, useOcclusionCulling ? cullOcclusionShaderCode : cullShaderCode,
+				useDrawIndirectCount, useOcclusionCulling);
+		}
+
+		GpuCulling::TargetInfo targetInfo = {};
+		targetInfo.objectBuffer = objectBuffer;
+		targetInfo.visibilityBuffer = visibilityBuffer;
+		targetInfo.depthPyramid = useOcclusionCulling ? frameGraph.getView(depthPyramidResource) : VK_NULL_HANDLE;
+		targetInfo.depthPyramidScale[0] = swapChainExtent.width / static_cast<float>(2u << depthPyramidShift);
+		targetInfo.depthPyramidScale[1] = swapChainExtent.height / static_cast<float>(2u << depthPyramidShift);
+		targetInfo.maxDraws = static_cast<uint32_t>(instanceBufferCapacity);
+		//written on computeQueue and drawn from on graphicsQueue with async compute
+		uint32_t queueFamilyIndices[] = { graphicsQueueFamily, computeQueueFamily };
+		if (computeQueue != VK_NULL_HANDLE)
+		{
+			targetInfo.queueFamilyCount = 2;
+			targetInfo.queueFamilies = queueFamilyIndices;
+		}
+
+		for (FrameData& frame : frames)
+		{
+			//the frames in flight still draw from the old ones
+			GpuCulling::Target oldCullTarget = frame.cullTarget;
+			GpuCulling::Target oldLateCullTarget = frame.lateCullTarget;
+			scheduler.defer(scheduler.last(graphicsSubmitQueue), [this, oldCullTarget, oldLateCullTarget]() mutable {
+				gpuCulling.destroyTarget(oldCullTarget);
+				gpuCulling.destroyTarget(oldLateCullTarget);
+			});
+
+			frame.cullTarget = gpuCulling.createTarget(targetInfo);
+			if (useOcclusionCulling)
+			{
+				frame.lateCullTarget = gpuCulling.createTarget(targetInfo);
+			}
+		}
+	}
+
+#pragma endregion
+
+#pragma region Benchmark Functions
+
+	//RGBA8 test image for the CPU benchmarks
+	//uses the top left corner of the real texture so the content is representative
+	std::vector<uint8_t> loadBenchmarkImage(uint32_t size)
+	{
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+		if (!pixels)
+		{
+			THROW("failed to load texture image")
+		}
+
+		size = std::min(size, static_cast<uint32_t>(std::min(width, height)));
+		std::vector<uint8_t> image(size * size * 4);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			memcpy(image.data() + y * size * 4, pixels + y * width * 4, size * 4);
+		}
+
+		stbi_image_free(pixels);
+		return image;
+	}
+
+	void benchmarkBlockCompression()
+	{
+		const uint32_t size = 1024;
+		std::vector<uint8_t> image = loadBenchmarkImage(size);
+		double megapixels = size * size / 1000000.0;
+
+		std::cout << "block compression, " << size << "x" << size << ", "
+			<< threadPool.size() << " worker threads" << std::endl;
+
+		for (auto format : { BlockCompression::Format::BC1, BlockCompression::Format::BC3, BlockCompression::Format::BC7 })
+		{
+			for (auto quality : { BlockCompression::Quality::Fast, BlockCompression::Quality::Normal, BlockCompression::Quality::High })
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				std::vector<uint8_t> compressed = BlockCompression::compress(image.data(), size, size, format, quality, nullptr);
+				auto middle = std::chrono::high_resolution_clock::now();
+				BlockCompression::compress(image.data(), size, size, format, quality, &threadPool);
+				auto end = std::chrono::high_resolution_clock::now();
+
+				float singleSeconds = std::chrono::duration<float>(middle - start).count();
+				float pooledSeconds = std::chrono::duration<float>(end - middle).count();
+
+				std::vector<uint8_t> decoded = BlockCompression::decompress(compressed.data(), size, size, format);
+				double psnr = BlockCompression::computePSNR(image.data(), decoded.data(), size * size, format != BlockCompression::Format::BC1);
+
+				std::cout << "\t" << BlockCompression::formatName(format) << " " << BlockCompression::qualityName(quality)
+					<< ": 1 thread " << megapixels / singleSeconds << " MPix/s, pool " << megapixels / pooledSeconds
+					<< " MPix/s, PSNR " << psnr << " dB" << std::endl;
+			}
+		}
+	}
+
+	void benchmarkMipGeneration()
+	{
+		const uint32_t size = 2048;
+		std::vector<uint8_t> image = loadBenchmarkImage(size);
+		double megapixels = size * size / 1000000.0;
+
+		std::cout << "mip generation, " << size << "x" << size << ", " << MipGenerator::kernelName() << " kernels, "
+			<< threadPool.size() << " worker threads" << std::endl;
+
+		for (auto filter : { MipGenerator::Filter::Box, MipGenerator::Filter::Kaiser })
+		{
+			for (bool srgb : { false, true })
+			{
+				MipGenerator::Settings settings;
+				settings.filter = filter;
+				settings.srgb = srgb;
+
+				auto start = std::chrono::high_resolution_clock::now();
+				MipGenerator::generate(image.data(), size, size, settings, nullptr);
+				auto middle = std::chrono::high_resolution_clock::now();
+				MipGenerator::generate(image.data(), size, size, settings, &threadPool);
+				auto end = std::chrono::high_resolution_clock::now();
+
+				float singleSeconds = std::chrono::duration<float>(middle - start).count();
+				float pooledSeconds = std::chrono::duration<float>(end - middle).count();
+
+				std::cout << "\t" << MipGenerator::filterName(filter) << (srgb ? " sRGB" : " linear")
+					<< ": 1 thread " << megapixels / singleSeconds << " MPix/s, pool " << megapixels / pooledSeconds
+					<< " MPix/s" << std::endl;
+			}
+		}
+	}
+
+	//a grid of copies of the model seen from low down, so the front rows hide most of the ones behind
+	//the occluders go through the simplified mesh like cullSceneInstances, the test boxes are the full model's bounds
+	void benchmarkSoftwareOcclusion()
+	{
+		loadModel();
+		SoftwareOcclusion::Mesh mesh = SoftwareOcclusion::simplify(&vertices[0].pos.x, vertices.size(), sizeof(Vertex),
+			indices.data(), indices.size(), OCCLUDER_GRID_SIZE);
+
+		const uint32_t side = 8;
+		const uint32_t boxSide = 316;	//about 100k boxes
+		const uint32_t repeats = 20;
+		float spacing = modelRadius * 2.0f;
+		float extent = spacing * side * 0.5f;
+
+		glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, extent * 8.0f);
+		proj[1][1] *= -1;
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, -extent * 1.5f, modelRadius), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 viewProj = proj * view;
+
+		std::vector<glm::mat4> occluderMvps;
+		for (uint32_t i = 0; i < side * side; i++)
+		{
+			glm::vec3 position(-extent + spacing * (i % side + 0.5f), -extent + spacing * (i / side + 0.5f), 0.0f);
+			occluderMvps.push_back(viewProj * glm::translate(glm::mat4(1.0f), position));
+		}
+
+		std::vector<glm::mat4> boxMvps;
+		for (uint32_t i = 0; i < boxSide * boxSide; i++)
+		{
+			glm::vec3 position(-extent + extent * 2.0f * (i % boxSide + 0.5f) / boxSide, -extent + extent * 2.0f * (i / boxSide + 0.5f) / boxSide, 0.0f);
+			boxMvps.push_back(viewProj * glm::translate(glm::mat4(1.0f), position));
+		}
+
+		softwareOcclusion.resize(SOFTWARE_OCCLUSION_WIDTH, SOFTWARE_OCCLUSION_HEIGHT);
+
+		std::cout << "software occlusion, " << softwareOcclusion.getWidth() << "x" << softwareOcclusion.getHeight() << ", "
+			<< SoftwareOcclusion::kernelName() << " kernels, " << threadPool.size() << " worker threads, "
+			<< occluderMvps.size() << " occluders of " << mesh.indices.size() / 3 << " triangles (from " << indices.size() / 3 << ")" << std::endl;
+
+		float seconds[2];
+		for (int pooled = 0; pooled < 2; pooled++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t r = 0; r < repeats; r++)
+			{
+				softwareOcclusion.beginFrame();
+				for (const glm::mat4& occluderMvp : occluderMvps)
+				{
+					softwareOcclusion.addOccluder(mesh, &occluderMvp[0][0]);
+				}
+				softwareOcclusion.render(pooled ? &threadPool : nullptr);
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			seconds[pooled] = std::chrono::duration<float>(end - start).count();
+		}
+
+		double megaTriangles = softwareOcclusion.getTriangleCount() * repeats / 1000000.0;
+		std::cout << "\trasterization: 1 thread " << megaTriangles / seconds[0] << " MTri/s, pool "
+			<< megaTriangles / seconds[1] << " MTri/s" << std::endl;
+
+		uint32_t visibleCount = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const glm::mat4& boxMvp : boxMvps)
+		{
+			visibleCount += softwareOcclusion.isBoxVisible(&modelBoundsMin.x, &modelBoundsMax.x, &boxMvp[0][0]) ? 1 : 0;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		double megaTests = boxMvps.size() / 1000000.0;
+		std::cout << "\tbox tests: " << megaTests / std::chrono::duration<float>(end - start).count() << " MTests/s, "
+			<< visibleCount << " of " << boxMvps.size() << " visible" << std::endl;
+	}
+
+	//random boxes in a cube, seen from the middle of one of its faces so only some of them are in the frustum
+	//the BVH is compared against testing every box, at each thread count up to the size of the thread pool
+	void benchmarkSceneCulling()
+	{
+		const float extent = 1000.0f;
+		const uint32_t repeats = 10;
+
+		glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, extent * 2.0f);
+		proj[1][1] *= -1;
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, -extent, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 viewProj = proj * view;
+		Frustum frustum = Frustum::fromMatrix(&viewProj[0][0]);
+
+		std::vector<unsigned int> threadCounts;
+		for (unsigned int threads = 1; threads < threadPool.size(); threads *= 2)
+		{
+			threadCounts.push_back(threads);
+		}
+		threadCounts.push_back(static_cast<unsigned int>(threadPool.size()));
+
+		std::cout << "scene culling, 4 wide BVH, leaves of " << SceneBvh::LEAF_SIZE << std::endl;
+
+		for (uint32_t objectCount : { 100000u, 300000u, 1000000u })
+		{
+			std::mt19937 random(objectCount);
+			std::uniform_real_distribution<float> position(-extent, extent);
+			std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+			SceneBvh bvh;
+			std::vector<glm::vec3> boxes;
+			for (uint32_t i = 0; i < objectCount; i++)
+			{
+				glm::vec3 center(position(random), position(random), position(random));
+				glm::vec3 halfSize(size(random));
+				boxes.push_back(center - halfSize);
+				boxes.push_back(center + halfSize);
+				bvh.add(&boxes[i * 2].x, &boxes[i * 2 + 1].x);
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			bvh.build();
+			auto end = std::chrono::high_resolution_clock::now();
+			float buildMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+
+			//every box against every plane, the same test the BVH does per node
+			std::vector<uint32_t> visible;
+			start = std::chrono::high_resolution_clock::now();
+			for (uint32_t r = 0; r < repeats; r++)
+			{
+				visible.clear();
+				for (uint32_t i = 0; i < objectCount; i++)
+				{
+					bool outside = false;
+					for (int p = 0; p < Frustum::PlaneCount && !outside; p++)
+					{
+						const float* plane = frustum.planes[p];
+						glm::vec3 furthest = glm::mix(boxes[i * 2], boxes[i * 2 + 1], glm::greaterThanEqual(glm::vec3(plane[0], plane[1], plane[2]), glm::vec3(0.0f)));
+						outside = (plane[0] * furthest.x + plane[1] * furthest.y) + (plane[2] * furthest.z + plane[3]) < 0.0f;
+					}
+					if (!outside) visible.push_back(i);
+				}
+			}
+			end = std::chrono::high_resolution_clock::now();
+			float bruteMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count() / repeats;
+			size_t visibleCount = visible.size();
+
+			std::cout << "\t" << objectCount << " objects, " << visibleCount << " visible, build " << buildMilliseconds
+				<< " ms, every box " << bruteMilliseconds << " ms" << std::endl;
+
+			start = std::chrono::high_resolution_clock::now();
+			for (uint32_t r = 0; r < repeats; r++)
+			{
+				visible.clear();
+				bvh.cull(frustum, visible, nullptr);
+			}
+			end = std::chrono::high_resolution_clock::now();
+			std::cout << "\t\tBVH, main thread: " << std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count() / repeats
+				<< " ms" << (visible.size() == visibleCount ? "" : ", DIFFERENT RESULT") << std::endl;
+
+			for (unsigned int threads : threadCounts)
+			{
+				ThreadPool pool(threads);
+				start = std::chrono::high_resolution_clock::now();
+				for (uint32_t r = 0; r < repeats; r++)
+				{
+					visible.clear();
+					bvh.cull(frustum, visible, &pool);
+				}
+				end = std::chrono::high_resolution_clock::now();
+				std::cout << "\t\tBVH, " << threads << " worker threads: " << std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count() / repeats
+					<< " ms" << (visible.size() == visibleCount ? "" : ", DIFFERENT RESULT") << std::endl;
+			}
+
+			//1% of the objects move a little, then the bounds above them are refit
+			std::uniform_int_distribution<uint32_t> pick(0, objectCount - 1);
+			std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+			start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < objectCount / 100; i++)
+			{
+				uint32_t object = pick(random);
+				glm::vec3 move(offset(random), offset(random), offset(random));
+				boxes[object * 2] += move;
+				boxes[object * 2 + 1] += move;
+				bvh.update(object, &boxes[object * 2].x, &boxes[object * 2 + 1].x);
+			}
+			bvh.refit();
+			end = std::chrono::high_resolution_clock::now();
+			std::cout << "\t\trefit after moving 1%: " << std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count()
+				<< " ms" << std::endl;
+		}
+	}
+
+	//what an empty task costs to spawn and run, from the main thread, with a future, and from a worker onto its own deque
+	//then how a compute bound parallelFor scales, at each thread count up to the machine's
+	void benchmarkTaskSystem()
+	{
+		const uint32_t taskCount = 200000;
+
+		std::cout << "task system, work stealing, " << threadPool.size() << " worker threads" << std::endl;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		ThreadPool::Counter counter;
+		for (uint32_t i = 0; i < taskCount; i++)
+		{
+			threadPool.submit(counter, []() {});
+		}
+		threadPool.wait(counter);
+		auto end = std::chrono::high_resolution_clock::now();
+		std::cout << "\tspawn from the main thread: "
+			<< std::chrono::duration<double, std::nano>(end - start).count() / taskCount << " ns per task" << std::endl;
+
+		std::vector<std::future<void>> futures;
+		futures.reserve(taskCount);
+		start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < taskCount; i++)
+		{
+			futures.push_back(threadPool.submit([]() {}));
+		}
+		for (auto& future : futures)
+		{
+			future.get();
+		}
+		end = std::chrono::high_resolution_clock::now();
+		std::cout << "\tspawn with a future: "
+			<< std::chrono::duration<double, std::nano>(end - start).count() / taskCount << " ns per task" << std::endl;
+
+		//the children all go on the spawning worker's deque, so every other worker has to steal its share
+		uint64_t stealsBefore = threadPool.getStealCount();
+		start = std::chrono::high_resolution_clock::now();
+		threadPool.submit(counter, [this, taskCount]() {
+			ThreadPool::Counter children;
+			for (uint32_t i = 0; i < taskCount; i++)
+			{
+				threadPool.submit(children, []() {});
+			}
+			threadPool.wait(children);
+		});
+		threadPool.wait(counter);
+		end = std::chrono::high_resolution_clock::now();
+		std::cout << "\tspawn from a worker: " << std::chrono::duration<double, std::nano>(end - start).count() / taskCount
+			<< " ns per task, " << 100.0 * (threadPool.getStealCount() - stealsBefore) / taskCount << "% stolen" << std::endl;
+
+		//each element is a chain of dependent multiply adds, so it's bound by the cores and not by memory
+		const uint32_t elementCount = 1 << 20;
+		const uint32_t repeats = 5;
+		std::vector<float> values(elementCount);
+		auto kernel = [&values](uint32_t, uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++)
+			{
+				float x = static_cast<float>(i & 1023) / 1024.0f;
+				for (int step = 0; step < 256; step++)
+				{
+					x = x * 0.999f + 0.0005f;
+				}
+				values[i] = x;
+			}
+		};
+
+		unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<unsigned int> threadCounts;
+		for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2)
+		{
+			threadCounts.push_back(threads);
+		}
+		threadCounts.push_back(hardwareThreads);
+
+		double singleSeconds = 0.0;
+		for (unsigned int threads : threadCounts)
+		{
+			//the thread calling parallelFor runs chunks too, so it's one of the threads
+			ThreadPool pool(threads - 1);
+			start = std::chrono::high_resolution_clock::now();
+			for (uint32_t r = 0; r < repeats; r++)
+			{
+				pool.parallelFor(elementCount, threads * 8, kernel);
+			}
+			end = std::chrono::high_resolution_clock::now();
+
+			double seconds = std::chrono::duration<double>(end - start).count() / repeats;
+			if (threads == 1) singleSeconds = seconds;
+			std::cout << "\tparallel for, " << threads << " threads: " << elementCount / seconds / 1000000.0 << " MElements/s, "
+				<< singleSeconds / seconds << "x" << std::endl;
+		}
+	}
+
+	//times the blit chain against the compute downsampler on the same image with timestamp queries
+	//both run in the same command buffer so submission overhead isn't part of either number
+	void benchmarkMipGenerationGpu()
+	{
+		const uint32_t size = 4096;
+		const uint32_t levels = MipGenerator::levelCount(size, size);
+		const uint32_t iterations = 10;
+		const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		std::cout << "GPU mip generation, " << size << "x" << size << ", " << levels << " levels, "
+			<< properties.deviceName << std::endl;
+
+		if (!properties.limits.timestampComputeAndGraphics)
+		{
+			std::cout << "\ttimestamp queries aren't supported" << std::endl;
+			return;
+		}
+
+		if (!canGenerateMipmapsOnCompute(format, size, size, levels))
+		{
+			std::cout << "\tcompute downsampler isn't available (is shaders/downsample.spv compiled?)" << std::endl;
+			return;
+		}
+
+		VkImage image;
+		VkDeviceMemory imageMemory;
+		createImage(size, size, levels, format, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+		barrierTracker.trackImage(image, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 4;
+
+		VkQueryPool queryPool;
+		if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+		{
+			THROW("failed to create query pool!")
+		}
+
+		Downsampler::Target target = createMipmapTarget(image, format, size, size, levels);
+
+		double blitMilliseconds = 0.0;
+		double computeMilliseconds = 0.0;
+		BarrierTracker::Stats blitBarriers;
+		BarrierTracker::Stats computeBarriers;
+
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+			vkCmdResetQueryPool(commandBuffer, queryPool, 0, 4);
+
+			//level 0 goes back to where a texture upload leaves it before each path, outside the timed part
+			barrierTracker.useImage(image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+			barrierTracker.flush(commandBuffer);
+			barrierTracker.resetStats();
+
+			//bottom of pipe timestamps are written once everything before them has finished
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 0);
+			recordBlitMipmaps(commandBuffer, image, size, size, levels);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+			blitBarriers = barrierTracker.getStats();
+
+			barrierTracker.useImage(image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+			barrierTracker.flush(commandBuffer);
+			barrierTracker.resetStats();
+
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2);
+			recordComputeMipmaps(commandBuffer, image, target, levels);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 3);
+			computeBarriers = barrierTracker.getStats();
+
+			endSingleTimeCommands(commandBuffer);
+
+			uint64_t timestamps[4];
+			vkGetQueryPoolResults(device, queryPool, 0, 4, sizeof(timestamps), timestamps, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+			//timestampPeriod is in nanoseconds per tick
+			blitMilliseconds += (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod / 1000000.0;
+			computeMilliseconds += (timestamps[3] - timestamps[2]) * properties.limits.timestampPeriod / 1000000.0;
+		}
+
+		std::cout << "\tblit chain: " << blitMilliseconds / iterations << " ms, "
+			<< blitBarriers.barrierCount << " barriers in " << blitBarriers.batchCount << " batches" << std::endl;
+		std::cout << "\tcompute: " << computeMilliseconds / iterations << " ms, "
+			<< computeBarriers.barrierCount << " barriers in " << computeBarriers.batchCount << " batches" << std::endl;
+
+		downsampler.destroyTarget(target);
+		vkDestroyQueryPool(device, queryPool, nullptr);
+		barrierTracker.untrackImage(image);
+		vkDestroyImage(device, image, nullptr);
+		vkFreeMemory(device, imageMemory, nullptr);
+	}
+
+	//sets allocated per millisecond with the model's set layout
+		//growable - DescriptorAllocator, reset once per simulated frame
+		//free list - one pool with FREE_DESCRIPTOR_SET_BIT, every set allocated and freed on its own
+		//cached - the renderer's DescriptorCache asked for the model set's bindings over and over
+	void benchmarkDescriptorAllocation()
+	{
+		const uint32_t frameCount = 100;
+		const uint32_t setsPerFrame = 1000;
+		const double totalSets = static_cast<double>(frameCount) * setsPerFrame;
+
+		std::vector<DescriptorAllocator::PoolSizeRatio> ratios = { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f } };
+		if (!useBindless)
+		{
+			ratios.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f });
+		}
+
+		std::cout << "descriptor allocation, " << frameCount << " frames of " << setsPerFrame << " sets" << std::endl;
+
+		DescriptorAllocator growable;
+		growable.init(device, 16, ratios);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < frameCount; frame++)
+		{
+			for (uint32_t i = 0; i < setsPerFrame; i++)
+			{
+				growable.allocate(descriptorSetLayout);
+			}
+			growable.reset();
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		float growableMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+		std::cout << "\tgrowable: " << totalSets / growableMilliseconds << " sets/ms, "
+			<< growable.getPoolCount() << " pools" << std::endl;
+		growable.destroy();
+
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const auto& ratio : ratios)
+		{
+			poolSizes.push_back({ ratio.type, setsPerFrame });
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = setsPerFrame;
+
+		VkDescriptorPool freeListPool;
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &freeListPool) != VK_SUCCESS)
+		{
+			THROW("failed to create descriptor pool!")
+		}
+
+		std::vector<VkDescriptorSet> sets(setsPerFrame);
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = freeListPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &descriptorSetLayout;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < frameCount; frame++)
+		{
+			for (uint32_t i = 0; i < setsPerFrame; i++)
+			{
+				if (vkAllocateDescriptorSets(device, &allocInfo, &sets[i]) != VK_SUCCESS)
+				{
+					THROW("failed to allocate descriptor set!")
+				}
+			}
+			for (uint32_t i = 0; i < setsPerFrame; i++)
+			{
+				vkFreeDescriptorSets(device, freeListPool, 1, &sets[i]);
+			}
+		}
+		end = std::chrono::high_resolution_clock::now();
+
+		float freeListMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+		std::cout << "\tfree list: " << totalSets / freeListMilliseconds << " sets/ms" << std::endl;
+		vkDestroyDescriptorPool(device, freeListPool, nullptr);
+
+		//the renderer's own cache, asked for the first frame's model set the way updateModelDescriptorSet does
+			//hits only, the set is made before the clock starts
+		updateModelDescriptorSet(frames[0]);
+		std::vector<DescriptorCache::Binding> bindings = modelSetBindings(frames[0]);
+		uint64_t missesBefore = descriptorCache.getMisses();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < frameCount * setsPerFrame; i++)
+		{
+			descriptorCache.get(descriptorSetLayout, bindings);
+		}
+		end = std::chrono::high_resolution_clock::now();
+
+		float cachedMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+		std::cout << "\tcached: " << totalSets / cachedMilliseconds << " sets/ms, "
+			<< descriptorCache.getMisses() - missesBefore << " new allocations" << std::endl;
+	}
+
+	//writing every binding of 10k model sets per frame, classic vkUpdateDescriptorSets against an update template
+		//both read the same ModelDescriptors structs, so the only difference is how the driver is told about them
+	void benchmarkDescriptorUpdates()
+	{
+		const uint32_t frameCount = 20;
+		const uint32_t setsPerFrame = 10000;
+
+		DescriptorAllocator allocator;
+		allocator.init(device, setsPerFrame, {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f }
+		});
+
+		std::vector<VkDescriptorSet> sets(setsPerFrame);
+		for (uint32_t i = 0; i < setsPerFrame; i++)
+		{
+			sets[i] = allocator.allocate(descriptorSetLayout);
+		}
+
+		VkDescriptorUpdateTemplate updateTemplate = modelSetDescription.createUpdateTemplate(device, descriptorSetLayout);
+
+		std::vector<ModelDescriptors> data(setsPerFrame);
+		for (uint32_t i = 0; i < setsPerFrame; i++)
+		{
+			data[i].uniformBuffer = { frames[0].uniformBuffer, 0, sizeof(UniformBufferObject) };
+			data[i].texture = { textureSampler, modelTextureView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		}
+
+		std::cout << "descriptor updates, " << setsPerFrame << " sets per frame, "
+			<< modelSetDescription.getEntries().size() << " bindings each" << std::endl;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < frameCount; frame++)
+		{
+			for (uint32_t i = 0; i < setsPerFrame; i++)
+			{
+				modelSetDescription.writeClassic(device, sets[i], &data[i]);
+			}
+		}
+		auto middle = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < frameCount; frame++)
+		{
+			for (uint32_t i = 0; i < setsPerFrame; i++)
+			{
+				updateDescriptorSet(device, sets[i], updateTemplate, data[i]);
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		float classicMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(middle - start).count() / frameCount;
+		float templateMilliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - middle).count() / frameCount;
+
+		std::cout << "\tvkUpdateDescriptorSets: " << classicMilliseconds << " ms per frame" << std::endl;
+		std::cout << "\tupdate template: " << templateMilliseconds << " ms per frame" << std::endl;
+
+		vkDestroyDescriptorUpdateTemplate(device, updateTemplate, nullptr);
+		allocator.destroy();
+	}
+
+	//draws a grid of cubes with the real pipeline, once as a single instanced draw and once as one draw per cube
+		//the per draw path picks each cube's instance data with firstInstance, so both read the same buffers
+	//CPU time is how long recording took, GPU time is from timestamps around the draws
+	void benchmarkInstancing()
+	{
+		const uint32_t instanceCounts[] = { 1000, 10000, 100000 };
+		const uint32_t iterations = 10;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		std::cout << "instanced rendering, " << properties.deviceName << std::endl;
+
+		if (!properties.limits.timestampComputeAndGraphics)
+		{
+			std::cout << "\ttimestamp queries aren't supported" << std::endl;
+			return;
+		}
+
+		//a small cube, so the numbers are about draw overhead rather than vertex work
+		const std::vector<Vertex> cubeVertices = {
+			{ { -0.5f, -0.5f, -0.5f },{ 1.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } },
+			{ { 0.5f, -0.5f, -0.5f },{ 0.0f, 1.0f, 0.0f },{ 1.0f, 0.0f } },
+			{ { 0.5f, 0.5f, -0.5f },{ 0.0f, 0.0f, 1.0f },{ 1.0f, 1.0f } },
+			{ { -0.5f, 0.5f, -0.5f },{ 1.0f, 1.0f, 1.0f },{ 0.0f, 1.0f } },
+			{ { -0.5f, -0.5f, 0.5f },{ 1.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } },
+			{ { 0.5f, -0.5f, 0.5f },{ 0.0f, 1.0f, 0.0f },{ 1.0f, 0.0f } },
+			{ { 0.5f, 0.5f, 0.5f },{ 0.0f, 0.0f, 1.0f },{ 1.0f, 1.0f } },
+			{ { -0.5f, 0.5f, 0.5f },{ 1.0f, 1.0f, 1.0f },{ 0.0f, 1.0f } }
+		};
+		const std::vector<uint32_t> cubeIndices = {
+			0, 1, 2, 2, 3, 0,
+			4, 6, 5, 6, 4, 7,
+			0, 4, 5, 5, 1, 0,
+			3, 2, 6, 6, 7, 3,
+			0, 3, 7, 7, 4, 0,
+			1, 5, 6, 6, 2, 1
+		};
+
+		VkBuffer cubeVertexBuffer, cubeIndexBuffer;
+		VkDeviceMemory cubeVertexMemory, cubeIndexMemory;
+		createDeviceLocalBuffer(cubeVertices.data(), sizeof(Vertex) * cubeVertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			cubeVertexBuffer, cubeVertexMemory);
+		createDeviceLocalBuffer(cubeIndices.data(), sizeof(uint32_t) * cubeIndices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			cubeIndexBuffer, cubeIndexMemory);
+
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+
+		VkQueryPool queryPool;
+		if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+		{
+			THROW("failed to create query pool!")
+		}
+
+		//the framebuffer's image has to be acquired before it can be rendered to
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence acquireFence;
+		if (vkCreateFence(device, &fenceInfo, nullptr, &acquireFence) != VK_SUCCESS)
+		{
+			THROW("failed to create fence!")
+		}
+
+		uint32_t imageIndex;
+		vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(), VK_NULL_HANDLE, acquireFence, &imageIndex);
+		vkWaitForFences(device, 1, &acquireFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+		updateUniformBuffer();
+		updateModelDescriptorSet(frames[0]);
+		memcpy(frames[0].uniformBufferMapped, &currentUbo, sizeof(currentUbo));
+		VkDescriptorSet descriptorSet = frames[0].descriptorSet;
+
+		//one draw pass into the acquired image, its render pass has the same formats as the frame's so the pipeline works with it
+			//the image is never presented, so it's left in whatever layout the pass used
+		std::function<void(VkCommandBuffer)> drawCubes;
+		RenderGraph benchGraph;
+		benchGraph.init(physicalDevice, device, useSynchronization2);
+
+		RenderGraph::ImageDesc colorDesc = { swapChainImageFormat, swapChainExtent.width, swapChainExtent.height, 1, 0 };
+		RenderGraph::ResourceId color = benchGraph.importImage("swap chain", colorDesc, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_IMAGE_LAYOUT_UNDEFINED);
+		RenderGraph::ImageDesc depthDesc = { findDepthFormat(), swapChainExtent.width, swapChainExtent.height, 1, 0 };
+		RenderGraph::ResourceId depth = benchGraph.createImage("depth", depthDesc);
+		benchGraph.markOutput(color);
+
+		VkClearValue colorClear = {};
+		colorClear.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		VkClearValue depthClear = {};
+		depthClear.depthStencil = { 1.0f, 0 };
+
+		RenderGraph::PassId cubePass = benchGraph.addPass("cubes", RenderGraph::PassType::Graphics, [&drawCubes](VkCommandBuffer commandBuffer) {
+			drawCubes(commandBuffer);
+		});
+		benchGraph.use(cubePass, color, RenderGraph::Usage::ColorAttachment);
+		benchGraph.use(cubePass, depth, RenderGraph::Usage::DepthAttachment);
+		benchGraph.setClearValue(cubePass, color, colorClear);
+		benchGraph.setClearValue(cubePass, depth, depthClear);
+		benchGraph.compile();
+		benchGraph.setImage(color, swapChainImages[imageIndex], swapChainImageViews[imageIndex]);
+
+		for (uint32_t instanceCount : instanceCounts)
+		{
+			//a cube with a gap around it in a grid, scaled down so the whole grid covers about as much as the model
+			uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+			float scale = modelRadius * 2.0f / side;
+
+			std::vector<InstanceData> instances(instanceCount);
+			for (uint32_t i = 0; i < instanceCount; i++)
+			{
+				glm::vec3 position((i % side + 0.5f) * scale - modelRadius, (i / side + 0.5f) * scale - modelRadius, 0.0f);
+				instances[i] = {};
+				instances[i].model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(scale * 0.5f));
+				instances[i].materialIndex = useBindless ? modelTextureIndex : 0;
+			}
+
+			VkBuffer benchInstanceBuffer;
+			VkDeviceMemory benchInstanceMemory;
+			createDeviceLocalBuffer(instances.data(), sizeof(InstanceData) * instances.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				benchInstanceBuffer, benchInstanceMemory);
+
+			double recordMilliseconds[2] = { 0.0, 0.0 };
+			double gpuMilliseconds[2] = { 0.0, 0.0 };
+
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				for (int instanced = 0; instanced < 2; instanced++)
+				{
+					VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+					vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+
+					drawCubes = [&](VkCommandBuffer commandBuffer) {
+						vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+
+						vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+						VkBuffer vertexBuffers[] = { cubeVertexBuffer, benchInstanceBuffer };
+						VkDeviceSize offsets[] = { 0, 0 };
+						vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+						vkCmdBindIndexBuffer(commandBuffer, cubeIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+						vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+						if (useBindless)
+						{
+							VkDescriptorSet bindlessSet = bindlessTextures.getSet();
+							vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &bindlessSet, 0, nullptr);
+						}
+
+						DrawConstants draw = {};
+						draw.model = glm::mat4(1.0f);
+						vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(draw), &draw);
+
+						uint32_t indexCount = static_cast<uint32_t>(cubeIndices.size());
+						if (instanced)
+						{
+							vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
+						}
+						else
+						{
+							for (uint32_t instance = 0; instance < instanceCount; instance++)
+							{
+								vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, instance);
+							}
+						}
+
+						vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+					};
+
+					auto start = std::chrono::high_resolution_clock::now();
+					benchGraph.execute(commandBuffer);
+					auto end = std::chrono::high_resolution_clock::now();
+
+					endSingleTimeCommands(commandBuffer);
+
+					uint64_t timestamps[2];
+					vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+						VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+					recordMilliseconds[instanced] += std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+					gpuMilliseconds[instanced] += (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod / 1000000.0;
+				}
+			}
+
+			std::cout << "\t" << instanceCount << " instances" << std::endl;
+			std::cout << "\t\tone draw per instance: record " << recordMilliseconds[0] / iterations << " ms, GPU "
+				<< gpuMilliseconds[0] / iterations << " ms" << std::endl;
+			std::cout << "\t\tone instanced draw: record " << recordMilliseconds[1] / iterations << " ms, GPU "
+				<< gpuMilliseconds[1] / iterations << " ms" << std::endl;
+
+			vkDestroyBuffer(device, benchInstanceBuffer, nullptr);
+			vkFreeMemory(device, benchInstanceMemory, nullptr);
+		}
+
+		benchGraph.reset();
+		vkDestroyFence(device, acquireFence, nullptr);
+		vkDestroyQueryPool(device, queryPool, nullptr);
+		vkDestroyBuffer(device, cubeVertexBuffer, nullptr);
+		vkFreeMemory(device, cubeVertexMemory, nullptr);
+		vkDestroyBuffer(device, cubeIndexBuffer, nullptr);
+		vkFreeMemory(device, cubeIndexMemory, nullptr);
+	}
+
+	//draws the scene with the cull dispatch in the frame's command buffer, then on computeQueue
+		//with occlusion it's the early phase that moves, see splitsFrame
+		//the frame time is wall clock over every frame, so it includes whatever present mode the swap chain has
+	void benchmarkAsyncCompute()
+	{
+		const uint32_t warmupFrames = 10;
+		const uint32_t frameCount = 200;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		std::cout << "async compute culling, " << properties.deviceName << std::endl;
+
+		if (computeQueue == VK_NULL_HANDLE || !useGpuCulling || (useOcclusionCulling && !useTimelineSemaphores))
+		{
+			std::cout << "\tneeds a queue family without graphics, GPU culling, and timeline semaphores with occlusion" << std::endl;
+			return;
+		}
+
+		bool usedAsyncCompute = useAsyncCompute;
+
+		for (int overlapped = 0; overlapped < 2; overlapped++)
+		{
+			//the cull pass is only in the frame graph without async compute, and the frame is only split with it
+			useAsyncCompute = overlapped != 0;
+			recreateSwapChain();
+
+			for (uint32_t i = 0; i < warmupFrames; i++)
+			{
+				glfwPollEvents();
+				updateUniformBuffer();
+				drawFrame();
+			}
+			scheduler.waitAll();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < frameCount; i++)
+			{
+				glfwPollEvents();
+				updateUniformBuffer();
+				drawFrame();
+			}
+			scheduler.waitAll();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			double milliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+			std::cout << "\t" << (overlapped ? "overlapped, cull on queue family " + std::to_string(computeQueueFamily)
+				: std::string("serialized on the graphics queue")) << ": " << milliseconds / frameCount << " ms per frame" << std::endl;
+		}
+
+		useAsyncCompute = usedAsyncCompute;
+		recreateSwapChain();
+	}
+
+#pragma endregion
+
+};
+
+#pragma region Helpful Advice for Real Apps
+
+/*
+All of the helper functions that submit commands so far have been set up to execute synchronously
+by waiting for the queue to become idle. For practical applications it is recommended to combine
+these operations in a single command buffer and execute them asynchronously for higher throughput,
+especially the transitions and copy in the createTextureImage function. Try to experiment
+with this by creating a setupCommandBuffer that the helper functions record commands into,
+and add a flushSetupCommands to execute the commands that have been recorded so far.
+It's best to do this after the texture mapping works to check if the texture resources are still set up correctly.
+*/
+
+//In a game with the state changin every frame the most efficient way is:
+
+/*
+void drawFrame() {
+	updateAppState();
+
+	vkQueueWaitIdle(presentQueue);
 
 	vkAcquireNextImageKHR(...)
 
@@ -2435,14 +5410,66 @@ void drawFrame() {
 
 #pragma endregion
 
-int main()
+int main(int argc, char* argv[])
 {
 	TriApp app;
 	bool result = EXIT_SUCCESS;
 
 	try
 	{
-		app.run();
+		//--bake [fast|normal|high] [box|kaiser] converts the source assets into their baked formats and exits
+		//--benchmark runs the CPU benchmarks and exits
+		//--benchmark-gpu opens a window, initializes vulkan, runs the GPU benchmarks and exits
+		//otherwise it runs the app, paced by any of
+			//--present low-latency|vsync|adaptive|uncapped
+			//--fps N, 0 for no limit
+			//--swapchain-images N, 0 for one more than the minimum
+			//--max-queued-frames N
+			//--on-demand, only draws when something changes, space pauses the model's spin
+			//--still, starts with the spin paused
+		if (argc > 1 && strcmp(argv[1], "--bake") == 0)
+		{
+			BlockCompression::Quality quality = BlockCompression::Quality::Normal;
+			MipGenerator::Filter mipFilter = MipGenerator::Filter::Box;
+			for (int i = 2; i < argc; i++)
+			{
+				if (strcmp(argv[i], "fast") == 0) quality = BlockCompression::Quality::Fast;
+				if (strcmp(argv[i], "high") == 0) quality = BlockCompression::Quality::High;
+				if (strcmp(argv[i], "kaiser") == 0) mipFilter = MipGenerator::Filter::Kaiser;
+			}
+
+			app.bakeAssets(quality, mipFilter);
+		}
+		else if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+		{
+			app.runBenchmarks();
+		}
+		else if (argc > 1 && strcmp(argv[1], "--benchmark-gpu") == 0)
+		{
+			app.runGpuBenchmarks();
+		}
+		else
+		{
+			for (int i = 1; i < argc; i++)
+			{
+				if (strcmp(argv[i], "--on-demand") == 0) app.renderOnDemand = true;
+				if (strcmp(argv[i], "--still") == 0) app.spinModel = false;
+				if (i + 1 == argc) break;
+
+				if (strcmp(argv[i], "--present") == 0)
+				{
+					if (strcmp(argv[i + 1], "low-latency") == 0) app.pacing.presentPolicy = FramePacer::PresentPolicy::LowLatency;
+					if (strcmp(argv[i + 1], "vsync") == 0) app.pacing.presentPolicy = FramePacer::PresentPolicy::VSync;
+					if (strcmp(argv[i + 1], "adaptive") == 0) app.pacing.presentPolicy = FramePacer::PresentPolicy::AdaptiveVSync;
+					if (strcmp(argv[i + 1], "uncapped") == 0) app.pacing.presentPolicy = FramePacer::PresentPolicy::Uncapped;
+				}
+				if (strcmp(argv[i], "--fps") == 0) app.pacing.targetFrameRate = atof(argv[i + 1]);
+				if (strcmp(argv[i], "--swapchain-images") == 0) app.pacing.swapChainImages = static_cast<uint32_t>(atoi(argv[i + 1]));
+				if (strcmp(argv[i], "--max-queued-frames") == 0) app.pacing.maxQueuedFrames = static_cast<uint32_t>(atoi(argv[i + 1]));
+			}
+
+			app.run();
+		}
 	}
 	catch (const std::runtime_error& e)
 	{
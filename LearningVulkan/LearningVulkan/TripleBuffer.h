@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+//hands the latest value from one writer thread to one reader thread without either of them ever waiting on the other
+	//the writer fills back() and publishes it, the reader takes whatever was published last when it calls update
+	//values published between two updates are skipped, the reader only ever sees whole ones
+//the third buffer is what lets both keep going, the middle one is swapped with the writer's or the reader's atomically
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	//writer only, overwrite all of it, it holds whatever was handed back from the middle
+	T& back() { return buffers[backIndex]; }
+
+	//writer only
+	void publish()
+	{
+		//release so the reader sees everything written to back(), acquire so the buffer handed back is no longer being read
+		backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	//reader only, returns whether there was anything new since the last call
+	bool update()
+	{
+		if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) return false;
+
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	//reader only, a value initialized T until the first update that finds something
+	const T& front() const { return buffers[frontIndex]; }
+
+private:
+	enum : uint32_t
+	{
+		INDEX_MASK = 3,
+		FRESH = 4	//set on middle when the writer has published since the reader last took it
+	};
+
+	T buffers[3] = {};
+	uint32_t backIndex = 0;
+	std::atomic<uint32_t> middle{ 1 };
+	uint32_t frontIndex = 2;
+};
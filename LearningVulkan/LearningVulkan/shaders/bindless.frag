@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+//shader.frag with the texture picked by index out of the bindless array, see BindlessTextures.h
+	//set 0 is the same as shader.frag's minus the combined image sampler
+	//set 1 is every texture in the scene, bound once for the whole frame
+
+layout(location = 0) out vec4 outColor;
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterialIndex;
+
+layout(set = 1, binding = 0) uniform sampler texSampler;
+layout(set = 1, binding = 1) uniform texture2D textures[];
+
+void main()
+{
+	//the index comes from per instance data, so one draw's fragments can pick different textures
+	outColor = texture(sampler2D(textures[nonuniformEXT(fragMaterialIndex)], texSampler), fragTexCoord);
+}
@@ -1,2 +1,7 @@
-C:\VulkanSDK\1.1.70.1\Bin\glslangValidator.exe -V shader.vert
-C:\VulkanSDK\1.1.70.1\Bin\glslangValidator.exe -V shader.frag
\ No newline at end of file
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V shader.vert
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V shader.frag
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V downsample.comp -o downsample.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V -DDEPTH_PYRAMID downsample.comp -o downsample_depth.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V bindless.frag -o bindless_frag.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V cull.comp -o cull.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V -DOCCLUSION cull.comp -o cull_occlusion.spv
\ No newline at end of file
@@ -2,19 +2,30 @@
 #extension GL_ARB_separate_shader_objects : enable
 //above is required for Vulkan shaders to work
 
+//per frame, shared by every draw, proj * view is worked out once on the CPU
 layout(binding = 0) uniform UniformBufferObject
 {
-	mat4 model;
-	mat4 view;
-	mat4 proj;
+	mat4 viewProj;
 } ubo;
 
+//per draw
+layout(push_constant) uniform DrawConstants
+{
+	mat4 model;
+} draw;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+//per instance, from the instance rate binding (see InstanceData)
+	//a mat4 input takes locations 3 to 6
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in uint instanceMaterialIndex;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterialIndex;
 
 //certain values like dvec3 (double vec3) require multiple slots
 //example:
@@ -27,7 +38,8 @@ out gl_PerVertex {
 
 void main()
 {
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+	gl_Position = ubo.viewProj * (draw.model * (instanceModel * vec4(inPosition, 1.0)));
 	fragColor = inColor;
 	fragTexCoord = inTexCoord;
+	fragMaterialIndex = instanceMaterialIndex;
 }
\ No newline at end of file